@@ -0,0 +1,175 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "coverage.h"
+
+static const char *coverage_suffixes[3] = {".coverage.bedgraph", ".coverage.hap1.bedgraph", ".coverage.hap2.bedgraph"};
+
+coverage_t *
+coverage_init(const char *prefix, size_t buffer_size)
+{
+  coverage_t *cov = calloc(1, sizeof(coverage_t));
+  char *fn = malloc(strlen(prefix) + 32);
+  int32_t i;
+
+  for(i=0;i<3;i++) {
+      strcpy(fn, prefix); strcat(fn, coverage_suffixes[i]);
+      cov->fp[i] = fopen(fn, "w");
+      if(NULL == cov->fp[i]) {
+          fprintf(stderr, "[coverage_init] could not open %s\n", fn);
+          exit(1);
+      }
+      setvbuf(cov->fp[i], NULL, _IOFBF, buffer_size);
+  }
+  free(fn);
+  return cov;
+}
+
+void
+coverage_reset(coverage_t *cov, int32_t l)
+{
+  int32_t i;
+  if(cov->m < l + 1) {
+      cov->m = l + 1;
+      for(i=0;i<2;i++) {
+          free(cov->diff[i]);
+          cov->diff[i] = malloc(sizeof(int32_t) * cov->m);
+          if(NULL == cov->diff[i]) {
+              fprintf(stderr, "[coverage_reset] out of memory\n");
+              exit(1);
+          }
+      }
+  }
+  cov->l = l;
+  for(i=0;i<2;i++) {
+      memset(cov->diff[i], 0, sizeof(int32_t) * (l + 1));
+  }
+}
+
+static inline void
+coverage_add_run(coverage_t *cov, int32_t *diff, int32_t beg, int32_t end)
+{
+  if(beg < 0) beg = 0;
+  if(cov->l < end) end = cov->l;
+  if(end <= beg) return;
+  __sync_fetch_and_add(&diff[beg], 1);
+  __sync_fetch_and_sub(&diff[end], 1);
+}
+
+void
+coverage_add(coverage_t *cov, int32_t hap, int32_t pos, int32_t n_cigar, const uint32_t *cigar)
+{
+  int32_t i, beg = -1, op, len;
+  int32_t *diff = cov->diff[hap & 1];
+
+  // one run per stretch of aligned bases, as insertions do not move along
+  // the reference
+  for(i=0;i<n_cigar;i++) {
+      op = cigar[i] & 0xf;
+      len = cigar[i] >> 4;
+      if(0 == op) {
+          if(beg < 0) beg = pos;
+          pos += len;
+      }
+      else if(2 == op) {
+          if(0 <= beg) coverage_add_run(cov, diff, beg, pos);
+          beg = -1;
+          pos += len;
+      }
+  }
+  if(0 <= beg) coverage_add_run(cov, diff, beg, pos);
+}
+
+// appends the decimal "x" (non-negative) at "q", returning the end
+static inline char *
+coverage_dec(char *q, int32_t x)
+{
+  char t[12];
+  int32_t n = 0;
+  do {
+      t[n++] = '0' + x % 10;
+      x /= 10;
+  } while(0 < x);
+  while(0 < n) *q++ = t[--n];
+  return q;
+}
+
+// writes a run, after the contig name (and tab) already at "line"
+static inline void
+coverage_put(FILE *fp, char *line, size_t name_l, int32_t beg, int32_t end, int32_t depth)
+{
+  char *q = line + name_l;
+  q = coverage_dec(q, beg); *q++ = '\t';
+  q = coverage_dec(q, end); *q++ = '\t';
+  q = coverage_dec(q, depth); *q++ = '\n';
+  fwrite(line, 1, q - line, fp);
+}
+
+void
+coverage_write(coverage_t *cov, const char *name)
+{
+  int32_t i, j, depth[3], prev[3], beg[3];
+  size_t name_l = strlen(name) + 1;
+  char *line = malloc(name_l + 40);
+
+  memcpy(line, name, name_l - 1);
+  line[name_l - 1] = '\t';
+  for(j=0;j<3;j++) {
+      depth[j] = prev[j] = beg[j] = 0;
+  }
+  for(i=0;i<cov->l;i++) {
+      depth[1] += cov->diff[0][i];
+      depth[2] += cov->diff[1][i];
+      depth[0] = depth[1] + depth[2];
+      for(j=0;j<3;j++) {
+          if(depth[j] != prev[j]) {
+              if(beg[j] < i) coverage_put(cov->fp[j], line, name_l, beg[j], i, prev[j]);
+              beg[j] = i;
+              prev[j] = depth[j];
+          }
+      }
+  }
+  for(j=0;j<3;j++) {
+      if(beg[j] < cov->l) coverage_put(cov->fp[j], line, name_l, beg[j], cov->l, prev[j]);
+  }
+  free(line);
+}
+
+void
+coverage_destroy(coverage_t *cov)
+{
+  int32_t i;
+  if(NULL == cov) return;
+  for(i=0;i<3;i++) {
+      fclose(cov->fp[i]);
+  }
+  free(cov->diff[0]);
+  free(cov->diff[1]);
+  free(cov);
+}
@@ -0,0 +1,67 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* The realized read coverage (dwgsim -g): the depth of the simulated reads
+ * at each base of the reference, for each haplotype, accumulated while the
+ * reads are generated so that no pass over the output is needed.  Each read
+ * adds its aligned (CIGAR M) bases to a difference array of the contig, with
+ * atomic updates so that the worker threads share it.  Once a contig is
+ * done, the depth is written as bedGraph (zero-based, half-open runs of
+ * equal depth, including zero): the total to <prefix>.coverage.bedgraph,
+ * and each haplotype to <prefix>.coverage.hap1.bedgraph and
+ * <prefix>.coverage.hap2.bedgraph.  Random reads are not counted. */
+
+typedef struct {
+    int32_t l, m; /* the length of the contig, and the maximum buffer size */
+    int32_t *diff[2]; /* per haplotype, the depth at i minus that at i-1 */
+    FILE *fp[3]; /* the total, then each haplotype */
+} coverage_t;
+
+coverage_t *
+coverage_init(const char *prefix, size_t buffer_size);
+
+// clears the depth, for a contig of length "l"
+void
+coverage_reset(coverage_t *cov, int32_t l);
+
+// adds the aligned bases of a read from haplotype "hap", starting at the
+// zero-based "pos", given its CIGAR (BAM operations)
+void
+coverage_add(coverage_t *cov, int32_t hap, int32_t pos, int32_t n_cigar, const uint32_t *cigar);
+
+// writes the depth of the contig
+void
+coverage_write(coverage_t *cov, const char *name);
+
+void
+coverage_destroy(coverage_t *cov);
+
+#endif
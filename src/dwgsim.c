@@ -41,11 +41,24 @@
 #include <stdint.h>
 #include <ctype.h>
 #include <string.h>
+#include <pthread.h>
 #include "contigs.h"
 #include "mut.h"
 #include "mut_txt.h"
 #include "mut_bed.h"
 #include "regions_bed.h"
+#include "frag.h"
+#include "rng.h"
+#include "refseq.h"
+#include "gzi.h"
+#include "fai.h"
+#include "twobit.h"
+#include "truth.h"
+#include "sink.h"
+#include "writer.h"
+#include "pipeline.h"
+#include "replay.h"
+#include "coverage.h"
 #include "dwgsim_opt.h"
 #include "dwgsim.h"
 //#include <config.h>
@@ -69,9 +82,85 @@ uint8_t nst_nt4_table[256] = {
     4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
 };
 
-#define __gen_read(x, start, iter) do {									\
-    for (i = (start), k = 0, ext_coor[x] = -10; i >= 0 && i < seq.l && k < s[x]; iter) {	\
-        mut_t c = currseq->s[i], mut_type = c & mutmsk;			\
+/* The true alignment of a generated read, as BAM CIGAR operations (the
+ * length shifted left by four, then M=0, I=1, D=2 or S=4 for adapter bases)
+ * in the order they are generated, and the leftmost aligned position. */
+typedef struct {
+    int32_t n, m;
+    uint32_t *cigar;
+    int32_t pos;
+} dwgsim_cigar_t;
+
+static inline void
+dwgsim_cigar_push(dwgsim_cigar_t *cg, uint32_t op, uint32_t len)
+{
+  if(0 == len) return;
+  if(0 < cg->n && op == (cg->cigar[cg->n-1] & 0xf)) {
+      cg->cigar[cg->n-1] += len << 4;
+      return;
+  }
+  if(cg->n == cg->m) {
+      cg->m = (cg->m < 16) ? 16 : cg->m << 1;
+      cg->cigar = realloc(cg->cigar, cg->m * sizeof(uint32_t));
+  }
+  cg->cigar[cg->n++] = (len << 4) | op;
+}
+
+static inline void
+dwgsim_cigar_reverse(dwgsim_cigar_t *cg)
+{
+  int32_t i;
+  uint32_t t;
+  for(i=0;i<cg->n>>1;i++) {
+      t = cg->cigar[i]; cg->cigar[i] = cg->cigar[cg->n-1-i]; cg->cigar[cg->n-1-i] = t;
+  }
+}
+
+// the adapters read past the end of a short insert, by end; then poly-A
+static const char *dwgsim_adapter[2] = {
+    "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA", // TruSeq read 1
+    "AGATCGGAAGAGCGTCGTGTAGGGAAAGAGTGT" // TruSeq read 2
+};
+
+// appends "n" adapter bases to read "x" of "len" bases, soft-clipped at the
+// end of the read as sequenced: the right of the alignment on the forward
+// strand, the left on the reverse strand
+static void
+dwgsim_read_adapter(dwgsim_cigar_t *cg, uint8_t *seq, int32_t x, int32_t len, int32_t n, int32_t rev)
+{
+  const char *a = dwgsim_adapter[x];
+  int32_t i, l = strlen(a);
+
+  for(i=0;i<n;i++) {
+      seq[len+i] = (i < l) ? nst_nt4_table[(int)a[i]] : 0;
+  }
+  if(1 == rev) dwgsim_cigar_reverse(cg);
+  // an insertion cut by the end of the insert is clipped with the adapter
+  if(0 < cg->n && 1 == (cg->cigar[cg->n-1] & 0xf)) cg->cigar[cg->n-1] = (cg->cigar[cg->n-1] & ~0xf) | 4;
+  dwgsim_cigar_push(cg, 4, n);
+  if(1 == rev) dwgsim_cigar_reverse(cg);
+}
+
+/* Generates read x by walking the haplotype from "start" in the direction
+ * "dir" (backwards for the reverse strand), recording its alignment in
+ * w->cigar[x]. */
+#define __gen_read(x, start, dir) do {									\
+    dwgsim_cigar_t *cg = &w->cigar[x];									\
+    cg->n = 0; cg->pos = seq->l;										\
+    comp = strand[x];													\
+    lo = (0 < (dir)) ? (start) : (start) - s[x] + 1;					\
+    mk = mutseq_lower_bound(currseq, lo);								\
+    if (0 < seq->n_runs && opt->max_n < refseq_count_n(seq, lo, lo + s[x])) { /* too many Ns: rejected below */ \
+        ext_coor[x] = -10;												\
+    } else if (0 <= lo && lo + s[x] <= seq->l							\
+        && (currseq->n <= mk || (uint32_t)(lo + s[x]) <= currseq->pos[mk])) { /* no variants: copy the reference */ \
+        if (0 < (dir)) refseq_extract(seq, lo, s[x], tmp_seq[x]);		\
+        else { refseq_extract_rc(seq, lo, s[x], tmp_seq[x]); comp = 1 - comp; } \
+        ext_coor[x] = (1 == strand[x]) ? (start) - (s[x]-1) : (start); \
+        dwgsim_cigar_push(cg, 0, s[x]); cg->pos = lo;					\
+    } else {															\
+    for (i = (start), k = 0, ext_coor[x] = -10; i >= 0 && i < seq->l && k < s[x]; i += (dir)) {	\
+        mut_t c = mutseq_get_near(currseq, i, &mk), mut_type = c & mutmsk;	\
         if (ext_coor[x] < 0) {								\
             if (mut_type != NOCHANGE && mut_type != SUBSTITUTE) continue; \
             ext_coor[x] = i;								\
@@ -79,34 +168,41 @@ uint8_t nst_nt4_table[256] = {
         }													\
         if (mut_type == DELETE) { \
             ++n_indel[x];				\
+            dwgsim_cigar_push(cg, 2, 1);					\
             if(1 == strand[x]) ext_coor[x]--; \
             if(0 == k) n_indel_first[x]++; \
         } \
         else if (mut_type == NOCHANGE || mut_type == SUBSTITUTE) { \
             tmp_seq[x][k++] = c & 0xf;						\
+            dwgsim_cigar_push(cg, 0, 1); if (i < cg->pos) cg->pos = i;	\
             if (mut_type == SUBSTITUTE) { \
                 ++n_sub[x];			\
                 if(0 == k) n_sub_first[x]++; \
             } 												\
         } else {											\
             mut_t n, ins;										\
+            int32_t k0 = k;										\
             assert(mut_type == INSERT); \
             ++n_indel[x];									\
             n_indel_first[x]++;							\
-            if(1 == mut_get_ins(currseq, i, &n, &ins)) { \
+            if(1 == mut_get_ins(currseq, c, &n, &ins)) { \
                 if(0 == strand[x]) { \
                     while(n > 0 && k < s[x]) { \
                         tmp_seq[x][k++] = ins & 0x3;                \
                         --n, ins >>= 2; \
                     } \
-                    if(k < s[x]) tmp_seq[x][k++] = c & 0xf;						\
+                    dwgsim_cigar_push(cg, 1, k - k0);				\
+                    if(k < s[x]) { tmp_seq[x][k++] = c & 0xf; dwgsim_cigar_push(cg, 0, 1); if (i < cg->pos) cg->pos = i; } \
                 } else { \
                     tmp_seq[x][k++] = c & 0xf;						\
+                    dwgsim_cigar_push(cg, 0, 1); if (i < cg->pos) cg->pos = i; \
+                    k0 = k;											\
                     while(n > 0 && k < s[x]) { \
                         ext_coor[x]++; \
                         tmp_seq[x][k++] = (ins >> ((n-1) << 1) & 0x3);                \
                         --n; \
                     } \
+                    dwgsim_cigar_push(cg, 1, k - k0);				\
                 } \
             } else { \
                 int32_t byte_index, bit_index; \
@@ -124,9 +220,12 @@ uint8_t nst_nt4_table[256] = {
                             byte_index--; \
                         } \
                     } \
-                    if(k < s[x]) tmp_seq[x][k++] = c & 0xf;						\
+                    dwgsim_cigar_push(cg, 1, k - k0);				\
+                    if(k < s[x]) { tmp_seq[x][k++] = c & 0xf; dwgsim_cigar_push(cg, 0, 1); if (i < cg->pos) cg->pos = i; } \
                 } else { \
                     tmp_seq[x][k++] = c & 0xf;						\
+                    dwgsim_cigar_push(cg, 0, 1); if (i < cg->pos) cg->pos = i; \
+                    k0 = k;											\
                     byte_index = 0; bit_index = 0; \
                     while(num_ins > 0 && k < s[x]) { \
                         ext_coor[x]++; \
@@ -138,44 +237,29 @@ uint8_t nst_nt4_table[256] = {
                             byte_index++; \
                         } \
                     } \
+                    dwgsim_cigar_push(cg, 1, k - k0);				\
                 } \
             }													\
         } \
     }														\
     if (k != s[x]) ext_coor[x] = -10;						\
-    if (1 == strand[x]) { \
+    if ((dir) < 0) dwgsim_cigar_reverse(cg);				\
+    }																	\
+    if (1 == comp) { \
         for (k = 0; k < s[x]; ++k) tmp_seq[x][k] = tmp_seq[x][k] < 4? 3 - tmp_seq[x][k] : 4; \
     } 														\
 } while (0)
 
-/* Simple normal random number generator, copied from genran.c */
-
-double ran_normal()
-{ 
-  static int iset = 0; 
-  static double gset; 
-  double fac, rsq, v1, v2; 
-  if (iset == 0) {
-      do { 
-          v1 = 2.0 * drand48() - 1.0;
-          v2 = 2.0 * drand48() - 1.0; 
-          rsq = v1 * v1 + v2 * v2;
-      } while (rsq >= 1.0 || rsq == 0.0);
-      fac = sqrt(-2.0 * log(rsq) / rsq); 
-      gset = v1 * fac; 
-      iset = 1;
-      return v2 * fac;
-  } else {
-      iset = 0;
-      return gset;
-  }
-}
-
-int32_t ran_num(double prob, int32_t n)
+int32_t ran_num(rng_t *rng, double prob, int32_t n)
 {
-  int32_t i, r;
-  for(i = r = 0; i < n; i++) {
-      if(drand48() < prob) r++;
+  int32_t i, m, r = 0;
+  double u[64];
+  for(; 0 < n; n -= m) {
+      m = (n < 64) ? n : 64;
+      rng_uniforms(rng, u, m);
+      for(i = 0; i < m; i++) {
+          if(u[i] < prob) r++;
+      }
   }
   return r;
 }
@@ -253,21 +337,49 @@ FILE *err_xopen_core(const char *func, const char *fn, const char *mode)
 
 /* dwgsim */
 
-#define __gen_errors_mismatches(_cur_seq, _j, _start, _iter, _len) do { \
-    for (i = (_start); 0 <= i && i < _len; _iter) { \
-        mut_t c = _cur_seq[_j][i]; \
-        if (c >= 4) c = 4; \
-        else if(drand48() < e[_j]->start + e[_j]->by*i) { \
-            c = (c + (mut_t)(drand48() * 3.0 + 1)) & 3; \
-            ++n_err[_j]; \
-            if(0 == i) ++n_err_first[_j]; \
-        } \
-        _cur_seq[_j][i] = c; \
-    } \
-} while(0)
+/* Rather than one draw per base, the position of the next error is
+ * sampled directly: geometric gaps for a uniform error rate, otherwise by
+ * inverting the cumulative hazard, where hazard[i] is the sum of
+ * -log(1 - rate) over the first i bases.  Ns are never changed. */
+static void
+generate_errors_mismatches(rng_t *rng, uint8_t *seq, int32_t len, const error_t *e, const double *hazard, int *n_err, int *n_err_first)
+{
+  int32_t i, low, high, mid;
+  uint64_t skip;
+  double target;
+
+  for (i = 0; i < len; i++) {
+      if (4 < seq[i]) seq[i] = 4;
+  }
+  i = -1;
+  while (1) {
+      // the next error
+      if (NULL == hazard) {
+          skip = rng_geometric(rng, e->start);
+          if ((uint64_t)(len - i - 1) <= skip) break;
+          i += skip + 1;
+      }
+      else {
+          // the first position j > i where hazard[j+1] exceeds the target
+          target = hazard[i+1] - log(1.0 - rng_uniform(rng));
+          if (hazard[len] <= target) break;
+          low = i + 1; high = len - 1;
+          while (low < high) {
+              mid = (low + high) >> 1;
+              if (target < hazard[mid+1]) high = mid;
+              else low = mid + 1;
+          }
+          i = low;
+      }
+      if (4 <= seq[i]) continue;
+      seq[i] = (seq[i] + (int)(rng_uniform(rng) * 3.0 + 1)) & 3;
+      ++(*n_err);
+      if (0 == i) ++(*n_err_first);
+  }
+}
 
 int32_t
-generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t *mem, int32_t len, uint8_t strand, double e, int32_t *_n_err)
+generate_errors_flows(dwgsim_opt_t *opt, rng_t *rng, uint8_t **seq, uint8_t **mask, int32_t *mem, int32_t len, uint8_t strand, double e, int32_t *_n_err)
 {
   int32_t i, j, k, hp_l, flow_i, n_err;
   uint8_t prev_c, c;
@@ -307,11 +419,11 @@ generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t
       if(prev_c != c) { // new hp
           (*mask)[flow_i] = 0;
           n_err = 0;
-          while(drand48() < e) { // how many bases should we insert/delete
+          while(rng_uniform(rng) < e) { // how many bases should we insert/delete
               n_err++;
           }
           if(0 < n_err) {
-              if(drand48() < 0.5) { // insert
+              if(rng_uniform(rng) < 0.5) { // insert
                   // more memory
                   while((*mem) <= len + n_err) {
                       (*mem) <<= 1; // double
@@ -356,7 +468,7 @@ generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t
                       }
                       assert(0 < j);
                       // pick one to fill in
-                      k = (int)(drand48() * j);
+                      k = (int)(rng_uniform(rng) * j);
                       // shift up
                       for(j=len-1;i<=j;j--) {
                           (*seq)[j+1] = (*seq)[j];
@@ -378,7 +490,7 @@ generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t
       c = (4 <= (*seq)[i]) ? 0 : (*seq)[i];
       while(c != opt->flow_order[flow_i]) {
           n_err = 0;
-          while(drand48() < e) {
+          while(rng_uniform(rng) < e) {
               n_err++;
           }
           if(0 == (*mask)[flow_i] && 0 < n_err) {  // insert
@@ -414,43 +526,553 @@ generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t
   return len;
 }
 
+/* Read pairs are simulated in fixed-size blocks whose output is buffered
+ * in memory.  Each read pair has its own random number stream keyed by the
+ * random seed, the contig and the read pair id.  Blocks are handed out to
+ * the worker threads and written back in block order, so the output does
+ * not depend on the number of threads.  With -Z, each worker also
+ * compresses its blocks into BGZF, which is simply concatenated.  Only the
+ * output sinks selected with -o are formatted and written.  Each round of
+ * blocks is handed to the writer thread, and the next round is generated
+ * into another set of blocks while it is written. */
+
+typedef struct {
+    dwgsim_opt_t *opt;
+    refseq_t *seq;
+    mutseq_t *mutseq[2];
+    frag_t *frag; // the fragment sampler for the regions, or for the windows with at most -n Ns
+    char *name;
+    int32_t contig_i;
+    uint64_t first_id; // the read pairs in the output before this contig
+} dwgsim_contig_t;
+
+typedef struct {
+    uint64_t start, end; // the read pair ids [start, end)
+    sink_buf_t out;
+} dwgsim_block_t;
+
+// a round of blocks, written by the writer thread
+typedef struct {
+    sink_t *sink;
+    dwgsim_block_t *blocks;
+    int32_t n_blocks;
+} dwgsim_round_t;
+
+typedef struct {
+    dwgsim_contig_t *ctg;
+    dwgsim_block_t *blocks;
+    int32_t n_blocks;
+    int32_t tid, num_threads;
+    uint8_t *tmp_seq[2];
+    uint8_t *tmp_seq_flow_mask[2];
+    int32_t tmp_seq_mem[2];
+    double *hazard[2]; // the cumulative error hazard per end, NULL if the rate is uniform
+    char *qstr[2]; // the base qualities per end, for the longest read so far
+    int32_t qstr_l[2];
+    dwgsim_cigar_t cigar[2]; // the true alignment per end
+    uint8_t *truth_seq[2]; // the bases before colors or errors (SOLiD/Ion Torrent), for the truth sinks
+    rng_t rng;
+} dwgsim_worker_t;
+
+static void 
+dwgsim_worker_init(dwgsim_worker_t *w, dwgsim_opt_t *opt)
+{
+  int32_t i, j, l;
+  memset(w, 0, sizeof(dwgsim_worker_t));
+  l = opt->length[0] > opt->length[1]? opt->length[0] : opt->length[1];
+  w->tmp_seq[0] = (uint8_t*)calloc(l+2, 1);
+  w->tmp_seq[1] = (uint8_t*)calloc(l+2, 1);
+  if(IONTORRENT == opt->data_type) {
+      w->tmp_seq_flow_mask[0] = (uint8_t*)calloc(l+2, 1);
+      w->tmp_seq_flow_mask[1] = (uint8_t*)calloc(l+2, 1);
+  }
+  w->tmp_seq_mem[0] = w->tmp_seq_mem[1] = l+2;
+  if(NULL != opt->sink->truth && ILLUMINA != opt->data_type) {
+      w->truth_seq[0] = (uint8_t*)calloc(l+2, 1);
+      w->truth_seq[1] = (uint8_t*)calloc(l+2, 1);
+  }
+  for(j=0;j<2;j++) {
+      if(opt->length[j] <= 0 || 0 == opt->e[j].by) continue;
+      w->hazard[j] = malloc((opt->length[j]+1) * sizeof(double));
+      w->hazard[j][0] = 0.0; // NB: a rate of one adds a hazard large enough that an error is certain
+      for(i=0;i<opt->length[j];i++) {
+          double p = opt->e[j].start + opt->e[j].by*i;
+          w->hazard[j][i+1] = w->hazard[j][i] + ((p <= 0.0) ? 0.0 : ((1.0 <= p) ? 64.0 : -log1p(-p)));
+      }
+  }
+}
+
+static void 
+dwgsim_worker_destroy(dwgsim_worker_t *w)
+{
+  free(w->qstr[0]); free(w->qstr[1]);
+  free(w->tmp_seq[0]); free(w->tmp_seq[1]);
+  free(w->tmp_seq_flow_mask[0]); free(w->tmp_seq_flow_mask[1]);
+  free(w->hazard[0]); free(w->hazard[1]);
+  free(w->cigar[0].cigar); free(w->cigar[1].cigar);
+  free(w->truth_seq[0]); free(w->truth_seq[1]);
+}
+
+// the base qualities of end j, computed once for the longest read so far
+static const char *
+dwgsim_worker_qstr(dwgsim_worker_t *w, const dwgsim_opt_t *opt, int32_t j, int32_t len)
+{
+  int32_t i;
+  if(w->qstr_l[j] < len) {
+      w->qstr[j] = realloc(w->qstr[j], len + 1);
+      for (i = w->qstr_l[j]; i < len; ++i) {
+          if(NULL != opt->fixed_quality) {
+              w->qstr[j][i] = opt->fixed_quality[0];
+          }
+          else {
+              w->qstr[j][i] = (int)(-10.0 * log(opt->e[j].start + opt->e[j].by*i) / log(10.0) + 0.499) + 33;
+          }
+      }
+      w->qstr[j][len] = 0;
+      w->qstr_l[j] = len;
+  }
+  return w->qstr[j];
+}
+
+// 1 if the ends of a pair read towards each other over the outer distance,
+// so that a read longer than the insert runs on into the adapter
+static int32_t
+dwgsim_read_through(const dwgsim_opt_t *opt)
+{
+  return (0 < opt->length[1] && 0 == opt->is_inner
+          && (2 == opt->strandedness || (0 == opt->strandedness && ILLUMINA == opt->data_type))) ? 1 : 0;
+}
+
+// the smallest outer distance: an insert of one base with read-through,
+// else one that fits both ends, so that such draws are not rejected
+static double
+dwgsim_d_min(const dwgsim_opt_t *opt)
+{
+  if(1 == dwgsim_read_through(opt)) return -0.5;
+  if(0 < opt->length[1] && 0 == opt->is_inner) {
+      return ((opt->length[0] < opt->length[1]) ? opt->length[1] : opt->length[0]) + 0.5;
+  }
+  return -HUGE_VAL;
+}
+
+// the fragment lengths that fit a contig of "l" bases, from the -d histogram
+// if given
+static frag_len_t *
+dwgsim_frag_len(const dwgsim_opt_t *opt, const frag_len_t *insert_hist, int32_t l)
+{
+  if(0 == opt->length[1]) return frag_len_normal(0, 0, 0, 1);
+  if(NULL != insert_hist) return frag_len_clip(insert_hist, dwgsim_d_min(opt), l + 0.5);
+  return frag_len_normal(opt->dist, opt->std_dev, dwgsim_d_min(opt), l + 0.5);
+}
+
+// the bases spanned by the reads beyond the distance, from the start of the
+// fragment (see the read layouts in dwgsim_gen_pair)
+static int32_t
+dwgsim_frag_extra(const dwgsim_opt_t *opt)
+{
+  if(0 == opt->length[1]) return opt->length[0];
+  if(1 == opt->is_inner) return opt->length[0] + opt->length[1] + 1;
+  return 1;
+}
+
+// returns 1 if the read (pair) was generated, 0 if it should be re-tried
+static int32_t 
+dwgsim_gen_pair(dwgsim_worker_t *w, dwgsim_block_t *b, uint64_t ii)
+{
+  dwgsim_contig_t *ctg = w->ctg;
+  dwgsim_opt_t *opt = ctg->opt;
+  refseq_t *seq = ctg->seq;
+  int32_t contig_i = ctg->contig_i;
+  char *name = ctg->name;
+  rng_t *rng = &w->rng;
+  uint8_t **tmp_seq = w->tmp_seq;
+  error_t *e[2];
+  double ran;
+  int d, pos, s[2], strand[2], num_n[2];
+  int n_sub[2], n_indel[2], n_err[2], ext_coor[2]={0,0}, i, j, k, mk, lo, comp;
+  int n_sub_first[2], n_indel_first[2], n_err_first[2]; // need this for SOLID data
+  int c1, c2, c;
+  sink_pair_t pair;
+  sink_aln_t aln[2];
+
+  e[0] = &opt->e[0]; e[1] = &opt->e[1];
+  s[0] = opt->length[0]; s[1] = opt->length[1];
+
+  if(opt->rand_read < rng_uniform(rng)) { 
+      int32_t read_through = dwgsim_read_through(opt), n_adapter[2] = {0, 0};
+
+      // only admissible fragments are drawn (see frag.h)
+      ran = rng_uniform(rng);
+      pos = frag_sample(ctg->frag, ran, rng_uniform(rng), &d);
+      while(pos < 0) { // counted for another window: redraw the start
+          pos = frag_sample_pos(ctg->frag, d, rng_uniform(rng));
+      }
+
+      // generate the read sequences
+      pair.hap = rng_uniform(rng)<opt->mut_freq?0:1; // haplotype from which the reads are generated
+      mutseq_t *currseq = ctg->mutseq[pair.hap];
+      n_sub[0] = n_sub[1] = n_indel[0] = n_indel[1] = n_err[0] = n_err[1] = 0;
+      n_sub_first[0] = n_sub_first[1] = n_indel_first[0] = n_indel_first[1] = n_err_first[0] = n_err_first[1] = 0;
+      num_n[0]=num_n[1]=0;
+
+      // strand
+      if(2 == opt->strandedness || (0 == opt->strandedness && ILLUMINA == opt->data_type)) {
+          // opposite strand by default for Illumina
+          strand[0] = 0; strand[1] = 1; 
+      }
+      else if(1 == opt->strandedness || (0 == opt->strandedness && (SOLID == opt->data_type || IONTORRENT == opt->data_type))) {
+          // same strands by default for SOLiD
+          strand[0] = 0; strand[1] = 0; 
+      }
+      else {
+          // should not reach here
+          assert(1 == 0);
+      }
+      if (rng_uniform(rng) < 0.5) { // which strand ?
+          // Flip strands 
+          strand[0] = (1 + strand[0]) % 2;
+          strand[1] = (1 + strand[1]) % 2;
+      }
+
+      // a short insert (of d + 1 bases) is read through into the adapter
+      if(1 == read_through) {
+          for(j=0;j<2;j++) {
+              if(d + 1 < s[j]) {
+                  n_adapter[j] = s[j] - (d + 1);
+                  s[j] = d + 1;
+              }
+          }
+      }
+
+      // generate the reads in base space
+      if(0 < s[1]) { // paired end or mate pair
+          if(strand[0] == strand[1]) { // same strand
+              if(0 == strand[0]) { // + strand
+                  /*
+                   * 5' E2 -----> .... E1 -----> 3'
+                   * 3'           ....           5'
+                   */
+                  if(0 == opt->is_inner) {
+                      __gen_read(0, pos + d - s[0], 1); 
+                  }
+                  else {
+                      __gen_read(0, pos + s[1] + d, 1); 
+                  }
+                  __gen_read(1, pos, 1);
+              }
+              else { // - strand
+                  /*
+                   * 3'           ....            5'
+                   * 5' <----- E1 .... <----- E2  3'
+                   */
+                  __gen_read(0, pos + s[0], -1);
+                  if(0 == opt->is_inner) {
+                      __gen_read(1, pos + d, -1);
+                  }
+                  else {
+                      __gen_read(1, pos + s[0] + d + s[1], -1);
+                  }
+              }
+          }
+          else { // opposite strand
+              if(0 == strand[0]) { // + strand
+                  /*
+                   * 5' E1 -----> ....           3'
+                   * 3'           .... <----- E2 5'
+                   */
+                  __gen_read(0, pos, 1);
+                  if(0 == opt->is_inner) {
+                      __gen_read(1, pos + d, -1);
+                  }
+                  else {
+                      __gen_read(1, pos + s[0] + d + s[1], -1);
+                  }
+              }
+              else { // - strand
+                  /*
+                   * 5' E2 -----> ....           3'
+                   * 3'           .... <----- E1 5'
+                   */
+                  if(0 == opt->is_inner) {
+                      __gen_read(0, pos + d, -1);
+                  }
+                  else {
+                      __gen_read(0, pos + s[1] + d + s[0], -1); 
+                  }
+                  __gen_read(1, pos, 1);
+              }
+          }
+      }
+      else { // fragment
+          if(0 == strand[0]) {
+              __gen_read(0, pos, 1); // + strand
+          }
+          else {
+              __gen_read(0, pos + s[0] - 1, -1); // - strand
+          }
+      }
+
+      for (j = 0; j < 2; ++j) {
+          if(0 < n_adapter[j] && 0 <= ext_coor[j]) {
+              dwgsim_read_adapter(&w->cigar[j], tmp_seq[j], j, s[j], n_adapter[j], strand[j]);
+              s[j] += n_adapter[j];
+          }
+      }
+
+      // Count # of Ns
+      for (j = 0; j < 2; ++j) {
+          num_n[j]=0;
+          if(0 < s[j]) {
+              for (i = 0; i < s[j]; ++i) {
+                  if(tmp_seq[j][i] == 4) num_n[j]++;
+              }
+          }
+      }
+
+      if (ext_coor[0] < 0 || ext_coor[1] < 0 || opt->max_n < num_n[0] || opt->max_n < num_n[1]) { // fail to generate the read(s)
+          return 0;
+      }
+
+      if(NULL != w->truth_seq[0]) { // the true bases, before colors or errors
+          for (j = 0; j < 2; ++j) {
+              if(0 < s[j]) memcpy(w->truth_seq[j], tmp_seq[j], s[j]);
+          }
+      }
+
+      if(SOLID == opt->data_type) {
+          // Convert to color sequence, use the first base as the adaptor
+          for (j = 0; j < 2; ++j) {
+              if(0 < s[j]) {
+                  c1 = 0; // adaptor 
+                  for (i = 0; i < s[j]; ++i) {
+                      c2 = tmp_seq[j][i]; // current base
+                      c = __gf_add(c1, c2);
+                      tmp_seq[j][i] = c;
+                      c1 = c2; // save previous base
+                  }
+              }
+          }
+      }
+
+      // generate sequencing errors
+      if(IONTORRENT == opt->data_type) {
+          s[0] = generate_errors_flows(opt, rng, &tmp_seq[0], &w->tmp_seq_flow_mask[0], &w->tmp_seq_mem[0], s[0], strand[0], e[0]->start, &n_err[0]);
+          s[1] = generate_errors_flows(opt, rng, &tmp_seq[1], &w->tmp_seq_flow_mask[1], &w->tmp_seq_mem[1], s[1], strand[1], e[1]->start, &n_err[1]);
+      }
+      else { // Illumina/SOLiD
+          for (j = 0; j < 2; ++j) {
+              if(0 < s[j]) {
+                  assert(s[j] == opt->length[j]);
+                  generate_errors_mismatches(rng, tmp_seq[j], s[j], e[j], w->hazard[j], &n_err[j], &n_err_first[j]);
+              }
+          }
+      }
+
+      // print
+      pair.contig_i = contig_i;
+      pair.contig = name;
+      pair.is_rand = 0;
+      pair.id = ii;
+      pair.read_id = ctg->first_id + ii;
+      for (j = 0; j < 2; ++j) {
+          pair.pos[j] = ext_coor[j]+1;
+          pair.strand[j] = strand[j];
+          pair.n_err[j] = n_err[j]; pair.n_sub[j] = n_sub[j]; pair.n_indel[j] = n_indel[j];
+          pair.n_err_first[j] = n_err_first[j]; pair.n_sub_first[j] = n_sub_first[j]; pair.n_indel_first[j] = n_indel_first[j];
+      }
+      for (j = 0; j < 2; ++j) {
+          if(s[j] <= 0) {
+              continue;
+          }
+          const char *qstr = dwgsim_worker_qstr(w, opt, j, s[j]);
+          sink_put(opt->sink, &b->out, &pair, j, tmp_seq[j], qstr, s[j]);
+      }
+      if(NULL != opt->coverage) {
+          for (j = 0; j < 2; ++j) {
+              if(0 < opt->length[j]) coverage_add(opt->coverage, pair.hap, w->cigar[j].pos, w->cigar[j].n, w->cigar[j].cigar);
+          }
+      }
+      if(NULL != opt->sink->truth) {
+          for (j = 0; j < 2; ++j) {
+              aln[j].pos = w->cigar[j].pos;
+              aln[j].n_cigar = w->cigar[j].n;
+              aln[j].cigar = w->cigar[j].cigar;
+              if(NULL == w->truth_seq[0]) {
+                  aln[j].seq = tmp_seq[j];
+                  aln[j].qstr = (0 < s[j]) ? dwgsim_worker_qstr(w, opt, j, s[j]) : NULL;
+              }
+              else {
+                  aln[j].seq = w->truth_seq[j];
+                  aln[j].qstr = NULL;
+              }
+              aln[j].len = opt->length[j];
+          }
+          sink_put_truth(opt->sink, &b->out, &pair, aln, seq);
+      }
+  }
+  else { // random DNA read
+      memset(&pair, 0, sizeof(sink_pair_t));
+      memset(aln, 0, sizeof(aln));
+      pair.contig_i = -1;
+      pair.contig = "rand";
+      pair.is_rand = 1;
+      pair.id = ii;
+      pair.read_id = ctg->first_id + ii;
+      for(j=0;j<2;j++) {
+          if(s[j] <= 0) {
+              continue;
+          } 
+          const char *qstr = dwgsim_worker_qstr(w, opt, j, s[j]);
+          // get random sequence
+          rng_bases(rng, tmp_seq[j], s[j]);
+          aln[j].pos = -1;
+          aln[j].n_cigar = 0;
+          aln[j].cigar = NULL;
+          aln[j].seq = tmp_seq[j];
+          aln[j].qstr = qstr;
+          aln[j].len = s[j];
+          if(NULL != w->truth_seq[j]) {
+              memcpy(w->truth_seq[j], tmp_seq[j], s[j]);
+              aln[j].seq = w->truth_seq[j];
+              aln[j].qstr = NULL;
+          }
+          if(SOLID == opt->data_type) { // convert to color space
+              if(0 < s[j]) {
+                  c1 = 0; // adaptor 
+                  for (i = 0; i < s[j]; ++i) {
+                      c2 = tmp_seq[j][i]; // current base
+                      c = __gf_add(c1, c2);
+                      tmp_seq[j][i] = c;
+                      c1 = c2; // save previous base
+                  }
+              }
+          }
+          sink_put(opt->sink, &b->out, &pair, j, tmp_seq[j], qstr, s[j]);
+      }
+      if(NULL != opt->sink->truth) {
+          sink_put_truth(opt->sink, &b->out, &pair, aln, NULL);
+      }
+  }
+  return 1;
+}
+
+static void *
+dwgsim_worker_run(void *arg)
+{
+  dwgsim_worker_t *w = (dwgsim_worker_t*)arg;
+  dwgsim_contig_t *ctg = w->ctg;
+  int32_t i, n_tries;
+  uint64_t ii;
+
+  for(i=w->tid;i<w->n_blocks;i+=w->num_threads) {
+      dwgsim_block_t *b = &w->blocks[i];
+      sink_buf_open(&b->out);
+      for(ii=b->start;ii<b->end;ii++) {
+          // each read pair has its own random stream
+          rng_init(&w->rng, ctg->opt->seed, ctg->contig_i, RNG_READS, ii);
+          for(n_tries=1;0 == dwgsim_gen_pair(w, b, ii);n_tries++) {
+              if(DWGSIM_MAX_TRIES <= n_tries) {
+                  fprintf(stderr, "\n[dwgsim_worker_run] could not generate read pair %llu on '%s' in %d attempts\n",
+                          (unsigned long long)ii, ctg->name, DWGSIM_MAX_TRIES);
+                  exit(1);
+              }
+          }
+          sink_buf_next(ctg->opt->sink, &b->out);
+      }
+      sink_buf_close(ctg->opt->sink, &b->out);
+  }
+  return NULL;
+}
+
+// writes the blocks in order
+static void
+dwgsim_round_write(void *arg)
+{
+  dwgsim_round_t *round = (dwgsim_round_t*)arg;
+  int32_t i;
+  for(i=0;i<round->n_blocks;i++) {
+      sink_buf_write(round->sink, &round->blocks[i].out);
+  }
+}
+
+// reads the next contig into "seq", returning its length, or -1 if there are
+// no more contigs
+static int32_t
+dwgsim_read_contig(dwgsim_opt_t *opt, const twobit_t *tb, const fai_t *fai, int32_t contig_i, refseq_t *seq, char *name)
+{
+  if(NULL != tb) { // packed
+      if(tb->n <= contig_i) return -1;
+      strcpy(name, tb->contigs[contig_i].name);
+      twobit_read(tb, contig_i, seq);
+      return seq->l;
+  }
+  else if(NULL != fai) { // random access
+      if(fai->n <= contig_i) return -1;
+      strcpy(name, fai->contigs[contig_i].name);
+      fai_read(fai, contig_i, seq, opt->num_threads);
+      return seq->l;
+  }
+  return refseq_read_fasta(opt->gz_fa, seq, name, 0);
+}
+
 void dwgsim_core(dwgsim_opt_t * opt)
 {
-  seq_t seq;
+  refseq_t seq;
   mutseq_t *mutseq[2]={NULL,NULL};
-  uint64_t tot_len, ii=0, ctr=0;
+  uint64_t tot_len, tot_usable, ii=0, ctr=0;
   int i, l, m, n_ref, contig_i;
-  char name[1024], *qstr;
-  int size[2], prev_skip=0, qstr_l=0;
-  int num_n[2];
-  uint8_t *tmp_seq[2]={NULL,NULL};
-  uint8_t *tmp_seq_flow_mask[2]={NULL,NULL};
-  int32_t tmp_seq_mem[2]={0,0};
+  long double mass, tot_mass; // the (weighted) bases to cover, in this contig and in all
+  double unreachable, n_unreachable = 0.0; // the probability of fragment lengths that cannot be placed
+  char name[1024];
+  int size[2], prev_skip=0;
   int64_t n_sim = 0;
-  error_t *e[2]={NULL,NULL};
   FILE *fp_muts_input = NULL;
   FILE *fp_regions_bed = NULL;
   muts_input_t *muts_input = NULL;
   regions_bed_txt *regions_bed = NULL;
+  frag_len_t *insert_hist = NULL;
   contigs_t *contigs = NULL;
+  dwgsim_worker_t *workers = NULL;
+  pthread_t *threads = NULL;
+  dwgsim_block_t *blocks = NULL;
+  int32_t max_blocks, n_rounds;
+  dwgsim_round_t *rounds = NULL, *round = NULL;
+  uint64_t round_i = 0;
+  writer_t *writer = NULL;
+  double t_gen = 0.0, t;
+  dwgsim_contig_t ctg;
+  fai_t *fai = NULL;
+  gzi_t *gzi = NULL;
+  twobit_t *tb = NULL;
 
-  e[0] = &opt->e[0]; e[1] = &opt->e[1];
+  refseq_init(&seq);
+  memset(&ctg, 0, sizeof(dwgsim_contig_t));
+  size[0] = opt->length[0]; size[1] = opt->length[1];
 
-  INIT_SEQ(seq);
-  seq_set_block_size(0x1000000);
-  l = opt->length[0] > opt->length[1]? opt->length[0] : opt->length[1];
-  qstr_l = l;
-  qstr = (char*)calloc(qstr_l+1, 1);
-  tmp_seq[0] = (uint8_t*)calloc(l+2, 1);
-  tmp_seq[1] = (uint8_t*)calloc(l+2, 1);
-  if(IONTORRENT == opt->data_type) {
-      tmp_seq_flow_mask[0] = (uint8_t*)calloc(l+2, 1);
-      tmp_seq_flow_mask[1] = (uint8_t*)calloc(l+2, 1);
+  // the worker threads and the blocks they fill per round
+  max_blocks = opt->num_threads * DWGSIM_BLOCKS_PER_THREAD;
+  workers = calloc(opt->num_threads, sizeof(dwgsim_worker_t));
+  threads = calloc(opt->num_threads, sizeof(pthread_t));
+  // one round being generated, and up to the writer depth being written
+  n_rounds = opt->writer_depth + 1;
+  rounds = calloc(n_rounds, sizeof(dwgsim_round_t));
+  blocks = calloc(max_blocks * n_rounds, sizeof(dwgsim_block_t));
+  for(i=0;i<max_blocks * n_rounds;i++) {
+      sink_buf_init(&blocks[i].out);
+  }
+  for(i=0;i<n_rounds;i++) {
+      rounds[i].sink = opt->sink;
+      rounds[i].blocks = blocks + i * max_blocks;
+  }
+  writer = writer_init(opt->writer_depth);
+  for(i=0;i<opt->num_threads;i++) {
+      dwgsim_worker_init(&workers[i], opt);
+      workers[i].ctg = &ctg;
+      workers[i].tid = i;
+      workers[i].num_threads = opt->num_threads;
   }
-  tmp_seq_mem[0] = tmp_seq_mem[1] = l+2;
-  size[0] = opt->length[0]; size[1] = opt->length[1];
   
-  if(0 <= opt->fn_muts_input_type) {
+  if(0 <= opt->fn_muts_input_type || 1 == sink_needs_contigs(opt->sink)) {
       contigs = contigs_init();
   }
   
@@ -459,30 +1081,97 @@ void dwgsim_core(dwgsim_opt_t * opt)
       if(NULL == contigs) contigs = contigs_init();
   }
 
-  tot_len = n_ref = 0;
-  if(NULL != opt->fp_fai) {
-      int dummy_int[3];
-      while(0 < fscanf(opt->fp_fai, "%s\t%d\t%d\t%d\t%d", name, &l, &dummy_int[0], &dummy_int[1], &dummy_int[2])) {
-          fprintf(stderr, "[dwgsim_core] %s length: %d\n", name, l);
-          tot_len += l;
+  if(NULL != opt->fn_insert_hist && 0 < opt->length[1]) {
+      double mean, sd;
+      FILE *fp = fopen(opt->fn_insert_hist, "r");
+      if(NULL == fp) {
+          fprintf(stderr, "[dwgsim_core] could not open the insert size histogram '%s'\n", opt->fn_insert_hist);
+          exit(1);
+      }
+      insert_hist = frag_len_read(fp);
+      fclose(fp);
+      frag_len_moments(insert_hist, &mean, &sd);
+      fprintf(stderr, "[dwgsim_core] insert sizes from %d to %d, mean: %.2f, standard deviation: %.2f\n",
+              insert_hist->lo, insert_hist->lo + insert_hist->n - 1, mean, sd);
+  }
+
+  // the reference: a UCSC .2bit, the cache next to the FASTA (built on first
+  // use), the FASTA through its .fai, or else the FASTA read sequentially
+  if(1 == twobit_is_ucsc(opt->fp_fa)) {
+      tb = twobit_init(opt->fp_fa);
+  }
+  else {
+      if(NULL != opt->fp_fai) {
+          switch(gzi_is_gzip(opt->fp_fa)) {
+            case GZI_PLAIN:
+              fai = fai_init(opt->fp_fa, opt->fp_fai, NULL);
+              break;
+            case GZI_BGZF:
+              gzi = gzi_init(opt->fp_fa, opt->fp_gzi);
+              fai = fai_init(opt->fp_fa, opt->fp_fai, gzi);
+              break;
+            default:
+              fprintf(stderr, "[dwgsim_core] the FASTA is not BGZF-compressed, ignoring the .fai\n");
+              break;
+          }
+      }
+      tb = twobit_cache_open(opt->fn_cache, opt->fp_fa);
+      if(NULL == tb) {
+          fprintf(stderr, "[dwgsim_core] building the reference cache %s\n", opt->fn_cache);
+          if(1 == twobit_cache_build(opt->fn_cache, opt->fp_fa, opt->gz_fa, fai, opt->num_threads)) {
+              tb = twobit_cache_open(opt->fn_cache, opt->fp_fa);
+          }
+          if(NULL == tb) {
+              fprintf(stderr, "[dwgsim_core] could not build the reference cache, reading the FASTA instead\n");
+              gzrewind(opt->gz_fa);
+          }
+      }
+      if(NULL != tb) {
+          fai_destroy(fai);
+          gzi_destroy(gzi);
+          fai = NULL;
+          gzi = NULL;
+      }
+  }
+
+  tot_len = tot_usable = n_ref = 0;
+  if(NULL != tb) {
+      for(i=0;i<tb->n;i++) {
+          fprintf(stderr, "[dwgsim_core] %s length: %d\n", tb->contigs[i].name, tb->contigs[i].len);
+          tot_len += tb->contigs[i].len;
+          tot_usable += tb->contigs[i].len - twobit_n_bases(tb, i);
           ++n_ref;
           if(NULL != contigs) {
-              contigs_add(contigs, name, l);
+              contigs_add(contigs, tb->contigs[i].name, tb->contigs[i].len);
+          }
+      }
+  }
+  else if(NULL != fai) {
+      for(i=0;i<fai->n;i++) {
+          fprintf(stderr, "[dwgsim_core] %s length: %d\n", fai->contigs[i].name, fai->contigs[i].len);
+          tot_len += fai->contigs[i].len;
+          tot_usable += fai->contigs[i].len; // the N runs are not known until the contig is read
+          ++n_ref;
+          if(NULL != contigs) {
+              contigs_add(contigs, fai->contigs[i].name, fai->contigs[i].len);
           }
       }
   }
   else {
-      while ((l = seq_read_fasta(opt->fp_fa, &seq, name, 0)) >= 0) {
+      while ((l = refseq_read_fasta(opt->gz_fa, &seq, name, 0)) >= 0) {
           fprintf(stderr, "[dwgsim_core] %s length: %d\n", name, l);
           tot_len += l;
+          tot_usable += l - refseq_n_bases(&seq);
           ++n_ref;
           if(NULL != contigs) {
               contigs_add(contigs, name, l);
           }
       }
   }
-  fprintf(stderr, "[dwgsim_core] %d sequences, total length: %llu\n", n_ref, (long long)tot_len);
-  rewind(opt->fp_fa);
+  fprintf(stderr, "[dwgsim_core] %d sequences, total length: %llu", n_ref, (long long)tot_len);
+  if(NULL == fai) fprintf(stderr, ", non-N bases: %llu", (long long)tot_usable);
+  fprintf(stderr, "\n");
+  if(NULL == tb && NULL == fai) gzrewind(opt->gz_fa);
 
   if(0 <= opt->fn_muts_input_type) {
       fp_muts_input = xopen(opt->fn_muts_input, "r");
@@ -490,12 +1179,16 @@ void dwgsim_core(dwgsim_opt_t * opt)
   }
   
   if(NULL != opt->fn_regions_bed) {
-      regions_bed = regions_bed_init(fp_regions_bed, contigs);
+      regions_bed = regions_bed_init(fp_regions_bed, contigs, opt->region_weights);
       // recalculate the total length
-      tot_len = 0;
-      for(i=0;i<regions_bed->n;i++) {
-          tot_len += regions_bed->end[i] - regions_bed->start[i] + 1;
-      }
+      tot_len = regions_bed->cum_len[regions_bed->n];
+      tot_mass = regions_bed_tot_mass(regions_bed);
+  }
+  else {
+      tot_mass = tot_usable;
+  }
+  if(1 == sink_needs_contigs(opt->sink)) {
+      sink_set_contigs(opt->sink, contigs);
   }
   if(NULL != contigs) {
       contigs_destroy(contigs);
@@ -504,43 +1197,41 @@ void dwgsim_core(dwgsim_opt_t * opt)
 
   fprintf(stderr, "[dwgsim_core] Currently on: \n0");
   contig_i = 0;
-  while ((l = seq_read_fasta(opt->fp_fa, &seq, name, 0)) >= 0) {
+  while ((l = dwgsim_read_contig(opt, tb, fai, contig_i, &seq, name)) >= 0) {
       int64_t n_pairs;
       n_ref--;
+      // reads are only placed on non-N bases (see frag_init_gaps)
+      mass = (NULL == fai) ? l - refseq_n_bases(&seq) : l;
 
+      if(NULL != regions_bed) {
+          // recalculate l
+          m = regions_bed_len(regions_bed, contig_i);
+          mass = regions_bed_mass(regions_bed, contig_i);
+          if(0 == m) {
+              fprintf(stderr, "[dwgsim_core] #0 skip sequence '%s' as it is not in the targeted region\n", name);
+              contig_i++;
+              continue; // skip this region
+          }
+          l = m;
+      }
       if(0 == n_ref && opt->C < 0) {
           n_pairs = opt->N - n_sim;
       }
       else {
-          if(NULL != regions_bed) {
-              // recalculate l
-              m = 0;
-              for(i=0;i<regions_bed->n;i++) {
-                  if(contig_i == regions_bed->contig[i]) {
-                      m += regions_bed->end[i] - regions_bed->start[i] + 1;
-                  }
-              }
-              if(0 == m) {
-                  fprintf(stderr, "[dwgsim_core] #0 skip sequence '%s' as it is not in the targeted region\n", name);
-                  contig_i++;
-                  continue; // skip this region
-              }
-              l = m;
-          }
           if(0 < opt->N) {
               // based on -N
-              n_pairs = (uint64_t)((long double)l / tot_len * opt->N + 0.5);
+              n_pairs = (uint64_t)(mass / tot_mass * opt->N + 0.5);
               if(opt->N - n_sim < n_pairs) n_pairs = opt->N - n_sim; // make sure we don't simulate too many reads
           }
           else {
               // based on coverage, with added random reads
-              n_pairs = (uint64_t)(l * opt->C / ((long double)(size[0] + size[1])) / (1.0 - opt->rand_read) + 0.5);
+              n_pairs = (uint64_t)((double)mass * opt->C / ((long double)(size[0] + size[1])) / (1.0 - opt->rand_read) + 0.5);
           }
       }
 
       // for paired end/mate pair, make sure we have enough bases in this
       // sequence
-      if (0 < opt->length[1] && l < opt->dist + 3 * opt->std_dev) {
+      if (0 < opt->length[1] && NULL == insert_hist && l < opt->dist + 3 * opt->std_dev) {
           if(0 == prev_skip) fprintf(stderr, "\n");
           prev_skip = 1;
           fprintf(stderr, "[dwgsim_core] #1 skip sequence '%s' as it is shorter than %f!\n", name, opt->dist + 3 * opt->std_dev);
@@ -556,8 +1247,43 @@ void dwgsim_core(dwgsim_opt_t * opt)
       }
       else if (n_pairs < 0) { // NB: this should not happen
           // not enough pairs
+          contig_i++;
           continue;
       }
+
+      // the fragment lengths that cannot be placed
+      unreachable = 0.0;
+      if(NULL != regions_bed) {
+          frag_len_t *fl = dwgsim_frag_len(opt, insert_hist, l);
+          ctg.frag = frag_init(regions_bed, contig_i, fl, opt->length[0] + opt->length[1]);
+          frag_len_destroy(fl);
+          if(0 == ctg.frag->n_d) {
+              if(0 == prev_skip) fprintf(stderr, "\n");
+              prev_skip = 1;
+              fprintf(stderr, "[dwgsim_core] #3 skip sequence '%s' as no fragment fits in its targeted regions!\n", name);
+              frag_destroy(ctg.frag);
+              ctg.frag = NULL;
+              contig_i++;
+              continue;
+          }
+          unreachable = ctg.frag->unreachable;
+      }
+      else {
+          frag_len_t *fl = dwgsim_frag_len(opt, insert_hist, l);
+          ctg.frag = frag_init_gaps(&seq, opt->max_n, fl, dwgsim_frag_extra(opt));
+          frag_len_destroy(fl);
+          if(0 == ctg.frag->n_d) {
+              if(0 == prev_skip) fprintf(stderr, "\n");
+              prev_skip = 1;
+              fprintf(stderr, "[dwgsim_core] #4 skip sequence '%s' as no fragment fits in a window with at most %d Ns (-n)!\n", name, opt->max_n);
+              frag_destroy(ctg.frag);
+              ctg.frag = NULL;
+              contig_i++;
+              continue;
+          }
+          unreachable = ctg.frag->unreachable;
+      }
+      n_unreachable += n_pairs * unreachable;
       prev_skip = 0;
 
       // generate mutations and print them out
@@ -565,405 +1291,87 @@ void dwgsim_core(dwgsim_opt_t * opt)
       mut_diref(opt, &seq, mutseq[0], mutseq[1], contig_i, muts_input);
       mut_print(name, &seq, mutseq[0], mutseq[1], opt->fp_mut, opt->fp_vcf);
 
-      for (ii = 0; ii != n_pairs; ++ii, ++ctr) { // the core loop
-          if(0 == (ctr % 10000)) {
-              fprintf(stderr, "\r[dwgsim_core] %llu",
-                      (unsigned long long int)ctr);
-          }
-          double ran;
-          int d, pos, s[2], strand[2];
-          int n_sub[2], n_indel[2], n_err[2], ext_coor[2]={0,0}, j, k;
-          int n_sub_first[2], n_indel_first[2], n_err_first[2]; // need this for SOLID data
-          int c1, c2, c;
-
-          s[0] = size[0]; s[1] = size[1];
-
-          if(opt->rand_read < drand48()) { 
-
-              if(NULL == regions_bed) {
-                  do { // avoid boundary failure
-                      if(0 < s[1]) { // paired end/mate pair
-                          ran = ran_normal();
-                          ran = ran * opt->std_dev + opt->dist;
-                          d = (int)(ran + 0.5);
-                      }
-                      else {
-                          d = 0;
-                      }
-                      pos = (int)((l - d + 1) * drand48());
-                  } while (pos < 0 
-                           || pos >= seq.l 
-                           || pos + d - 1 >= seq.l 
-                           || (0 < s[1] && 0 == opt->is_inner && ((0 < s[0] && d <= s[1]) || (d <= s[0] && 0 < s[1]))));
-              } 
-              else {
-                  do { // avoid boundary failure
-                      if(0 < s[1]) {
-                          ran = ran_normal();
-                          ran = ran * opt->std_dev + opt->dist;
-                          d = (int)(ran + 0.5);
-                      }
-                      else {
-                          d = 0;
-                      }
-                      pos = (int)((l - d + 1) * drand48());
-                      // convert in the bed file
-                      for(i=0;i<regions_bed->n;i++) { // TODO: regions are in sorted order... so optimize
-                          if(contig_i == regions_bed->contig[i]) {
-                              j = regions_bed->end[i] - regions_bed->start[i] + 1;
-                              if(pos < j) {
-                                  pos = regions_bed->start[i] + pos - 1; // zero-based
-                                  break;
-                              }
-                              else {
-                                  pos -= j;
-                              }
-                          }
-                      }
-                  } while (pos < 0 
-                           || pos >= seq.l 
-                           || pos + d - 1 >= seq.l 
-                           || (0 < s[1] && 0 == opt->is_inner && ((0 < s[0] && d <= s[1]) || (d <= s[0] && 0 < s[1])))
-                           || 0 == regions_bed_query(regions_bed, contig_i, pos, pos + s[0] + s[1] + d - 1));
-              }
-
-              // generate the read sequences
-              mutseq_t *currseq = mutseq[drand48()<opt->mut_freq?0:1]; // haplotype from which the reads are generated
-              n_sub[0] = n_sub[1] = n_indel[0] = n_indel[1] = n_err[0] = n_err[1] = 0;
-              n_sub_first[0] = n_sub_first[1] = n_indel_first[0] = n_indel_first[1] = n_err_first[0] = n_err_first[1] = 0;
-              num_n[0]=num_n[1]=0;
-
-              // strand
-              if(2 == opt->strandedness || (0 == opt->strandedness && ILLUMINA == opt->data_type)) {
-                  // opposite strand by default for Illumina
-                  strand[0] = 0; strand[1] = 1; 
-              }
-              else if(1 == opt->strandedness || (0 == opt->strandedness && (SOLID == opt->data_type || IONTORRENT == opt->data_type))) {
-                  // same strands by default for SOLiD
-                  strand[0] = 0; strand[1] = 0; 
-              }
-              else {
-                  // should not reach here
-                  assert(1 == 0);
-              }
-              if (drand48() < 0.5) { // which strand ?
-                  // Flip strands 
-                  strand[0] = (1 + strand[0]) % 2;
-                  strand[1] = (1 + strand[1]) % 2;
-              }
-
-              // generate the reads in base space
-              if(0 < s[1]) { // paired end or mate pair
-                  if(strand[0] == strand[1]) { // same strand
-                      if(0 == strand[0]) { // + strand
-                          /*
-                           * 5' E2 -----> .... E1 -----> 3'
-                           * 3'           ....           5'
-                           */
-                          if(0 == opt->is_inner) {
-                              __gen_read(0, pos + d - s[0], ++i); 
-                          }
-                          else {
-                              __gen_read(0, pos + s[1] + d, ++i); 
-                          }
-                          __gen_read(1, pos, ++i);
-                      }
-                      else { // - strand
-                          /*
-                           * 3'           ....            5'
-                           * 5' <----- E1 .... <----- E2  3'
-                           */
-                          __gen_read(0, pos + s[0], --i);
-                          if(0 == opt->is_inner) {
-                              __gen_read(1, pos + d, --i);
-                          }
-                          else {
-                              __gen_read(1, pos + s[0] + d + s[1], --i);
-                          }
-                      }
-                  }
-                  else { // opposite strand
-                      if(0 == strand[0]) { // + strand
-                          /*
-                           * 5' E1 -----> ....           3'
-                           * 3'           .... <----- E2 5'
-                           */
-                          __gen_read(0, pos, ++i);
-                          if(0 == opt->is_inner) {
-                              __gen_read(1, pos + d, --i);
-                          }
-                          else {
-                              __gen_read(1, pos + s[0] + d + s[1], --i);
-                          }
-                      }
-                      else { // - strand
-                          /*
-                           * 5' E2 -----> ....           3'
-                           * 3'           .... <----- E1 5'
-                           */
-                          if(0 == opt->is_inner) {
-                              __gen_read(0, pos + d, --i);
-                          }
-                          else {
-                              __gen_read(0, pos + s[1] + d + s[0], --i); 
-                          }
-                          __gen_read(1, pos, i++);
-                      }
-                  }
-              }
-              else { // fragment
-                  if(0 == strand[0]) {
-                      __gen_read(0, pos, ++i); // + strand
-                  }
-                  else {
-                      __gen_read(0, pos + s[0] - 1, --i); // - strand
-                  }
-              }
-
-              // Count # of Ns
-              for (j = 0; j < 2; ++j) {
-                  num_n[j]=0;
-                  if(0 < s[j]) {
-                      for (i = 0; i < s[j]; ++i) {
-                          if(tmp_seq[j][i] == 4) num_n[j]++;
-                      }
-                  }
-              }
-
-              if (ext_coor[0] < 0 || ext_coor[1] < 0 || opt->max_n < num_n[0] || opt->max_n < num_n[1]) { // fail to generate the read(s)
-                  --ii;
-                  --ctr;
-                  continue;
-              }
-
-              if(SOLID == opt->data_type) {
-                  // Convert to color sequence, use the first base as the adaptor
-                  for (j = 0; j < 2; ++j) {
-                      if(0 < s[j]) {
-                          c1 = 0; // adaptor 
-                          for (i = 0; i < s[j]; ++i) {
-                              c2 = tmp_seq[j][i]; // current base
-                              c = __gf_add(c1, c2);
-                              tmp_seq[j][i] = c;
-                              c1 = c2; // save previous base
-                          }
-                      }
-                  }
-              }
-
-              // generate sequencing errors
-              if(IONTORRENT == opt->data_type) {
-                  s[0] = generate_errors_flows(opt, &tmp_seq[0], &tmp_seq_flow_mask[0], &tmp_seq_mem[0], s[0], strand[0], e[0]->start, &n_err[0]);
-                  s[1] = generate_errors_flows(opt, &tmp_seq[1], &tmp_seq_flow_mask[1], &tmp_seq_mem[1], s[1], strand[1], e[1]->start, &n_err[1]);
-              }
-              else { // Illumina/SOLiD
-                  if(0 < s[0]) {
-                      if(0 == strand[0]) { 
-                          __gen_errors_mismatches(tmp_seq, 0, 0, ++i, s[0]); 
-                      }
-                      else { 
-                          __gen_errors_mismatches(tmp_seq, 0, s[0]-1, --i, s[0]); 
-                      }
-                  }
-                  if(0 < s[1]) {
-                      if(0 == strand[1]) { 
-                          __gen_errors_mismatches(tmp_seq, 1, 0, ++i, s[1]); 
-                      }
-                      else { 
-                          __gen_errors_mismatches(tmp_seq, 1, s[1]-1, --i, s[1]); 
-                      }
-                  }
-              }
-
-              // print
-              for (j = 0; j < 2; ++j) {
-                  if(s[j] <= 0) {
-                      continue;
-                  }
-                  if(IONTORRENT == opt->data_type && qstr_l < s[j]) {
-                      qstr_l = s[j];
-                      qstr = realloc(qstr, (1+qstr_l) * sizeof(char));
-                  }
-                  if(NULL != opt->fixed_quality) {
-                      for (i = 0; i < s[j]; ++i) {
-                          qstr[i] = opt->fixed_quality[0];
-                      }
-                  }
-                  else {
-                      for (i = 0; i < s[j]; ++i) {
-                          qstr[i] = (int)(-10.0 * log(e[j]->start + e[j]->by*i) / log(10.0) + 0.499) + 33;
-                      }
-                  }
-                  qstr[i] = 0;
-                  // BWA
-                  FILE *fpo = (0 == j) ? opt->fp_bwa1: opt->fp_bwa2;
-                  if(ILLUMINA == opt->data_type || IONTORRENT == opt->data_type) {
-                      fprintf(fpo, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx/%d\n", 
-                              (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                              (NULL == opt->read_prefix) ? "" : "_",
-                              name, ext_coor[0]+1, ext_coor[1]+1, strand[0], strand[1], 0, 0,
-                              n_err[0], n_sub[0], n_indel[0],
-                              n_err[1], n_sub[1],n_indel[1],
-                              (long long)ii, j+1);
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], fpo);
-                      fprintf(fpo, "\n+\n%s\n", qstr);
-                  }
-                  else {
-                      // Note: BWA ignores the adapter and the first color, so this is a misrepresentation 
-                      // in samtools.  We must first skip the first color.  Basically, a 50 color read is a 
-                      // 49 color read for BWA.
-                      //
-                      // Note: BWA outputs F3 to read1, annotated as read "2", and outputs R3 to read2,
-                      // annotated as read "1".
-                      fprintf(fpo, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx/%d\n", 
-                              (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                              (NULL == opt->read_prefix) ? "" : "_",
-                              name, ext_coor[0]+1, ext_coor[1]+1, strand[0], strand[1], 0, 0,
-                              n_err[0] - n_err_first[0], n_sub[0] - n_sub_first[0], n_indel[0] - n_indel_first[0], 
-                              n_err[1] - n_err_first[1], n_sub[1] - n_sub_first[1], n_indel[1] - n_indel_first[1],
-                              (long long)ii, 2 - j);
-                      //fputc('A', fpo);
-                      for (i = 1; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], fpo);
-                      fprintf(fpo, "\n+\n");
-                      for (i = 1; i < s[j]; ++i) 
-                        fputc(qstr[i], fpo);
-                      fprintf(fpo, "\n");
-                  }
+      ctg.opt = opt;
+      ctg.seq = &seq;
+      ctg.mutseq[0] = mutseq[0]; ctg.mutseq[1] = mutseq[1];
+      ctg.name = name;
+      ctg.contig_i = contig_i;
+      ctg.first_id = n_sim;
+      if(NULL != opt->coverage) coverage_reset(opt->coverage, seq.l);
 
-                  // BFAST output
-                  fprintf(opt->fp_bfast, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx\n", 
-                          (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                          (NULL == opt->read_prefix) ? "" : "_",
-                          name, ext_coor[0]+1, ext_coor[1]+1, strand[0], strand[1], 0, 0,
-                          n_err[0], n_sub[0], n_indel[0], n_err[1], n_sub[1], n_indel[1],
-                          (long long)ii);
-                  if(ILLUMINA == opt->data_type || IONTORRENT == opt->data_type) {
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n+\n%s\n", qstr);
-                  }
-                  else {
-                      fputc('A', opt->fp_bfast);
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("01234"[(int)tmp_seq[j][i]], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n+\n");
-                      for (i = 0; i < s[j]; ++i) 
-                        fputc(qstr[i], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n");
+      for (ii = 0; ii < n_pairs; ) { // the core loop
+          int32_t n_blocks;
+          // the writer is done with this round's blocks (see writer_push)
+          round = &rounds[round_i % n_rounds];
+          // split the next read pairs into blocks
+          for(n_blocks=0;n_blocks<max_blocks && ii < n_pairs;n_blocks++) {
+              round->blocks[n_blocks].start = ii;
+              ii += DWGSIM_BLOCK_SIZE;
+              if(n_pairs < ii) ii = n_pairs;
+              round->blocks[n_blocks].end = ii;
+          }
+          // generate
+          t = writer_time();
+          for(i=0;i<opt->num_threads;i++) {
+              workers[i].blocks = round->blocks;
+              workers[i].n_blocks = n_blocks;
+          }
+          if(1 == opt->num_threads) {
+              dwgsim_worker_run(&workers[0]);
+          }
+          else {
+              for(i=0;i<opt->num_threads;i++) {
+                  if(0 != pthread_create(&threads[i], NULL, dwgsim_worker_run, &workers[i])) {
+                      fprintf(stderr, "[dwgsim_core] could not create thread %d\n", i);
+                      exit(1);
                   }
               }
-              n_sim++;
-          }
-          else { // random DNA read
-              for(j=0;j<2;j++) {
-                  if(s[j] <= 0) {
-                      continue;
-                  } 
-                  if(IONTORRENT == opt->data_type && qstr_l < s[j]) {
-                      qstr_l = s[j];
-                      qstr = realloc(qstr, (1+qstr_l) * sizeof(char));
-                  }
-                  // get random sequence
-                  for (i = 0; i < s[j]; ++i) {
-                      tmp_seq[j][i] = (int)(drand48() * 4.0) & 3;
-                  }
-                  if(NULL != opt->fixed_quality) {
-                      for (i = 0; i < s[j]; ++i) {
-                          qstr[i] = opt->fixed_quality[0];
-                      }
-                  }
-                  else {
-                      for (i = 0; i < s[j]; ++i) {
-                          qstr[i] = (int)(-10.0 * log(e[j]->start + e[j]->by*i) / log(10.0) + 0.499) + 33;
-                      }
-                  }
-                  qstr[i] = 0;
-                  if(SOLID == opt->data_type) { // convert to color space
-                      if(0 < s[j]) {
-                          c1 = 0; // adaptor 
-                          for (i = 0; i < s[j]; ++i) {
-                              c2 = tmp_seq[j][i]; // current base
-                              c = __gf_add(c1, c2);
-                              tmp_seq[j][i] = c;
-                              c1 = c2; // save previous base
-                          }
-                      }
-                  }
-                  // BWA
-                  FILE *fpo = (0 == j) ? opt->fp_bwa1: opt->fp_bwa2;
-                  if(ILLUMINA == opt->data_type || IONTORRENT == opt->data_type) {
-                      fprintf(fpo, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx/%d\n", 
-                              (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                              (NULL == opt->read_prefix) ? "" : "_",
-                              "rand", 0, 0, 0, 0, 1, 1,
-                              0, 0, 0, 0, 0, 0,
-                              (long long)ii,
-                              j+1);
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], fpo);
-                      fprintf(fpo, "\n+\n%s\n", qstr);
-                  }
-                  else {
-                      // Note: BWA ignores the adapter and the first color, so this is a misrepresentation 
-                      // in samtools.  We must first skip the first color.  Basically, a 50 color read is a 
-                      // 49 color read for BWA.
-                      //
-                      // Note: BWA outputs F3 to read1, annotated as read "2", and outputs R3 to read2,
-                      // annotated as read "1".
-                      fprintf(fpo, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx/%d\n", 
-                              (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                              (NULL == opt->read_prefix) ? "" : "_",
-                              "rand", 0, 0, 0, 0, 1, 1,
-                              0, 0, 0, 0, 0, 0,
-                              (long long)ii, 2 - j);
-                      //fputc('A', fpo);
-                      for (i = 1; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], fpo);
-                      fprintf(fpo, "\n+\n");
-                      for (i = 1; i < s[j]; ++i) 
-                        fputc(qstr[i], fpo);
-                      fprintf(fpo, "\n");
-                  }
-
-                  // BFAST output
-                  fprintf(opt->fp_bfast, "@%s%s%s_%u_%u_%1u_%1u_%1u_%1u_%d:%d:%d_%d:%d:%d_%llx\n", 
-                          (NULL == opt->read_prefix) ? "" : opt->read_prefix,
-                          (NULL == opt->read_prefix) ? "" : "_",
-                          "rand", 0, 0, 0, 0, 1, 1,
-                          0, 0, 0, 0, 0, 0,
-                          (long long)ii);
-                  if(ILLUMINA == opt->data_type || IONTORRENT == opt->data_type) {
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("ACGTN"[(int)tmp_seq[j][i]], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n+\n%s\n", qstr);
-                  }
-                  else {
-                      fputc('A', opt->fp_bfast);
-                      for (i = 0; i < s[j]; ++i)
-                        fputc("01234"[(int)tmp_seq[j][i]], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n+\n");
-                      for (i = 0; i < s[j]; ++i) 
-                        fputc(qstr[i], opt->fp_bfast);
-                      fprintf(opt->fp_bfast, "\n");
+              for(i=0;i<opt->num_threads;i++) {
+                  if(0 != pthread_join(threads[i], NULL)) {
+                      fprintf(stderr, "[dwgsim_core] could not join thread %d\n", i);
+                      exit(1);
                   }
               }
-              n_sim++;
           }
+          t_gen += writer_time() - t;
+          // write in block order
+          for(i=0;i<n_blocks;i++) {
+              ctr += round->blocks[i].end - round->blocks[i].start;
+          }
+          round->n_blocks = n_blocks;
+          writer_push(writer, dwgsim_round_write, round);
+          round_i++;
+          fprintf(stderr, "\r[dwgsim_core] %llu",
+                  (unsigned long long int)ctr);
       }
+      n_sim += n_pairs;
+      frag_destroy(ctg.frag);
+      ctg.frag = NULL;
+      if(NULL != opt->coverage) coverage_write(opt->coverage, name);
       mutseq_destroy(mutseq[0]);
       mutseq_destroy(mutseq[1]);
       fprintf(stderr, "\r[dwgsim_core] %llu",
               (unsigned long long int)ctr);
       contig_i++;
   }
-  fprintf(stderr, "\n[dwgsim_core] Complete!\n");
-  free(seq.s); free(qstr);
-  free(tmp_seq[0]); free(tmp_seq[1]);
-  if(IONTORRENT == opt->data_type) {
-      free(tmp_seq_flow_mask[0]); free(tmp_seq_flow_mask[1]);
+  writer_sync(writer);
+  fprintf(stderr, "\n[dwgsim_core] generating: %.2fs, writing: %.2fs, blocked on output: %.2fs\n", t_gen, writer->t_write, writer->t_blocked);
+  if(0 < n_sim && 1e-6 < n_unreachable / n_sim) {
+      fprintf(stderr, "[dwgsim_core] %.4f%% of the fragment length distribution could not be placed, and was drawn from the rest\n", 100.0 * n_unreachable / n_sim);
+  }
+  fprintf(stderr, "[dwgsim_core] Complete!\n");
+  writer_destroy(writer);
+  refseq_destroy(&seq);
+  fai_destroy(fai);
+  gzi_destroy(gzi);
+  twobit_destroy(tb);
+  for(i=0;i<opt->num_threads;i++) {
+      dwgsim_worker_destroy(&workers[i]);
   }
+  for(i=0;i<max_blocks * n_rounds;i++) {
+      sink_buf_destroy(&blocks[i].out);
+  }
+  free(workers); free(threads); free(blocks); free(rounds);
   if(0 <= opt->fn_muts_input_type) {
       muts_input_destroy(muts_input);
   }
@@ -971,14 +1379,21 @@ void dwgsim_core(dwgsim_opt_t * opt)
       regions_bed_destroy(regions_bed);
       fclose(fp_regions_bed);
   }
+  frag_len_destroy(insert_hist);
 }
 
 int main(int argc, char *argv[])
 {
   dwgsim_opt_t *opt = NULL;
+  pipeline_t *pipeline = NULL;
+
+  if(1 < argc && 0 == strcmp(argv[1], "replay")) {
+      return replay_main(argc - 1, argv + 1);
+  }
 
   // update the mutant sequence bounds
   mutseq_init_bounds();
+  rng_normal_init();
 
   opt = dwgsim_opt_init();
 
@@ -991,25 +1406,44 @@ int main(int argc, char *argv[])
 
   // Open files
   opt->fp_fa =	xopen(argv[optind+0], "r");
+  opt->gz_fa = gzopen(argv[optind+0], "r");
+  if(NULL == opt->gz_fa) {
+      fprintf(stderr, "[main] could not open %s\n", argv[optind+0]);
+      return 1;
+  }
   strcpy(fn_fai, argv[optind+0]); strcat(fn_fai, ".fai");
   opt->fp_fai = fopen(fn_fai, "r"); // NB: depends on returning NULL;
+  strcpy(fn_tmp, argv[optind+0]); strcat(fn_tmp, ".gzi");
+  opt->fp_gzi = fopen(fn_tmp, "r"); // NB: depends on returning NULL;
+  strcpy(fn_tmp, argv[optind+0]); strcat(fn_tmp, ".dwgsim");
+  opt->fn_cache = strdup(fn_tmp);
   strcpy(fn_tmp, argv[optind+1]); strcat(fn_tmp, ".mutations.txt");
   opt->fp_mut = xopen(fn_tmp, "w");
+  setvbuf(opt->fp_mut, NULL, _IOFBF, (size_t)opt->buffer_size << 10);
   strcpy(fn_tmp, argv[optind+1]); strcat(fn_tmp, ".mutations.vcf");
   opt->fp_vcf = xopen(fn_tmp, "w");
-  strcpy(fn_tmp, argv[optind+1]); strcat(fn_tmp, ".bfast.fastq");
-  opt->fp_bfast = xopen(fn_tmp, "w");
-  strcpy(fn_tmp, argv[optind+1]); strcat(fn_tmp, ".bwa.read1.fastq");
-  opt->fp_bwa1 = xopen(fn_tmp, "w");
-  strcpy(fn_tmp, argv[optind+1]); strcat(fn_tmp, ".bwa.read2.fastq");
-  opt->fp_bwa2 = xopen(fn_tmp, "w");
+  setvbuf(opt->fp_vcf, NULL, _IOFBF, (size_t)opt->buffer_size << 10);
+  opt->sink = sink_init(argv[optind+1], opt->sinks, opt->data_type, (0 < opt->length[1]) ? 1 : 0, opt->compress_level, opt->read_prefix, (size_t)opt->buffer_size << 10,
+                        opt->chunk_reads, (int64_t)opt->chunk_size << 20);
+  if(1 == opt->write_coverage) {
+      opt->coverage = coverage_init(argv[optind+1], (size_t)opt->buffer_size << 10);
+  }
+  if(NULL != opt->aligner) { // stream the reads to the aligner
+      pipeline = pipeline_init(opt->aligner, opt->data_type, (0 < opt->length[1]) ? 1 : 0, opt->read_prefix, (size_t)opt->buffer_size << 10);
+      sink_attach(opt->sink, SINK_INTERLEAVED, pipeline->fp_in);
+  }
 
   // Run simulation
   dwgsim_core(opt);
 
   // Close files
-  fclose(opt->fp_fa); fclose(opt->fp_bfast); fclose(opt->fp_bwa1); fclose(opt->fp_bwa2); 
+  fclose(opt->fp_fa);
+  sink_destroy(opt->sink);
+  coverage_destroy(opt->coverage);
+  pipeline_destroy(pipeline);
+  gzclose(opt->gz_fa);
   if(NULL != opt->fp_fai) fclose(opt->fp_fai);
+  if(NULL != opt->fp_gzi) fclose(opt->fp_gzi);
   fclose(opt->fp_mut);
   fclose(opt->fp_vcf);
 
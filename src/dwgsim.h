@@ -1,11 +1,20 @@
 #ifndef DWGSIM_H
 #define DWGSIM_H
 
+#include "rng.h"
 #include "dwgsim_opt.h"
 
 #define __gf_add(_x, _y) ((_x >= 4 || _y >= 4) ? 4 : (_x ^ _y))
 #define __IS_TRUE(_val) ((_val == 1) ? "True" : "False")
 
+// the number of read pairs simulated per block
+#define DWGSIM_BLOCK_SIZE 10000
+// the number of blocks per thread simulated before writing
+#define DWGSIM_BLOCKS_PER_THREAD 4
+// the attempts at a read pair before giving up; fragments are drawn within
+// admissible windows, so only reads pushed out by indels are retried
+#define DWGSIM_MAX_TRIES 10000
+
 extern uint8_t nst_nt4_table[256];
 
 enum data_type_t {
@@ -21,6 +30,6 @@ char bases_to_iupac(char b1, char b2);
 int32_t get_muttype(char *str);
 
 int32_t
-generate_errors_flows(dwgsim_opt_t *opt, uint8_t **seq, uint8_t **mask, int32_t *mem, int32_t len, uint8_t strand, double e, int32_t *_n_err);
+generate_errors_flows(dwgsim_opt_t *opt, rng_t *rng, uint8_t **seq, uint8_t **mask, int32_t *mem, int32_t len, uint8_t strand, double e, int32_t *_n_err);
 
 #endif
@@ -0,0 +1,493 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include "dwgsim_eval_counts.h"
+
+#define BREAK_LINE "************************************************************\n"
+void
+dwgsim_eval_print_error(char* FunctionName, char *VariableName, char* Message, int Action, int type)
+{
+  static char ErrorString[][20]=
+    { "\0", "OutOfRange", "InputArguments", "IllegalFileName", "IllegalPath", "OpenFileError", "EndOfFile", "ReallocMemory", "MallocMemory", "ThreadError", "ReadFileError", "WriteFileError", "DeleteFileError"};
+  static char ActionType[][20]={"Fatal Error", "Warning"};
+  fprintf(stderr, "%s\rIn function \"%s\": %s[%s]. ",
+          BREAK_LINE, FunctionName, ActionType[Action], ErrorString[type]);
+
+  /* Only print variable name if is available */
+  if(VariableName) {
+      fprintf(stderr, "Variable/Value: %s.\n", VariableName);
+  }
+  /* Only print message name if is available */
+  if(Message) {
+      fprintf(stderr, "Message: %s.\n", Message);
+  }
+  if(type == ReadFileError ||
+     type == OpenFileError ||
+     type == WriteFileError) {
+      perror("The file stream error was:");
+  }
+
+  switch(Action) {
+    case Exit:
+      fprintf(stderr, " ***** Exiting due to errors *****\n");
+      fprintf(stderr, "%s", BREAK_LINE);
+      exit(EXIT_FAILURE);
+      break; /* Not necessary actually! */
+    case Warn:
+      fprintf(stderr, " ***** Warning *****\n");
+      fprintf(stderr, "%s", BREAK_LINE);
+      break;
+    default:
+      fprintf(stderr, "Trouble!!!\n");
+      fprintf(stderr, "%s", BREAK_LINE);
+  }
+}
+
+
+
+int32_t
+dwgsim_eval_process(dwgsim_eval_counts_t *counts,
+                    dwgsim_eval_args_t *args,
+                    const dwgsim_eval_aln_t *aln,
+                    int32_t n_targets,
+                    char **target_name)
+{
+  char *FnName="dwgsim_eval_process";
+  int32_t left, metric=INT_MIN;
+  const char *chr=NULL;
+  char *name=NULL, *ptr=NULL;
+  char chr_name[1028]="\0";
+  const char *truth_chr = chr_name;
+  char read_num[1028]="\0";
+  int32_t pos_1, pos_2, str_1, str_2, rand_1, rand2; 
+  int32_t n_err_1, n_sub_1, n_indel_1, n_err_2, n_sub_2, n_indel_2;
+  int32_t pos, str, rand;
+  int32_t n_err, n_sub, n_indel;
+  int32_t i, j, tmp;
+  int32_t predicted_value, actual_value;
+
+  // mapping quality threshold
+  if(aln->qual < args->q) return -1;
+
+  if(NULL != args->T) { // the read pair number, with the truth in the sidecar
+      const char *id = aln->qname;
+      const sidecar_rec_t *rec = NULL;
+      char *end = NULL;
+      if(NULL != args->P) {
+          tmp = strlen(args->P);
+          if(0 != strncmp(args->P, id, tmp) || '_' != id[tmp]) {
+              dwgsim_eval_print_error(FnName, (char*)aln->qname, "[dwgsim_eval] could not match read name with given read name prefix (-P)", Exit, OutOfRange);
+              return -1;
+          }
+          id += tmp + 1;
+      }
+      rec = sidecar_get(args->T, strtoull(id, &end, 10));
+      if(end == id || ('\0' != *end && '/' != *end) || NULL == rec) {
+          dwgsim_eval_print_error(FnName, (char*)aln->qname, "[dwgsim_eval] read is not in the truth sidecar (-T)", Exit, OutOfRange);
+          return -1;
+      }
+      truth_chr = (rec->contig < 0) ? "rand" : sidecar_contig(args->T, rec->contig);
+      pos_1 = rec->pos[0]; pos_2 = rec->pos[1];
+      str_1 = rec->strand[0]; str_2 = rec->strand[1];
+      rand_1 = rand2 = rec->is_rand;
+      n_err_1 = rec->n_err[0]; n_sub_1 = rec->n_sub[0]; n_indel_1 = rec->n_indel[0];
+      n_err_2 = rec->n_err[1]; n_sub_2 = rec->n_sub[1]; n_indel_2 = rec->n_indel[1];
+  }
+  else {
+      // parse read name
+      name = strdup(aln->qname);
+      ptr = name; // save to be freed
+      char *to_rm="_::_::_______"; // to remove
+      for(i=strlen(name),j=0;0<=i && j<13;i--) { // replace with spaces 
+          if(name[i] == to_rm[j]) {
+              name[i] = ' '; j++; 
+          }
+      }
+      // check for the prefix
+      if(NULL != args->P) {
+          j = strlen(name);
+          tmp = strlen(args->P);
+          if(j < tmp || 0 != strncmp(args->P, name, tmp)) {
+              dwgsim_eval_print_error(FnName, name, "[dwgsim_eval] could not match read name with given read name prefix (-P)", Exit, OutOfRange);
+              free(ptr);
+              return -1;
+          }
+          name += tmp + 1;
+      }
+      if(14 != sscanf(name, "%s %d %d %1d %1d %1d %1d %d %d %d %d %d %d %s",
+                      chr_name, &pos_1, &pos_2, &str_1, &str_2, &rand_1, &rand2,
+                      &n_err_1, &n_sub_1, &n_indel_1,
+                      &n_err_2, &n_sub_2, &n_indel_2,
+                      read_num)) {
+          dwgsim_eval_print_error(FnName, name, "[dwgsim_eval] read was not generated by dwgsim?", Exit, OutOfRange);
+          free(ptr);
+          return -1;
+      }
+      // check for a prefix, and make sure it was removed correctly
+      if(1 == args->z || (aln->flag & DWGSIM_EVAL_FREAD1)) {
+          rand = rand_1;
+      }
+      else {
+          rand = rand2;
+      }
+      if(0 == rand) {
+          for(j=0;j<n_targets;j++) {
+              i = strlen(name);
+              tmp = strlen(target_name[j]); 
+              i = (i < tmp) ? i : tmp;
+              if(0 == strncmp(name, target_name[j], i)) {
+                  break;
+              }
+          }
+          if(j == n_targets) {
+              dwgsim_eval_print_error(FnName, name, "[dwgsim_eval] the mapped contig does not exist in the SAM header; perhaps you have a read name prefix?", Exit, OutOfRange);
+          }
+      }
+      free(ptr);
+      ptr = name = NULL;
+  }
+
+  // get metric value
+  if(0 == args->a) {
+      metric = (aln->qual / args->d); 
+      if(DWGSIM_EVAL_MAXQ < metric) metric = DWGSIM_EVAL_MAXQ;
+  }
+  else if((DWGSIM_EVAL_FUNMAP & aln->flag) || 0 == aln->qual) { // unmapped or zero quality
+      metric = DWGSIM_EVAL_MINAS;
+  }
+  else {
+      metric = DWGSIM_EVAL_MINAS+1;
+      if(1 == args->a || 3 == args->a) {
+          if(0 == aln->has_as) {
+              metric = DWGSIM_EVAL_MINAS;
+          }
+      }
+      if(2 == args->a || 3 == args->a) {
+          if(0 == aln->has_xs) {
+              metric = DWGSIM_EVAL_MINAS;
+          }
+      }
+      if(metric != DWGSIM_EVAL_MINAS) {
+          switch(args->a) {
+            case 1:
+              metric = aln->as;
+              break;
+            case 2:
+              metric = aln->xs;
+              break;
+            case 3:
+              metric = aln->as - aln->xs;
+              break;
+            default:
+              metric = DWGSIM_EVAL_MINAS;
+              break;
+          }
+      }
+  }
+  metric /= args->d;
+  if(metric < DWGSIM_EVAL_MINAS) metric = DWGSIM_EVAL_MINAS;
+
+  if(1 == args->i) { // indels only
+      if(1 == args->z || (aln->flag & DWGSIM_EVAL_FREAD1)) {
+          if(0 == n_indel_1) return -1;
+      }
+      else {
+          if(0 == n_indel_2) return -1;
+      }
+  }
+  else if(0 <= args->e && n_err_1 !=  args->e) { // # of errors
+      return -1;
+  }
+  else if(0 <= args->s && n_sub_1 !=  args->s) { // # of snps
+      return -1;
+  }
+
+  if(1 == args->c && 1 == args->b) { // SOLiD and BWA
+      // Swap 1 and 2
+      tmp=n_err_1; n_err_1=n_err_2; n_err_2=tmp;
+      tmp=n_sub_1; n_sub_1=n_sub_2; n_sub_2=tmp;
+      tmp=n_indel_1; n_indel_1=n_indel_2; n_indel_2=tmp;
+  }
+
+  // copy data
+  if(1 == args->z || (aln->flag & DWGSIM_EVAL_FREAD1)) {
+      pos = pos_1; str = str_1; rand = rand_1;
+      n_err = n_err_1; n_sub = n_sub_1; n_indel = n_indel_1;
+  }
+  else {
+      pos = pos_2; str = str_2; rand = rand2;
+      n_err = n_err_2; n_sub = n_sub_2; n_indel = n_indel_2;
+  }
+
+  // get the actual value 
+  if(1 == rand) {
+      actual_value = DWGSIM_EVAL_UNMAPPABLE;
+  }
+  else {
+      actual_value = DWGSIM_EVAL_MAPPABLE;
+  }
+
+  // get the predicted value
+  if((DWGSIM_EVAL_FUNMAP & aln->flag)) { // unmapped
+      predicted_value = DWGSIM_EVAL_UNMAPPED;
+  }
+  else { // mapped (correctly?)
+      chr = aln->chr;
+      left = aln->pos - aln->clip;
+
+      if(1 == rand || // should not map 
+         0 != strcmp(chr, truth_chr)  // different chromosome
+         || args->g < fabs(pos - left)) { // out of bounds (positionally) 
+          predicted_value = DWGSIM_EVAL_MAPPED_INCORRECTLY;
+      }
+      else {
+          predicted_value = DWGSIM_EVAL_MAPPED_CORRECTLY;
+      }
+  }
+
+  dwgsim_eval_counts_add(counts, metric, actual_value, predicted_value);
+
+  return predicted_value;
+}
+
+dwgsim_eval_counts_t *
+dwgsim_eval_counts_init()
+{
+  dwgsim_eval_counts_t *counts;
+
+  counts = malloc(sizeof(dwgsim_eval_counts_t));
+
+  counts->min_score = counts->max_score = 0;
+
+  counts->mc = malloc(sizeof(int32_t)); assert(NULL != counts->mc);
+  counts->mi = malloc(sizeof(int32_t)); assert(NULL != counts->mi);
+  counts->mu = malloc(sizeof(int32_t)); assert(NULL != counts->mu);
+  counts->um = malloc(sizeof(int32_t)); assert(NULL != counts->um);
+  counts->uu = malloc(sizeof(int32_t)); assert(NULL != counts->uu);
+
+  counts->mc[0] = counts->mi[0] = counts->mu[0] = 0;
+  counts->um[0] = counts->uu[0] = 0;
+
+  return counts;
+}
+
+void
+dwgsim_eval_counts_destroy(dwgsim_eval_counts_t *counts)
+{
+  free(counts->mc);
+  free(counts->mi);
+  free(counts->mu);
+  free(counts->um);
+  free(counts->uu);
+  free(counts);
+}
+
+void 
+dwgsim_eval_counts_add(dwgsim_eval_counts_t *counts, int32_t score, int32_t actual_value, int32_t predicted_value)
+{
+  char *FnName="dwgsim_eval_counts_add";
+  int32_t i, m, n;
+  if(counts->max_score < score) {
+      m = score - counts->min_score + 1;
+      n = counts->max_score - counts->min_score + 1;
+
+      counts->mc = realloc(counts->mc, sizeof(int32_t)*m); assert(NULL != counts->mc);
+      counts->mi = realloc(counts->mi, sizeof(int32_t)*m); assert(NULL != counts->mi);
+      counts->mu = realloc(counts->mu, sizeof(int32_t)*m); assert(NULL != counts->mu);
+      counts->um = realloc(counts->um, sizeof(int32_t)*m); assert(NULL != counts->um);
+      counts->uu = realloc(counts->uu, sizeof(int32_t)*m); assert(NULL != counts->uu);
+
+      // initialize to zero
+      for(i=n;i<m;i++) {
+          counts->mc[i] = counts->mi[i] = counts->mu[i] = 0;
+          counts->um[i] = counts->uu[i] = 0;
+      }
+      counts->max_score = score;
+  }
+  else if(score < counts->min_score) {
+      m = counts->max_score - score + 1;
+      n = counts->max_score - counts->min_score + 1;
+
+      counts->mc = realloc(counts->mc, sizeof(int32_t)*m); assert(NULL != counts->mc);
+      counts->mi = realloc(counts->mi, sizeof(int32_t)*m); assert(NULL != counts->mi);
+      counts->mu = realloc(counts->mu, sizeof(int32_t)*m); assert(NULL != counts->mu);
+      counts->um = realloc(counts->um, sizeof(int32_t)*m); assert(NULL != counts->um);
+      counts->uu = realloc(counts->uu, sizeof(int32_t)*m); assert(NULL != counts->uu);
+
+      // shift up
+      for(i=m-1;m-n<=i;i--) {
+          counts->mc[i] = counts->mc[i-(m-n)]; 
+          counts->mi[i] = counts->mi[i-(m-n)]; 
+          counts->mu[i] = counts->mu[i-(m-n)]; 
+          counts->um[i] = counts->um[i-(m-n)]; 
+          counts->uu[i] = counts->uu[i-(m-n)]; 
+      }
+      // initialize to zero
+      for(i=0;i<m-n;i++) {
+          counts->mc[i] = counts->mi[i] = counts->mu[i] = 0;
+          counts->um[i] = counts->uu[i] = 0;
+      }
+      counts->min_score = score;
+  }
+
+  // check actual value
+  switch(actual_value) {
+    case DWGSIM_EVAL_MAPPABLE:
+    case DWGSIM_EVAL_UNMAPPABLE:
+      break;
+    default:
+      dwgsim_eval_print_error(FnName, "actual_value", "Could not understand actual value", Exit, OutOfRange);
+  }
+
+  // check predicted value
+  switch(predicted_value) {
+    case DWGSIM_EVAL_MAPPED_CORRECTLY:
+    case DWGSIM_EVAL_MAPPED_INCORRECTLY:
+    case DWGSIM_EVAL_UNMAPPED:
+      break;
+    default:
+      dwgsim_eval_print_error(FnName, "predicted_value", "Could not understand predicted value", Exit, OutOfRange);
+  }
+
+  switch(actual_value) {
+    case DWGSIM_EVAL_MAPPABLE:
+      switch(predicted_value) {
+        case DWGSIM_EVAL_MAPPED_CORRECTLY:
+          counts->mc[score-counts->min_score]++; break;
+        case DWGSIM_EVAL_MAPPED_INCORRECTLY:
+          counts->mi[score-counts->min_score]++; break;
+        case DWGSIM_EVAL_UNMAPPED:
+          counts->mu[score-counts->min_score]++; break;
+        default:
+          break; // should not reach here
+      }
+      break;
+    case DWGSIM_EVAL_UNMAPPABLE:
+      switch(predicted_value) {
+        case DWGSIM_EVAL_MAPPED_CORRECTLY:
+          dwgsim_eval_print_error(FnName, "predicted_value", "predicted value cannot be mapped correctly when the read is unmappable", Exit, OutOfRange); break;
+        case DWGSIM_EVAL_MAPPED_INCORRECTLY:
+          counts->um[score-counts->min_score]++; break;
+        case DWGSIM_EVAL_UNMAPPED:
+          counts->uu[score-counts->min_score]++; break;
+        default:
+          break; // should not reach here
+      }
+      break;
+    default:
+      break; // should not reach here
+  }
+}
+
+void 
+dwgsim_eval_counts_print(dwgsim_eval_counts_t *counts, int32_t a, int32_t d, int32_t n)
+{
+  int32_t i;
+  int32_t max = 0;
+  int32_t mc_sum, mi_sum, mu_sum, um_sum, uu_sum;
+  int32_t m_total, mm_total, u_total;
+  char format[1024]="\0";
+
+  mc_sum = mi_sum = mu_sum = um_sum = uu_sum = 0;
+  m_total = mm_total = u_total = 0;
+
+  // create the format string
+  for(i=counts->max_score - counts->min_score;0<=i;i--) {
+      m_total += counts->mc[i] + counts->mi[i] + counts->mu[i];
+      u_total += counts->um[i] + counts->uu[i];
+      max += counts->mc[i] + counts->mi[i] + counts->mu[i] + counts->um[i] + counts->uu[i];
+  }
+  max = 1 + log10(max);
+  strcat(format, "%.2d ");
+  for(i=0;i<12;i++) {
+      sprintf(format + (int)strlen(format), "%%%dd ", max);
+  }
+  strcat(format + (int)strlen(format), "%.3e %.3e %.3e %.3e %.3e %.3e\n");
+
+  // header
+  fprintf(stdout, "# thr | the minimum %s threshold\n", (0 == a) ? "mapping quality" : "alignment score");
+  fprintf(stdout, "# mc | the number of reads mapped correctly that should be mapped at the threshold\n");
+  fprintf(stdout, "# mi | the number of reads mapped incorrectly that should be mapped be mapped at the threshold\n");
+          
+  fprintf(stdout, "# mu | the number of reads unmapped that should be mapped be mapped at the threshold\n");
+          
+  fprintf(stdout, "# um | the number of reads mapped that should be unmapped be mapped at the threshold\n");
+  fprintf(stdout, "# uu | the number of reads unmapped that should be unmapped be mapped at the threshold\n");
+  fprintf(stdout, "# mc' + mi' + mu' + um' + uu' | the total number of reads mapped at the threshold\n");
+  fprintf(stdout, "# mc' | the number of reads mapped correctly that should be mapped at or greater than that threshold\n");
+  fprintf(stdout, "# mi' | the number of reads mapped incorrectly that should be mapped be mapped at or greater than that threshold\n");
+          
+  fprintf(stdout, "# mu' | the number of reads unmapped that should be mapped be mapped at or greater than that threshold\n");
+          
+  fprintf(stdout, "# um' | the number of reads mapped that should be unmapped be mapped at or greater than that threshold\n");
+  fprintf(stdout, "# uu' | the number of reads unmapped that should be unmapped be mapped at or greater than that threshold\n");
+  fprintf(stdout, "# mc' + mi' + mu' + um' + uu' | the total number of reads mapped at or greater than the threshold\n");
+          
+  fprintf(stdout, "# (mc / (mc' + mi' + mu')) | sensitivity: the fraction of reads that should be mapped that are mapped correctly at the threshold\n");
+  fprintf(stdout, "# (mc / mc' + mi') | positive predictive value: the fraction of mapped reads that are mapped correctly at the threshold\n");
+  fprintf(stdout, "# (um / (um' + uu')) | false discovery rate: the fraction of random reads that are mapped at the threshold\n");
+  fprintf(stdout, "# (mc' / (mc' + mi' + mu')) | sensitivity: the fraction of reads that should be mapped that are mapped correctly at or greater than the threshold\n");
+  fprintf(stdout, "# (mc' / mc' + mi') | positive predictive value: the fraction of mapped reads that are mapped correctly at or greater than the threshold\n");
+  fprintf(stdout, "# (um' / (um' + uu')) | false discovery rate: the fraction of random reads that are mapped at or greater than the threshold\n");
+
+
+  // print
+  for(i=counts->max_score - counts->min_score;0<=i;i--) {
+      double num, den;
+
+      mc_sum += counts->mc[i];
+      mi_sum += counts->mi[i];
+      mu_sum += counts->mu[i];
+      um_sum += counts->um[i];
+      uu_sum += counts->uu[i];
+      mm_total += counts->mc[i] + counts->mi[i];
+
+      /* Notes:
+       *  notice that the denominator for sensitivity (and fdr) for the "ge" 
+       *  (greater than or equal) threshold is the "total", while the denominator 
+       *  for ppv is "@ >= Q".  The reasoning behind this is ppv is a measure of
+       *  the quality of mappings that will be returned when using a Q threshold
+       *  while the sensitivity want to measure the fraction of mappings that
+       *  will be returned compared to the maximum.  Basically, if we accept
+       *  only mappings at a given threshold, and call the rest unmapped, what
+       *  happens?
+       *  - sensitivity tells us the # of correct mappings out of the total possible
+       *  mappings.
+       *  - ppv tells us the # of correct mappings out of the total mappings.
+       *  - fdr tells us the # of random mappings out of the total unmappable.
+       */
+       
+      // "at" sensitivity: mapped correctly @ Q / mappable @ Q
+      num = counts->mc[i];
+      den = counts->mc[i] + counts->mi[i] + counts->mu[i];
+      double sens_at_thr = (0 == den) ? 0. : (num / (double)den);  
+      // "ge" sensitivity: mapped correctly @ >= Q / total mappable
+      double sens_ge_thr = (0 == m_total) ? 0. : (mc_sum / (double)m_total);
+      
+      // "at" positive predictive value: mapped correctly @ Q / mappable and mapped @ Q
+      num = counts->mc[i];
+      den = counts->mc[i] + counts->mi[i];
+      double ppv_at_thr = (0 == den) ? 0. : (num / (double)den);
+      // "ge" positive predictive value: mapped correctly @ >= Q / mappable and mapped @ >= Q
+      double ppv_ge_thr = (0 == mm_total) ? 0. : (mc_sum / (double)mm_total);
+
+      // "at" false discovery rate: unmappable and mapped @ Q / unmappable @ Q
+      num = counts->um[i];
+      den = counts->um[i] + counts->uu[i];
+      double fdr_at_thr = (0 == den) ? 0. : (num / (double)den);
+      // "ge" false discovery rate: unmappable and mapped @ >= Q / unmappable @ >= Q
+      double fdr_ge_thr = (0 == u_total) ? 0. : (um_sum / (double)u_total);
+      
+      fprintf(stdout, format,
+              (i + counts->min_score)*d,
+              counts->mc[i], counts->mi[i], counts->mu[i], counts->um[i], counts->uu[i],
+              counts->mc[i] + counts->mi[i] + counts->mu[i] + counts->um[i] + counts->uu[i],
+              mc_sum, mi_sum, mu_sum, um_sum, uu_sum,
+              mc_sum + mi_sum + mu_sum + um_sum + uu_sum,
+              sens_at_thr, ppv_at_thr, fdr_at_thr,
+              sens_ge_thr, ppv_ge_thr, fdr_ge_thr);
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef DWGSIM_EVAL_COUNTS_H_
+#define DWGSIM_EVAL_COUNTS_H_
+
+#include <stdint.h>
+#include "sidecar.h"
+
+/* The evaluation of alignments of simulated reads against the truth in
+ * their read names (or in the truth sidecar), shared by dwgsim_eval and the dwgsim aligner pipeline
+ * (-A); it does not depend on samtools. */
+
+#define DWGSIM_EVAL_MAXQ 255
+#define DWGSIM_EVAL_MINAS -5000
+
+typedef struct {
+    int32_t a; // alignment score or not
+    int32_t b; // bwa or not
+    int32_t c; // color space or not
+    int32_t d; // divide by factor
+    int32_t e; // print only alignments with # of errors
+    int32_t g; // gap "wiggle"
+    int32_t i; // indel only
+    int32_t m; // multi-mapped
+    int32_t n; // # of pe alignments
+    int32_t p; // print incorrect alignments or not
+    int32_t q; // consider only alignments with this mapping quality or greater
+    int32_t s; // print only alignments with # of SNPs 
+    int32_t z; // input reads are single end
+    int32_t S; // input reads are in text SAM format
+    char *P; // read name prefix
+    sidecar_t *T; // the truth sidecar for compact read names, or NULL
+} dwgsim_eval_args_t;
+
+// Actual value
+enum {
+    DWGSIM_EVAL_MAPPABLE   =0,
+    DWGSIM_EVAL_UNMAPPABLE =1
+};
+
+// Prediction
+enum {
+    DWGSIM_EVAL_MAPPED_CORRECTLY   =0,
+    DWGSIM_EVAL_MAPPED_INCORRECTLY =1,
+    DWGSIM_EVAL_UNMAPPED           =2
+};
+
+typedef struct {
+    int32_t *mc; // mappable && mapped correctly
+    int32_t *mi; // mappable && mapped incorrectly
+    int32_t *mu; // mappable && unmapped
+    int32_t *um; // unmappable && mapped
+    int32_t *uu; // unmappable && unmapped
+    int32_t min_score, max_score;
+} dwgsim_eval_counts_t;
+
+/* Action */
+enum {Exit, Warn, LastActionType};
+/* Type */
+enum {  
+    Dummy,
+    OutOfRange, /* e.g. command line args */
+    InputArguments, 
+    IllegalFileName,   
+    IllegalPath,
+    OpenFileError,
+    EndOfFile,
+    ReallocMemory,
+    MallocMemory,
+    ThreadError,
+    ReadFileError,
+    WriteFileError,
+    DeleteFileError,
+    LastErrorType,
+};       
+
+// SAM flags
+#define DWGSIM_EVAL_FPAIRED 0x1
+#define DWGSIM_EVAL_FUNMAP 0x4
+#define DWGSIM_EVAL_FREAD1 0x40
+
+// the fields of an alignment used in the evaluation, from a BAM record or a
+// SAM line
+typedef struct {
+    const char *qname;
+    int32_t flag;
+    int32_t qual; // mapping quality
+    const char *chr; // the contig, NULL if unmapped
+    int32_t pos; // zero-based
+    int32_t clip; // the number of clipped bases at the start
+    int32_t has_as, as; // the AS tag, if present
+    int32_t has_xs, xs; // the XS tag, if present
+} dwgsim_eval_aln_t;
+
+void
+dwgsim_eval_print_error(char* FunctionName, char *VariableName, char* Message, int Action, int type);
+
+// adds the alignment to the counts, returning the predicted value, or -1 if
+// the alignment was filtered out; "target_name" lists the contigs of the
+// header
+int32_t
+dwgsim_eval_process(dwgsim_eval_counts_t *counts,
+                    dwgsim_eval_args_t *args,
+                    const dwgsim_eval_aln_t *aln,
+                    int32_t n_targets,
+                    char **target_name);
+dwgsim_eval_counts_t *
+dwgsim_eval_counts_init();
+void
+dwgsim_eval_counts_destroy(dwgsim_eval_counts_t *counts);
+void 
+dwgsim_eval_counts_add(dwgsim_eval_counts_t *counts, int32_t score, int32_t actual_value, int32_t predicted_value);
+void 
+dwgsim_eval_counts_print(dwgsim_eval_counts_t *counts, int32_t a, int32_t d, int32_t n);
+
+#endif
@@ -35,6 +35,7 @@
 #include "mut.h"
 #include "dwgsim.h"
 #include "dwgsim_opt.h"
+#include "sink.h"
 
 dwgsim_opt_t* dwgsim_opt_init()
 {
@@ -45,6 +46,7 @@ dwgsim_opt_t* dwgsim_opt_init()
   opt->is_inner = 0;
   opt->dist = 500;
   opt->std_dev = 50;
+  opt->fn_insert_hist = NULL;
   opt->N = -1;
   opt->C = 100;
   opt->length[0] = opt->length[1] = 70;
@@ -61,12 +63,27 @@ dwgsim_opt_t* dwgsim_opt_init()
   opt->flow_order_len = 0;
   opt->use_base_error = 0;
   opt->seed = -1;
+  opt->num_threads = 1;
+  opt->compress_level = -1;
+  opt->writer_depth = 2;
+  opt->buffer_size = 1024;
   opt->fixed_quality = NULL;
   opt->fn_muts_input = NULL;
   opt->fn_muts_input_type = -1;
   opt->fn_regions_bed = NULL;
-  opt->fp_mut = opt->fp_bfast = opt->fp_bwa1 = opt->fp_bwa2 = NULL;
-  opt->fp_fa = opt->fp_fai = NULL;
+  opt->region_weights = 0;
+  opt->fp_mut = NULL;
+  opt->sinks = SINK_DEFAULT;
+  opt->sink = NULL;
+  opt->aligner = NULL;
+  opt->compact_names = 0;
+  opt->chunk_reads = 0;
+  opt->chunk_size = 0;
+  opt->write_coverage = 0;
+  opt->coverage = NULL;
+  opt->fp_fa = opt->fp_fai = opt->fp_gzi = NULL;
+  opt->gz_fa = NULL;
+  opt->fn_cache = NULL;
   opt->read_prefix = NULL;
 
   return opt;
@@ -77,25 +94,32 @@ void dwgsim_opt_destroy(dwgsim_opt_t *opt)
   free(opt->fixed_quality);
   free(opt->fn_muts_input);
   free(opt->fn_regions_bed);
+  free(opt->fn_insert_hist);
   free(opt->flow_order);
   free(opt->read_prefix);
+  free(opt->fn_cache);
+  free(opt->aligner);
   free(opt);
 }
 
 int dwgsim_opt_usage(dwgsim_opt_t *opt)
 {
+  char sinks[128];
   mutseq_init_bounds();
   fprintf(stderr, "\n");
   fprintf(stderr, "Program: dwgsim (short read simulator)\n");
   fprintf(stderr, "Version: %s\n", PACKAGE_VERSION);
   fprintf(stderr, "Contact: Nils Homer <dnaa-help@lists.sourceforge.net>\n\n");
-  fprintf(stderr, "Usage:   dwgsim [options] <in.ref.fa> <out.prefix>\n\n");
+  fprintf(stderr, "Usage:   dwgsim [options] <in.ref.fa> <out.prefix>\n");
+  fprintf(stderr, "         dwgsim replay [options] <in.store> <out.prefix>\n\n");
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "         -e FLOAT      per base/color/flow error rate of the first read [from %.3f to %.3f by %.3f]\n", opt->e[0].start, opt->e[0].end, opt->e[0].by);
   fprintf(stderr, "         -E FLOAT      per base/color/flow error rate of the second read [from %.3f to %.3f by %.3f]\n", opt->e[1].start, opt->e[1].end, opt->e[1].by);
   fprintf(stderr, "         -i            use the inner distance instead of the outer distance for pairs [%s]\n", __IS_TRUE(opt->is_inner));
-  fprintf(stderr, "         -d INT        %s distance between the two ends for pairs [%d]\n", 
+  fprintf(stderr, "         -d INT|FILE   %s distance between the two ends for pairs, or a histogram of them [%d]\n", 
           (0 == opt->is_inner) ? "outer" : "inner", opt->dist);
+  fprintf(stderr, "                       (lines of a distance and its count, as samtools stats IS lines or a Picard insert size histogram)\n");
+  fprintf(stderr, "                       inserts shorter than a read are read through into the TruSeq adapter (outer, opposite strands)\n");
   fprintf(stderr, "         -s INT        standard deviation of the distance for pairs [%.3f]\n", opt->std_dev);
   fprintf(stderr, "         -N INT        number of read pairs (-1 to disable) [%lld]\n", (signed long long int)opt->N);
   fprintf(stderr, "         -C FLOAT      mean coverage across available positions (-1 to disable) [%.2lf]\n", opt->C);
@@ -122,10 +146,34 @@ int dwgsim_opt_usage(dwgsim_opt_t *opt)
   fprintf(stderr, "         -B            use a per-base error rate for Ion Torrent data [%s]\n", __IS_TRUE(opt->use_base_error));
   fprintf(stderr, "         -H            haploid mode [%s]\n", __IS_TRUE(opt->is_hap));
   fprintf(stderr, "         -z INT        random seed (-1 uses the current time) [%d]\n", opt->seed);
+  fprintf(stderr, "         -t INT        number of threads [%d]\n", opt->num_threads);
+  fprintf(stderr, "         -o STRING     the comma-separated output formats [%s]:\n", sink_mask_str(opt->sinks, sinks));
+  fprintf(stderr, "                           bwa: FASTQ for BWA (.bwa.read1.fastq and .bwa.read2.fastq)\n");
+  fprintf(stderr, "                           interleaved: FASTQ with both ends in one file (.interleaved.fastq)\n");
+  fprintf(stderr, "                           bfast: FASTQ for BFAST (.bfast.fastq)\n");
+  fprintf(stderr, "                           ubam: unaligned BAM with the truth in YC/YP/YS/YE/YM/YI/YR tags (.unaligned.bam)\n");
+  fprintf(stderr, "                           fasta: FASTA without qualities (.read1.fasta and .read2.fasta)\n");
+  fprintf(stderr, "                           truth: the true alignments, with NM/MD, sorted by coordinate (.truth.bam)\n");
+  fprintf(stderr, "                           truthsam: as truth, but SAM (.truth.sam)\n");
+  fprintf(stderr, "                           sidecar: as -T\n");
+  fprintf(stderr, "                           store: a binary read store, to write other formats with dwgsim replay (.store)\n");
+  fprintf(stderr, "         -T            name the reads by number, writing their truth to a binary sidecar (.truth.bin) [%s]\n", __IS_TRUE(opt->compact_names));
+  fprintf(stderr, "                           use the -T option with dwgsim_eval\n");
+  fprintf(stderr, "         -A STRING     align the reads with this command, evaluating its SAM output as dwgsim_eval [%s]\n", (NULL == opt->aligner) ? "not using" : opt->aligner);
+  fprintf(stderr, "                           the interleaved FASTQ is written to its standard input, and -o defaults to none\n");
+  fprintf(stderr, "         -k INT        split the output into chunks of at most this many read pairs (0 for no limit) [%d]\n", opt->chunk_reads);
+  fprintf(stderr, "         -K INT        split the output into chunks of at most about this many MiB per file (0 for no limit) [%d]\n", opt->chunk_size);
+  fprintf(stderr, "                           chunks are named <prefix>.<chunk>.<suffix> and listed in <prefix>.manifest.txt\n");
+  fprintf(stderr, "         -g            write the realized read coverage as bedGraph (.coverage.bedgraph, .coverage.hap1.bedgraph\n");
+  fprintf(stderr, "                           and .coverage.hap2.bedgraph) [%s]\n", __IS_TRUE(opt->write_coverage));
+  fprintf(stderr, "         -w INT        rounds of reads queued for the writer thread (0 writes from the main thread) [%d]\n", opt->writer_depth);
+  fprintf(stderr, "         -W INT        the buffer size of each output file in KiB [%d]\n", opt->buffer_size);
+  fprintf(stderr, "         -Z INT        write BGZF-compressed FASTQ (.fastq.gz) at this level (0-9, -1 to disable) [%d]\n", opt->compress_level);
   fprintf(stderr, "         -m FILE       the mutations txt file to re-create [%s]\n", (MUT_INPUT_TXT != opt->fn_muts_input_type) ? "not using" : opt->fn_muts_input);
   fprintf(stderr, "         -b FILE       the bed-like file set of candidate mutations [%s]\n", (MUT_INPUT_BED == opt->fn_muts_input_type) ? "not using" : opt->fn_muts_input);
   fprintf(stderr, "         -v FILE       the vcf file set of candidate mutations (use pl tag for strand) [%s]\n", (MUT_INPUT_VCF == opt->fn_muts_input_type) ? "not using" : opt->fn_muts_input);
   fprintf(stderr, "         -x FILE       the bed of regions to cover [%s]\n", (NULL == opt->fn_regions_bed) ? "not using" : opt->fn_regions_bed);
+  fprintf(stderr, "         -J            weight the -x regions by the BED score (fifth) column, relative to their length [%s]\n", __IS_TRUE(opt->region_weights));
   fprintf(stderr, "         -P STRING     a read prefix to prepend to each read name [%s]\n", (NULL == opt->read_prefix) ? "not using" : opt->read_prefix);
   fprintf(stderr, "         -q STRING     a fixed base quality to apply (single character) [%s]\n", (NULL == opt->fixed_quality) ? "not using" : opt->fixed_quality);
   fprintf(stderr, "         -h            print this message\n");
@@ -135,6 +183,10 @@ int dwgsim_opt_usage(dwgsim_opt_t *opt)
   fprintf(stderr, "\n");
   fprintf(stderr, "Note: The longest supported insertion is %u.\n", UINT32_MAX);
   fprintf(stderr, "\n");
+  fprintf(stderr, "Note: The reference may also be a UCSC .2bit file or a gzip/BGZF-compressed FASTA (a BGZF FASTA with a .fai\n");
+  fprintf(stderr, "and .gzi is decompressed in parallel).  For a FASTA reference, a binary cache is\n");
+  fprintf(stderr, "written to <in.ref.fa>.dwgsim on first use and rebuilt whenever the FASTA changes.\n");
+  fprintf(stderr, "\n");
   return 1;
 }
 
@@ -162,12 +214,20 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
 {
   int32_t i;
   int c;
+  char *end;
+  double x;
   int muts_input_type = 0;
+  int sinks_set = 0;
   
-  while ((c = getopt(argc, argv, "id:s:N:C:1:2:e:E:r:F:R:X:I:c:S:n:y:BHf:z:m:b:v:x:P:q:h")) >= 0) {
+  while ((c = getopt(argc, argv, "id:s:N:C:1:2:e:E:r:F:R:X:I:c:S:n:y:BHf:z:t:o:A:Tgk:K:w:W:Z:m:b:v:x:JP:q:h")) >= 0) {
       switch (c) {
         case 'i': opt->is_inner = 1; break;
-        case 'd': opt->dist = atoi(optarg); break;
+        case 'd': 
+                  free(opt->fn_insert_hist); opt->fn_insert_hist = NULL;
+                  x = strtod(optarg, &end);
+                  if('\0' != optarg[0] && '\0' == *end) opt->dist = (int32_t)x; // truncated, as atoi
+                  else opt->fn_insert_hist = strdup(optarg); // a histogram
+                  break;
         case 's': opt->std_dev = atof(optarg); break;
         case 'N': opt->N = atoi(optarg); opt->C = -1; break;
         case 'C': opt->C = atof(optarg); opt->N = -1; break;
@@ -192,10 +252,28 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
         case 'H': opt->is_hap = 1; break;
         case 'h': return 0;
         case 'z': opt->seed = atoi(optarg); break;
+        case 't': opt->num_threads = atoi(optarg); break;
+        case 'o': 
+                  opt->sinks = sink_parse(optarg);
+                  if(opt->sinks < 0) {
+                      fprintf(stderr, "Unrecognized output format: %s\n", optarg);
+                      return 0;
+                  }
+                  sinks_set = 1;
+                  break;
+        case 'A': free(opt->aligner); opt->aligner = strdup(optarg); break;
+        case 'T': opt->compact_names = 1; break;
+        case 'g': opt->write_coverage = 1; break;
+        case 'k': opt->chunk_reads = atoi(optarg); break;
+        case 'K': opt->chunk_size = atoi(optarg); break;
+        case 'w': opt->writer_depth = atoi(optarg); break;
+        case 'W': opt->buffer_size = atoi(optarg); break;
+        case 'Z': opt->compress_level = atoi(optarg); break;
         case 'm': free(opt->fn_muts_input); opt->fn_muts_input = strdup(optarg); opt->fn_muts_input_type = MUT_INPUT_TXT; muts_input_type |= 0x1; break;
         case 'b': free(opt->fn_muts_input); opt->fn_muts_input = strdup(optarg); opt->fn_muts_input_type = MUT_INPUT_BED; muts_input_type |= 0x2; break;
         case 'v': free(opt->fn_muts_input); opt->fn_muts_input = strdup(optarg); opt->fn_muts_input_type = MUT_INPUT_VCF; muts_input_type |= 0x4; break;
         case 'x': free(opt->fn_regions_bed); opt->fn_regions_bed = strdup(optarg); break;
+        case 'J': opt->region_weights = 1; break;
         case 'P': free(opt->read_prefix); opt->read_prefix = strdup(optarg); break;
         case 'q': opt->fixed_quality = strdup(optarg); break;
         default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 0;
@@ -205,6 +283,14 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
 
   __check_option(opt->is_inner, 0, 1, "-i");
   __check_option(opt->dist, 0, INT32_MAX, "-d");
+  if(NULL != opt->fn_insert_hist) {
+      FILE *fp = fopen(opt->fn_insert_hist, "r");
+      if(NULL == fp) {
+          fprintf(stderr, "Error: could not open the insert size histogram '%s' (-d)\n", opt->fn_insert_hist);
+          return 0;
+      }
+      fclose(fp);
+  }
   __check_option(opt->std_dev, 0, INT32_MAX, "-s");
   if(opt->N < 0 && opt->C < 0) {
       fprintf(stderr, "Must use one of -N or -C");
@@ -255,6 +341,31 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
   }
   __check_option(opt->use_base_error, 0, 1, "-B");
   __check_option(opt->is_hap, 0, 1, "-H");
+  __check_option(opt->num_threads, 1, INT32_MAX, "-t");
+  __check_option(opt->compress_level, -1, 9, "-Z");
+  __check_option(opt->chunk_reads, 0, INT32_MAX, "-k");
+  __check_option(opt->chunk_size, 0, INT32_MAX, "-K");
+  __check_option(opt->writer_depth, 0, 64, "-w");
+  __check_option(opt->buffer_size, 1, INT32_MAX >> 10, "-W");
+
+  if(1 == opt->compact_names) opt->sinks |= (1 << SINK_SIDECAR);
+  if(NULL != opt->aligner) {
+      // only the reads streamed to the aligner, unless asked for
+      if(0 == sinks_set) opt->sinks = 0;
+      if(0 != (opt->sinks & (1 << SINK_SIDECAR)) || 1 == opt->compact_names) {
+          fprintf(stderr, "Error: compact read names (-T) cannot be used with -A\n");
+          return 0;
+      }
+      if(0 != (opt->sinks & (1 << SINK_INTERLEAVED))) {
+          fprintf(stderr, "Error: the interleaved output cannot be used with -A\n");
+          return 0;
+      }
+  }
+
+  if(1 == opt->region_weights && NULL == opt->fn_regions_bed) {
+      fprintf(stderr, "Error: command line option -J requires -x\n");
+      return 0;
+  }
 
   if(NULL != opt->fixed_quality && 1 != strlen(opt->fixed_quality)) {
       fprintf(stderr, "Error: command line option -q requires one character\n");
@@ -277,8 +388,8 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
       break;
   }
   
-  // random seed
-  srand48((-1 == opt->seed) ? time(0) : opt->seed);
+  // random seed; all random streams are keyed by it
+  if(-1 == opt->seed) opt->seed = time(0);
 
   if(IONTORRENT == opt->data_type) {
       if(NULL != opt->flow_order) {
@@ -303,8 +414,10 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
       uint8_t *tmp_seq=NULL;
       uint8_t *tmp_seq_flow_mask=NULL;
       int32_t tmp_seq_mem, s, cur_n_err, n_err, counts;
-      int32_t j, k;
+      int32_t j;
       double sf = 0.0;
+      rng_t rng;
+      rng_init(&rng, opt->seed, 0, RNG_ERROR_CALIBRATION, 0);
       for(i=0;i<2;i++) {
           if(opt->length[i] <= 0) continue;
           fprintf(stderr, "[dwgsim_core] Updating error rate for end %d\n", i+1);
@@ -323,12 +436,10 @@ dwgsim_opt_parse(dwgsim_opt_t *opt, int argc, char *argv[])
               if(0 == (j % 10000)) {
                   fprintf(stderr, "\r[dwgsim_core] %d", j);
               }
-              for(k=0;k<opt->length[i];k++) {
-                  tmp_seq[k] = (int)(drand48() * 4.0) & 3;
-              }
+              rng_bases(&rng, tmp_seq, opt->length[i]);
               cur_n_err = 0;
               s = opt->length[i];
-              s = generate_errors_flows(opt, &tmp_seq, &tmp_seq_flow_mask, &tmp_seq_mem, s, 0, opt->e[i].start, &cur_n_err);
+              s = generate_errors_flows(opt, &rng, &tmp_seq, &tmp_seq_flow_mask, &tmp_seq_mem, s, 0, opt->e[i].start, &cur_n_err);
               n_err += cur_n_err;
               counts += s;
           }
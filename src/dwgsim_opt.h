@@ -1,6 +1,11 @@
 #ifndef DWGSIM_OPT_H
 #define DWGSIM_OPT_H
 
+#include <stdio.h>
+#include <zlib.h>
+#include "sink.h"
+#include "coverage.h"
+
 #define ERROR_RATE_NUM_RANDOM_READS 1000000
 
 typedef struct {
@@ -12,6 +17,7 @@ typedef struct {
     int32_t is_inner;
     int32_t dist;
     double std_dev;
+    char *fn_insert_hist; /* the insert-size histogram used instead of -d/-s, or NULL */
     int64_t N;
     double C;
     int32_t length[2];
@@ -29,17 +35,30 @@ typedef struct {
     int32_t use_base_error;
     int32_t is_hap;
     int32_t seed;
+    int32_t num_threads;
+    int32_t compress_level; /* BGZF level for the FASTQ output, -1 for none */
+    int32_t writer_depth; /* rounds of blocks queued for the writer thread */
+    int32_t buffer_size; /* the stdio buffer of each output file, in KiB */
     char *fixed_quality;
     char *fn_muts_input;
     int32_t fn_muts_input_type;
     char *fn_regions_bed;
+    int32_t region_weights; /* weight the regions by the BED score column */
     FILE *fp_mut;
     FILE *fp_vcf;
-    FILE *fp_bfast;
-    FILE *fp_bwa1;
-    FILE *fp_bwa2;
+    int32_t sinks; /* the enabled output sinks, bits (1 << SINK_*) */
+    sink_t *sink; /* the read output */
+    char *aligner; /* the aligner command, or NULL */
+    int32_t compact_names; /* numeric read names, with the truth sidecar */
+    int32_t chunk_reads; /* the read pairs per output chunk, 0 for no limit */
+    int32_t chunk_size; /* the size of each output chunk in MiB, 0 for no limit */
+    int32_t write_coverage; /* write the realized read coverage */
+    coverage_t *coverage; /* the realized read coverage, or NULL */
     FILE *fp_fa;
+    gzFile gz_fa; /* the FASTA, read sequentially */
     FILE *fp_fai;
+    FILE *fp_gzi;
+    char *fn_cache; /* the reference cache */
     char *read_prefix;
 } dwgsim_opt_t;
 
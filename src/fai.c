@@ -0,0 +1,226 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "refseq.h"
+#include "fai.h"
+
+// contigs shorter than this are decoded by a single thread
+#define FAI_MIN_BASES_PER_THREAD 0x100000
+// bases decompressed at a time by each thread from a BGZF-compressed FASTA
+#define FAI_GZI_WINDOW 0x400000
+
+typedef struct {
+    const fai_t *fai;
+    const fai_contig_t *contig;
+    refseq_t *r;
+    int32_t start, end; /* bases [start,end) */
+    refseq_runs_t runs;
+} fai_worker_t;
+
+// the file offset of base i
+#define __fai_offset(_c, _i) ((_c)->offset + (int64_t)((_i) / (_c)->line_bases) * (_c)->line_width + (_i) % (_c)->line_bases)
+
+fai_t *
+fai_init(FILE *fp_fa, FILE *fp_fai, const gzi_t *gzi)
+{
+  fai_t *fai = NULL;
+  fai_contig_t *c = NULL;
+  struct stat st;
+  char name[1024];
+  int32_t len, line_bases, line_width;
+  long long int offset;
+  int64_t last;
+  void *data;
+
+  fai = calloc(1, sizeof(fai_t));
+
+  while(0 < fscanf(fp_fai, "%s\t%d\t%lld\t%d\t%d", name, &len, &offset, &line_bases, &line_width)) {
+      if(len < 0 || offset < 0 || line_bases <= 0 || line_width < line_bases) {
+          fprintf(stderr, "Error: malformed .fai entry [%s]\n", name);
+          exit(1);
+      }
+      if(fai->m <= fai->n) {
+          fai->m = (fai->m < 16) ? 16 : (fai->m << 1);
+          fai->contigs = realloc(fai->contigs, sizeof(fai_contig_t) * fai->m);
+      }
+      c = &fai->contigs[fai->n];
+      c->name = strdup(name);
+      c->len = len;
+      c->offset = offset;
+      c->line_bases = line_bases;
+      c->line_width = line_width;
+      fai->n++;
+  }
+
+  if(NULL != gzi) {
+      fai->gzi = gzi;
+      fai->size = gzi_length(gzi);
+  }
+  else if(0 != fstat(fileno(fp_fa), &st)) {
+      fprintf(stderr, "Error: could not stat the FASTA file\n");
+      exit(1);
+  }
+  else {
+      fai->size = st.st_size;
+  }
+  if(NULL == gzi && 0 < fai->size) {
+      data = mmap(NULL, fai->size, PROT_READ, MAP_PRIVATE, fileno(fp_fa), 0);
+      if(MAP_FAILED == data) {
+          fprintf(stderr, "Error: could not memory-map the FASTA file\n");
+          exit(1);
+      }
+      fai->data = data;
+  }
+
+  // check that every contig lies within the file
+  for(len = 0; len < fai->n; len++) {
+      c = &fai->contigs[len];
+      if(0 == c->len) continue;
+      last = __fai_offset(c, c->len - 1);
+      if((int64_t)fai->size <= last) {
+          fprintf(stderr, "Error: the .fai does not match the FASTA file [%s]\n", c->name);
+          exit(1);
+      }
+  }
+
+  return fai;
+}
+
+void
+fai_destroy(fai_t *fai)
+{
+  int32_t i;
+  if(NULL == fai) return;
+  if(NULL != fai->data) munmap((void*)fai->data, fai->size);
+  for(i=0;i<fai->n;i++) {
+      free(fai->contigs[i].name);
+  }
+  free(fai->contigs);
+  free(fai);
+}
+
+// packs bases [start,end) from "data", which holds the file from "data_offset"
+static void
+fai_pack(fai_worker_t *w, const char *data, int64_t data_offset, int32_t start, int32_t end)
+{
+  const fai_contig_t *c = w->contig;
+  int32_t p, n;
+
+  // one line (or the part of it in range) at a time
+  for(p = start; p < end; p += n) {
+      n = c->line_bases - p % c->line_bases;
+      if(end - p < n) n = end - p;
+      refseq_pack(w->r, p, data + (__fai_offset(c, p) - data_offset), n, &w->runs);
+  }
+}
+
+static void *
+fai_worker(void *arg)
+{
+  fai_worker_t *w = (fai_worker_t*)arg;
+  const fai_contig_t *c = w->contig;
+  char *buf = NULL;
+  int64_t from, to, m = 0;
+  int32_t p, q;
+
+  if(NULL == w->fai->gzi) {
+      fai_pack(w, w->fai->data, 0, w->start, w->end);
+      return arg;
+  }
+  // decompress a window of bases at a time
+  for(p = w->start; p < w->end; p = q) {
+      q = (w->end - p < FAI_GZI_WINDOW) ? w->end : p + FAI_GZI_WINDOW;
+      from = __fai_offset(c, p);
+      to = __fai_offset(c, q - 1) + 1;
+      if(m < to - from) {
+          m = to - from;
+          buf = realloc(buf, m);
+      }
+      gzi_read(w->fai->gzi, from, buf, to - from);
+      fai_pack(w, buf, from, p, q);
+  }
+  free(buf);
+  return arg;
+}
+
+void
+fai_read(const fai_t *fai, int32_t i, refseq_t *r, int32_t num_threads)
+{
+  const fai_contig_t *c = &fai->contigs[i];
+  fai_worker_t *workers = NULL;
+  pthread_t *threads = NULL;
+  int32_t j, chunk;
+
+  refseq_alloc(r, c->len);
+
+  if(c->len < (int64_t)num_threads * FAI_MIN_BASES_PER_THREAD) {
+      num_threads = c->len / FAI_MIN_BASES_PER_THREAD;
+      if(num_threads < 1) num_threads = 1;
+  }
+  // each thread packs whole words of the N mask
+  chunk = (c->len + num_threads - 1) / num_threads;
+  chunk = ((chunk + REFSEQ_PACK_ALIGN - 1) / REFSEQ_PACK_ALIGN) * REFSEQ_PACK_ALIGN;
+
+  workers = calloc(num_threads, sizeof(fai_worker_t));
+  threads = calloc(num_threads, sizeof(pthread_t));
+  for(j=0;j<num_threads;j++) {
+      workers[j].fai = fai;
+      workers[j].contig = c;
+      workers[j].r = r;
+      workers[j].start = (c->len < (int64_t)j * chunk) ? c->len : j * chunk;
+      workers[j].end = (c->len - workers[j].start < chunk) ? c->len : workers[j].start + chunk;
+  }
+  if(1 == num_threads) {
+      fai_worker(&workers[0]);
+  }
+  else {
+      for(j=0;j<num_threads;j++) {
+          if(0 != pthread_create(&threads[j], NULL, fai_worker, &workers[j])) {
+              fprintf(stderr, "Error: could not create a thread\n");
+              exit(1);
+          }
+      }
+      for(j=0;j<num_threads;j++) {
+          pthread_join(threads[j], NULL);
+      }
+  }
+  // the N runs, in order
+  for(j=0;j<num_threads;j++) {
+      refseq_add_runs(r, &workers[j].runs);
+      free(workers[j].runs.start);
+      free(workers[j].runs.end);
+  }
+  free(workers);
+  free(threads);
+}
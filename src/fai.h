@@ -0,0 +1,66 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef FAI_H
+#define FAI_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "refseq.h"
+#include "gzi.h"
+
+/* Random access to a FASTA file through its .fai index: the FASTA is
+ * memory-mapped and each contig is decoded straight from its offset and
+ * line layout, in parallel.  A BGZF-compressed FASTA is decompressed a
+ * window at a time by each thread instead. */
+
+typedef struct {
+    char *name;
+    int32_t len; /* number of bases */
+    int64_t offset; /* file offset of the first base */
+    int32_t line_bases, line_width; /* bases and bytes per line */
+} fai_contig_t;
+
+typedef struct {
+    int32_t n, m; /* number of contigs and maximum buffer size */
+    fai_contig_t *contigs;
+    const char *data; /* the memory-mapped FASTA, or NULL if compressed */
+    size_t size; /* the (uncompressed) size of the FASTA */
+    const gzi_t *gzi; /* the BGZF-compressed FASTA, or NULL */
+} fai_t;
+
+// reads the index in "fp_fai" and maps the FASTA in "fp_fa", or reads it
+// through "gzi" if not NULL (owned by the caller)
+fai_t *
+fai_init(FILE *fp_fa, FILE *fp_fai, const gzi_t *gzi);
+
+void
+fai_destroy(fai_t *fai);
+
+// decodes contig i into "r" using up to "num_threads" threads
+void
+fai_read(const fai_t *fai, int32_t i, refseq_t *r, int32_t num_threads);
+
+#endif
@@ -0,0 +1,487 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "contigs.h"
+#include "regions_bed.h"
+#include "refseq.h"
+#include "frag.h"
+
+// the standard normal cumulative distribution
+static double
+frag_phi(double z)
+{
+  return 0.5 * erfc(-z * M_SQRT1_2);
+}
+
+double
+frag_normal_outside(double mu, double sigma, double lo, double hi)
+{
+  if(hi <= lo) return 1.0;
+  if(sigma <= 0) return (lo <= mu && mu < hi) ? 0.0 : 1.0;
+  return 1.0 - (frag_phi((hi - mu) / sigma) - frag_phi((lo - mu) / sigma));
+}
+
+frag_len_t *
+frag_len_normal(double mu, double sigma, double lo, double hi)
+{
+  frag_len_t *fl = calloc(1, sizeof(frag_len_t));
+  double a, b, x, y;
+  int32_t i;
+
+  if(hi <= lo) return fl;
+  if(sigma <= 0) { // as rng_truncated_normal
+      fl->lo = (int32_t)floor(((mu < lo || hi <= mu) ? lo : mu) + 0.5);
+      fl->n = 1;
+      fl->p = malloc(sizeof(double));
+      fl->p[0] = 1.0;
+      return fl;
+  }
+  // lengths beyond ten standard deviations have no probability in doubles
+  if(lo < mu - 10 * sigma) lo = mu - 10 * sigma;
+  if(mu + 10 * sigma + 1 < hi) hi = mu + 10 * sigma + 1;
+  if(hi <= lo) return fl;
+  // "d" is the normal deviate rounded to the nearest integer
+  fl->lo = (int32_t)floor(lo + 0.5);
+  fl->n = (int32_t)floor(hi - 0.5) - fl->lo + 1;
+  if(fl->n <= 0) {
+      fl->n = 0;
+      return fl;
+  }
+  fl->p = malloc(fl->n * sizeof(double));
+  for(i=0;i<fl->n;i++) {
+      a = fl->lo + i - 0.5; b = a + 1.0;
+      if(a < lo) a = lo;
+      if(hi < b) b = hi;
+      x = frag_phi((a - mu) / sigma);
+      y = frag_phi((b - mu) / sigma);
+      fl->p[i] = (x < y) ? y - x : 0.0;
+  }
+  return fl;
+}
+
+frag_len_t *
+frag_len_read(FILE *fp)
+{
+  frag_len_t *fl = calloc(1, sizeof(frag_len_t));
+  char line[4096], *p, *q;
+  int32_t i, n = 0, m = 0, lo = INT32_MAX, hi = 0, c;
+  int32_t *len = NULL;
+  double *count = NULL, x, sum = 0.0;
+  long v;
+
+  while(NULL != fgets(line, sizeof(line), fp)) {
+      if(NULL == strchr(line, '\n')) { // skip the rest of a long line
+          while(EOF != (c = fgetc(fp)) && '\n' != c);
+      }
+      if(0 == strncmp(line, "## HISTOGRAM", 12)) { // Picard: the metrics above are not lengths
+          n = 0;
+          continue;
+      }
+      p = line;
+      if(0 == strncmp(p, "IS\t", 3)) p += 3; // samtools stats
+      v = strtol(p, &q, 10);
+      if(q == p || !('\0' == *q || isspace(*q))) continue; // not a length
+      x = strtod(q, &p);
+      if(p == q) x = 1.0; // a length on its own
+      if(v < 0 || INT32_MAX <= v || x < 0) {
+          fprintf(stderr, "[frag_len_read] invalid insert size: %s", line);
+          exit(1);
+      }
+      if(0 == x) continue;
+      if(n == m) {
+          m = (m < 256) ? 256 : m << 1;
+          len = realloc(len, m * sizeof(int32_t));
+          count = realloc(count, m * sizeof(double));
+      }
+      len[n] = v;
+      count[n] = x;
+      n++;
+  }
+  for(i=0;i<n;i++) {
+      if(len[i] < lo) lo = len[i];
+      if(hi < len[i]) hi = len[i];
+      sum += count[i];
+  }
+  if(0 == n || sum <= 0) {
+      fprintf(stderr, "[frag_len_read] found no insert sizes\n");
+      exit(1);
+  }
+  fl->lo = lo;
+  fl->n = hi - lo + 1;
+  fl->p = calloc(fl->n, sizeof(double));
+  for(i=0;i<n;i++) {
+      fl->p[len[i] - lo] += count[i] / sum;
+  }
+  free(len); free(count);
+  return fl;
+}
+
+frag_len_t *
+frag_len_clip(const frag_len_t *fl, double lo, double hi)
+{
+  frag_len_t *f = calloc(1, sizeof(frag_len_t));
+  int64_t a = fl->lo, b = (int64_t)fl->lo + fl->n; // the lengths [a, b)
+
+  // as frag_len_normal: "d" is kept if [d - 0.5, d + 0.5) meets [lo, hi)
+  if(a <= lo - 0.5) a = (int64_t)floor(lo - 0.5) + 1;
+  if(hi + 0.5 < b) b = (int64_t)ceil(hi + 0.5);
+  if(b <= a) return f;
+  f->lo = a;
+  f->n = b - a;
+  f->p = malloc(f->n * sizeof(double));
+  memcpy(f->p, fl->p + (a - fl->lo), f->n * sizeof(double));
+  return f;
+}
+
+void
+frag_len_moments(const frag_len_t *fl, double *mean, double *sd)
+{
+  double s = 0.0, s1 = 0.0, s2 = 0.0, x;
+  int32_t i;
+
+  for(i=0;i<fl->n;i++) {
+      x = fl->lo + i;
+      s += fl->p[i];
+      s1 += fl->p[i] * x;
+  }
+  *mean = (0 < s) ? s1 / s : 0.0;
+  for(i=0;i<fl->n;i++) {
+      x = fl->lo + i - (*mean);
+      s2 += fl->p[i] * x * x;
+  }
+  *sd = (0 < s) ? sqrt(s2 / s) : 0.0;
+}
+
+void
+frag_len_destroy(frag_len_t *fl)
+{
+  if(NULL == fl) return;
+  free(fl->p);
+  free(fl);
+}
+
+// the lengths to sort by, for qsort (frag_build is not called concurrently)
+static const uint32_t *frag_sort_len = NULL;
+
+static int
+frag_cmp(const void *a, const void *b)
+{
+  uint32_t x = frag_sort_len[*(const int32_t*)a], y = frag_sort_len[*(const int32_t*)b];
+  return (x < y) ? -1 : ((y < x) ? 1 : 0);
+}
+
+// the first of the n sorted lengths of at least "span" bases
+static inline int32_t
+frag_lower_bound(const uint32_t *len, int32_t n, int64_t span)
+{
+  int32_t low = 0, high = n, mid;
+  while(low < high) {
+      mid = low + (high - low) / 2;
+      if(len[mid] < span) low = mid + 1;
+      else high = mid;
+  }
+  return low;
+}
+
+// the weighted number of admissible starts in regions [k0, k) for "span"
+#define __frag_starts(_f, _k0, _k, _span) \
+  (((_f)->cum_wl[(_k)] - (_f)->cum_wl[(_k0)]) - ((_span) - 1) * ((_f)->cum_w[(_k)] - (_f)->cum_w[(_k0)]))
+
+// the weighted number of starts of "span" past the caps
+#define __frag_starts_x(_f, _k0, _span) \
+  (((_f)->cum_xwl[(_f)->n_x] - (_f)->cum_xwl[(_k0)]) - ((_span) - 1) * ((_f)->cum_xw[(_f)->n_x] - (_f)->cum_xw[(_k0)]))
+
+// the weighted number of admissible starts over all regions for "span"
+static double
+frag_count(const frag_t *f, int64_t span)
+{
+  double a;
+  if(span < 1) return 0.0;
+  a = __frag_starts(f, frag_lower_bound(f->len, f->n, span), f->n, span);
+  if(0 < f->n_x) a -= __frag_starts_x(f, frag_lower_bound(f->x_len, f->n_x, span), span);
+  return a;
+}
+
+// sorts "n" regions by length into "len", "w" and the prefix sums "cum_w"
+// and "cum_wl"; "order" is filled with the sorted order
+static void
+frag_sort(int32_t n, const uint32_t *len_in, const double *w_in, int32_t *order, uint32_t *len, double *w, double *cum_w, double *cum_wl)
+{
+  int32_t i;
+  for(i=0;i<n;i++) order[i] = i;
+  frag_sort_len = len_in;
+  qsort(order, n, sizeof(int32_t), frag_cmp);
+  frag_sort_len = NULL;
+  cum_w[0] = cum_wl[0] = 0.0;
+  for(i=0;i<n;i++) {
+      len[i] = len_in[order[i]];
+      w[i] = (NULL == w_in) ? 1.0 : w_in[order[i]];
+      cum_w[i+1] = cum_w[i] + w[i];
+      cum_wl[i+1] = cum_wl[i] + w[i] * len[i];
+  }
+}
+
+// the sampler for "n" regions, taking ownership of the arrays; "w" and
+// "cap" may be NULL for a weight of one and no caps
+static frag_t *
+frag_build(int32_t n, uint32_t *start, uint32_t *len, double *w, uint32_t *cap, const frag_len_t *fl, int32_t extra)
+{
+  frag_t *f = calloc(1, sizeof(frag_t));
+  int32_t i, *order, *x_order;
+  uint32_t *x_len;
+  double *x_w, a, reached = 0.0;
+  frag_len_t w_d;
+
+  f->n = n;
+  f->extra = extra;
+  f->start = malloc((n + 1) * sizeof(uint32_t));
+  f->len = malloc((n + 1) * sizeof(uint32_t));
+  f->w = malloc((n + 1) * sizeof(double));
+  f->cum_w = malloc((n + 1) * sizeof(double));
+  f->cum_wl = malloc((n + 1) * sizeof(double));
+  order = malloc((n + 1) * sizeof(int32_t));
+  frag_sort(n, len, w, order, f->len, f->w, f->cum_w, f->cum_wl);
+  for(i=0;i<n;i++) {
+      f->start[i] = start[order[i]];
+  }
+  if(NULL != cap) {
+      f->cap = malloc((n + 1) * sizeof(uint32_t));
+      for(i=0;i<n;i++) {
+          f->cap[i] = cap[order[i]];
+      }
+      // the starts past each cap: a region of the bases beyond the cap
+      x_len = malloc((n + 1) * sizeof(uint32_t));
+      x_w = malloc((n + 1) * sizeof(double));
+      for(i=0;i<n;i++) {
+          if(cap[i] < len[i]) {
+              x_len[f->n_x] = len[i] - cap[i];
+              x_w[f->n_x] = (NULL == w) ? 1.0 : w[i];
+              f->n_x++;
+          }
+      }
+      f->x_len = malloc((f->n_x + 1) * sizeof(uint32_t));
+      f->x_w = malloc((f->n_x + 1) * sizeof(double));
+      f->cum_xw = malloc((f->n_x + 1) * sizeof(double));
+      f->cum_xwl = malloc((f->n_x + 1) * sizeof(double));
+      x_order = malloc((f->n_x + 1) * sizeof(int32_t));
+      frag_sort(f->n_x, x_len, x_w, x_order, f->x_len, f->x_w, f->cum_xw, f->cum_xwl);
+      free(x_len); free(x_w); free(x_order);
+  }
+  free(order); free(start); free(len); free(w); free(cap);
+
+  // the lengths with an admissible start, weighted by their starts
+  w_d.lo = fl->lo; w_d.n = 0;
+  w_d.p = malloc(((0 < fl->n) ? fl->n : 1) * sizeof(double));
+  for(i=0;i<fl->n;i++) {
+      a = frag_count(f, (int64_t)fl->lo + i + extra);
+      if(0 < a && 0 < fl->p[i]) {
+          if(0 == w_d.n) w_d.lo = fl->lo + i;
+          // the lengths in between (with no start) have no probability
+          while(w_d.lo + w_d.n < fl->lo + i) w_d.p[w_d.n++] = 0.0;
+          w_d.p[w_d.n++] = fl->p[i] * a;
+          reached += fl->p[i];
+      }
+  }
+  f->unreachable = 1.0 - reached;
+  if(f->unreachable < 0) f->unreachable = 0.0;
+  if(reached < FRAG_MIN_REACHED) w_d.n = 0;
+  f->alias = frag_alias_init(&w_d);
+  f->n_d = f->alias->n;
+  free(w_d.p);
+  return f;
+}
+
+frag_t *
+frag_init(const regions_bed_txt *r, uint32_t contig, const frag_len_t *fl, int32_t extra)
+{
+  uint32_t first = r->first[contig];
+  int32_t i, n = r->first[contig+1] - first;
+  uint32_t *start = malloc((n + 1) * sizeof(uint32_t)), *len = malloc((n + 1) * sizeof(uint32_t));
+  double *w = NULL;
+
+  if(NULL != r->weight) w = malloc((n + 1) * sizeof(double));
+  for(i=0;i<n;i++) {
+      start[i] = r->start[first + i];
+      len[i] = r->end[first + i] - r->start[first + i] + 1;
+      if(NULL != w) w[i] = r->weight[first + i];
+  }
+  return frag_build(n, start, len, w, NULL, fl, extra);
+}
+
+// moves the N at "pos" in run "r" forward by "t" Ns; past the last N, it
+// stays at the end of the sequence
+static inline void
+frag_gap_advance(const refseq_t *seq, int32_t *r, int64_t *pos, int64_t t)
+{
+  while(0 < t && *r < seq->n_runs) {
+      if(t < (int64_t)seq->run_end[*r] - *pos) {
+          *pos += t;
+          return;
+      }
+      t -= seq->run_end[*r] - *pos;
+      (*r)++;
+      *pos = (*r < seq->n_runs) ? seq->run_start[*r] : seq->l;
+  }
+}
+
+frag_t *
+frag_init_gaps(const refseq_t *seq, int32_t max_n, const frag_len_t *fl, int32_t extra)
+{
+  int32_t n = 0, m = 0, ra, rb;
+  int64_t a, b, t, len, prev = -1, min_span = (int64_t)fl->lo + extra;
+  uint32_t *start = NULL, *lens = NULL, *cap = NULL;
+
+  if(min_span < 1) min_span = 1;
+  // "prev" is the j-th N, "a" the next and "b" the (j + max_n + 1)-th
+  ra = 0; a = (0 < seq->n_runs) ? seq->run_start[0] : seq->l;
+  rb = ra; b = a;
+  frag_gap_advance(seq, &rb, &b, max_n);
+  while(0 < fl->n) {
+      // within a run, the windows hold only Ns: skip to the end of the run
+      if(max_n < min_span && rb < seq->n_runs && ra == rb && (int64_t)seq->run_start[ra] <= prev) {
+          t = seq->run_end[rb] - 1 - b;
+          prev += t; a += t; b += t;
+      }
+      len = b - prev - 1;
+      if(min_span <= len) {
+          if(n == m) {
+              m = (m < 16) ? 16 : m << 1;
+              start = realloc(start, m * sizeof(uint32_t));
+              lens = realloc(lens, m * sizeof(uint32_t));
+              cap = realloc(cap, m * sizeof(uint32_t));
+          }
+          start[n] = prev + 1;
+          lens[n] = len;
+          cap[n] = a - prev;
+          n++;
+      }
+      if(seq->n_runs <= ra) break; // past the last N
+      prev = a;
+      frag_gap_advance(seq, &ra, &a, 1);
+      frag_gap_advance(seq, &rb, &b, 1);
+  }
+  return frag_build(n, start, lens, NULL, (NULL == cap) ? calloc(1, sizeof(uint32_t)) : cap, fl, extra);
+}
+
+void
+frag_destroy(frag_t *f)
+{
+  if(NULL == f) return;
+  free(f->start); free(f->len); free(f->w);
+  free(f->cum_w); free(f->cum_wl);
+  free(f->cap); free(f->x_len); free(f->x_w);
+  free(f->cum_xw); free(f->cum_xwl);
+  frag_alias_destroy(f->alias);
+  free(f);
+}
+
+int32_t
+frag_sample(const frag_t *f, double u1, double u2, int32_t *d)
+{
+  double x = u1 * f->alias->n;
+
+  // the length: the fraction left after picking the column decides between
+  // the column and its alias
+  *d = frag_alias_sample(f->alias, u1, x - floor(x));
+  return frag_sample_pos(f, *d, u2);
+}
+
+int32_t
+frag_sample_pos(const frag_t *f, int32_t d, double u)
+{
+  int32_t low, high, mid, k0;
+  int64_t span = (int64_t)d + f->extra, offset;
+  double x;
+
+  // the region: the last whose admissible starts begin at or before the draw
+  k0 = frag_lower_bound(f->len, f->n, span);
+  x = u * __frag_starts(f, k0, f->n, span);
+  low = k0; high = f->n - 1;
+  while(low < high) {
+      mid = low + (high - low + 1) / 2;
+      if(__frag_starts(f, k0, mid, span) <= x) low = mid;
+      else high = mid - 1;
+  }
+  offset = (int64_t)((x - __frag_starts(f, k0, low, span)) / f->w[low]);
+  if(f->len[low] - span < offset) offset = f->len[low] - span;
+  if(offset < 0) offset = 0;
+  if(NULL != f->cap && f->cap[low] <= offset) return -1; // counted for another region
+  return f->start[low] + offset;
+}
+
+frag_alias_t *
+frag_alias_init(const frag_len_t *fl)
+{
+  frag_alias_t *a = calloc(1, sizeof(frag_alias_t));
+  int32_t i, s, g, n_small = 0, n_large = 0, *small, *large;
+
+  a->lo = fl->lo;
+  for(i=0;i<fl->n;i++) {
+      a->mass += fl->p[i];
+  }
+  if(fl->n <= 0 || a->mass <= 0) {
+      a->mass = 0.0;
+      return a;
+  }
+  a->n = fl->n;
+  a->prob = malloc(a->n * sizeof(double));
+  a->alias = malloc(a->n * sizeof(int32_t));
+  small = malloc(a->n * sizeof(int32_t));
+  large = malloc(a->n * sizeof(int32_t));
+  // scale to a mean of one, then pair each length below one with one above
+  for(i=0;i<a->n;i++) {
+      a->prob[i] = fl->p[i] * a->n / a->mass;
+      a->alias[i] = i;
+      if(a->prob[i] < 1.0) small[n_small++] = i;
+      else large[n_large++] = i;
+  }
+  while(0 < n_small && 0 < n_large) {
+      s = small[--n_small];
+      g = large[--n_large];
+      a->alias[s] = g;
+      a->prob[g] = (a->prob[g] + a->prob[s]) - 1.0;
+      if(a->prob[g] < 1.0) small[n_small++] = g;
+      else large[n_large++] = g;
+  }
+  // the rest are one, up to rounding
+  while(0 < n_large) a->prob[large[--n_large]] = 1.0;
+  while(0 < n_small) a->prob[small[--n_small]] = 1.0;
+  free(small); free(large);
+  return a;
+}
+
+void
+frag_alias_destroy(frag_alias_t *a)
+{
+  if(NULL == a) return;
+  free(a->prob); free(a->alias);
+  free(a);
+}
@@ -0,0 +1,151 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef FRAG_H
+#define FRAG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "contigs.h"
+#include "regions_bed.h"
+#include "refseq.h"
+
+/* Exact fragment sampling, within the targeted regions (-x) or else within
+ * the windows with few enough Ns (-n).  A fragment of length "d" spans
+ * "d + extra" bases, which must lie within one region.  For each length
+ * there are max(0, len - span + 1) admissible starts in a region of "len"
+ * bases, so with the regions sorted by length, the (weighted) number of
+ * admissible starts over all regions is a difference of prefix sums.  The
+ * fragment length is drawn in proportion to its probability times its
+ * admissible starts from an alias table, then the start is drawn uniformly
+ * (by weight) among them by binary search.  The probability of the lengths
+ * with no admissible start is reported as unreachable. */
+
+// below this probability, the lengths with an admissible start are taken
+// not to fit at all, rather than drawn in proportion to almost nothing
+#define FRAG_MIN_REACHED 1e-9
+
+// the distribution of the fragment length: lo, lo + 1, ..., lo + n - 1
+typedef struct {
+    int32_t lo, n;
+    double *p; /* sums to at most one; the rest is outside the lengths */
+} frag_len_t;
+
+/* Walker's alias table for the fragment length, drawn in constant time from
+ * two uniforms: pick a length uniformly, then keep it or take its alias. */
+typedef struct {
+    int32_t lo, n; /* the lengths lo, lo + 1, ..., lo + n - 1 */
+    double *prob; /* the probability of keeping each length */
+    int32_t *alias; /* the length taken otherwise */
+    double mass; /* the probability of the lengths in the table */
+} frag_alias_t;
+
+typedef struct {
+    int32_t n; /* the number of regions */
+    uint32_t *start, *len; /* sorted by length */
+    double *w; /* the weight of each region */
+    double *cum_w, *cum_wl; /* prefix sums of the weight and the weighted length, n + 1 */
+    uint32_t *cap; /* the starts of each region that are its own, or NULL for all */
+    int32_t n_x; /* the regions with starts beyond their cap */
+    uint32_t *x_len; /* the length beyond each cap, sorted */
+    double *x_w, *cum_xw, *cum_xwl; /* as w, cum_w and cum_wl */
+    int32_t extra; /* the bases spanned beyond the fragment length */
+    int32_t n_d; /* the fragment lengths with an admissible start */
+    frag_alias_t *alias; /* their probability times their admissible starts */
+    double unreachable; /* the probability of the lengths with no admissible start */
+} frag_t;
+
+/* Without regions, a window of the sequence has at most max_n Ns if it lies
+ * between the j-th N and the (j + max_n + 1)-th N, for some j.  These
+ * regions overlap, so each start is kept only in the region of the last N
+ * before it (its first "cap" starts); the starts beyond the caps are
+ * counted as regions of their own and subtracted.  A start drawn beyond
+ * its cap is redrawn for the same length, which succeeds with a
+ * probability of at least 1 / (max_n + 1); with max_n of zero the regions
+ * are the stretches between Ns and nothing is redrawn. */
+
+// the normal distribution (mu, sigma) rounded to integers, within [lo, hi)
+frag_len_t *
+frag_len_normal(double mu, double sigma, double lo, double hi);
+
+/* An insert-size histogram, one length per line optionally followed by its
+ * count (for example "samtools stats" IS lines, or a Picard
+ * CollectInsertSizeMetrics file, whose histogram section is used); a line
+ * with only a length counts once.  Other lines are skipped. */
+frag_len_t *
+frag_len_read(FILE *fp);
+
+// the lengths of "fl" within [lo, hi), keeping their probabilities
+frag_len_t *
+frag_len_clip(const frag_len_t *fl, double lo, double hi);
+
+// the mean and standard deviation of the lengths
+void
+frag_len_moments(const frag_len_t *fl, double *mean, double *sd);
+
+void
+frag_len_destroy(frag_len_t *fl);
+
+// the probability of the normal distribution (mu, sigma) outside [lo, hi)
+double
+frag_normal_outside(double mu, double sigma, double lo, double hi);
+
+// the sampler for the regions of a contig
+frag_t *
+frag_init(const regions_bed_txt *r, uint32_t contig, const frag_len_t *fl, int32_t extra);
+
+// the sampler for the windows of a sequence with at most "max_n" Ns
+frag_t *
+frag_init_gaps(const refseq_t *seq, int32_t max_n, const frag_len_t *fl, int32_t extra);
+
+void
+frag_destroy(frag_t *f);
+
+// the start of a fragment from two uniforms in [0,1), with its length in
+// "d"; the sampler must have at least one length (0 < n_d)
+int32_t
+frag_sample(const frag_t *f, double u1, double u2, int32_t *d);
+
+// the start of a fragment of length "d" from a uniform in [0,1), or -1 if
+// it must be redrawn (see frag_init_gaps)
+int32_t
+frag_sample_pos(const frag_t *f, int32_t d, double u);
+
+frag_alias_t *
+frag_alias_init(const frag_len_t *fl);
+
+void
+frag_alias_destroy(frag_alias_t *a);
+
+// a length from two uniforms in [0,1); the table must not be empty (0 < mass)
+static inline int32_t
+frag_alias_sample(const frag_alias_t *a, double u1, double u2)
+{
+  int32_t k = (int32_t)(u1 * a->n);
+  if(a->n <= k) k = a->n - 1;
+  return a->lo + ((u2 < a->prob[k]) ? k : a->alias[k]);
+}
+
+#endif
@@ -0,0 +1,295 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+#include "gzi.h"
+
+#define GZI_HEADER 12 // fixed part of the gzip header
+#define GZI_FOOTER 8 // CRC32 and uncompressed size
+#define GZI_MAX_BLOCK_SIZE 0x10000
+#define GZI_BLOCK_INPUT 0xff00 // uncompressed bytes per written block, as bgzip
+#define GZI_BLOCK_HEADER 18 // the gzip header with the BC subfield
+
+#define __gzi_u16(_p) ((uint32_t)(_p)[0] | ((uint32_t)(_p)[1] << 8))
+#define __gzi_u32(_p) (__gzi_u16(_p) | ((uint32_t)__gzi_u16((_p) + 2) << 16))
+
+// the size of the BGZF block starting at "p" (with "n" bytes available), or
+// zero if it is not a BGZF block
+static int64_t
+gzi_block_size(const uint8_t *p, int64_t n)
+{
+  uint32_t xlen, slen, i;
+  if(n < GZI_HEADER || 0x1f != p[0] || 0x8b != p[1] || 8 != p[2] || 0 == (p[3] & 4)) return 0;
+  xlen = __gzi_u16(p + 10);
+  if(n < GZI_HEADER + xlen) return 0;
+  // the BC subfield holds the block size less one
+  for(i = 0; i + 4 <= xlen; i += 4 + slen) {
+      slen = __gzi_u16(p + GZI_HEADER + i + 2);
+      if('B' == p[GZI_HEADER + i] && 'C' == p[GZI_HEADER + i + 1] && 2 == slen && i + 6 <= xlen) {
+          return (int64_t)__gzi_u16(p + GZI_HEADER + i + 4) + 1;
+      }
+  }
+  return 0;
+}
+
+int32_t
+gzi_is_gzip(FILE *fp)
+{
+  uint8_t buf[256];
+  int64_t n;
+  int32_t ret = GZI_PLAIN;
+  n = fread(buf, 1, 256, fp);
+  if(2 <= n && 0x1f == buf[0] && 0x8b == buf[1]) {
+      ret = (0 < gzi_block_size(buf, n)) ? GZI_BGZF : GZI_GZIP;
+  }
+  rewind(fp);
+  return ret;
+}
+
+static void
+gzi_add(gzi_t *gzi, int32_t *m, int64_t coffset, int64_t uoffset)
+{
+  if((*m) <= gzi->n + 1) {
+      (*m) = ((*m) < 16) ? 16 : ((*m) << 1);
+      gzi->coffset = realloc(gzi->coffset, sizeof(int64_t) * (*m));
+      gzi->uoffset = realloc(gzi->uoffset, sizeof(int64_t) * (*m));
+  }
+  gzi->coffset[gzi->n] = coffset;
+  gzi->uoffset[gzi->n] = uoffset;
+  gzi->n++;
+}
+
+gzi_t *
+gzi_init(FILE *fp, FILE *fp_gzi)
+{
+  gzi_t *gzi = NULL;
+  struct stat st;
+  void *data;
+  uint64_t n = 0, i, entry[2];
+  int64_t coffset, uoffset, bsize;
+  int32_t m = 0;
+
+  gzi = calloc(1, sizeof(gzi_t));
+
+  if(0 != fstat(fileno(fp), &st) || 0 == st.st_size) {
+      fprintf(stderr, "Error: could not stat the BGZF file\n");
+      exit(1);
+  }
+  gzi->size = st.st_size;
+  data = mmap(NULL, gzi->size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  if(MAP_FAILED == data) {
+      fprintf(stderr, "Error: could not memory-map the BGZF file\n");
+      exit(1);
+  }
+  gzi->data = data;
+
+  // the .gzi lists every block but the first
+  gzi_add(gzi, &m, 0, 0);
+  if(NULL != fp_gzi && 1 == fread(&n, sizeof(uint64_t), 1, fp_gzi)) {
+      for(i = 0; i < n; i++) {
+          if(2 != fread(entry, sizeof(uint64_t), 2, fp_gzi)
+             || entry[0] <= (uint64_t)gzi->coffset[gzi->n-1] || gzi->size <= entry[0]
+             || entry[1] < (uint64_t)gzi->uoffset[gzi->n-1]
+             || 0 == gzi_block_size(gzi->data + entry[0], gzi->size - entry[0])) {
+              fprintf(stderr, "Error: the .gzi does not match the BGZF file\n");
+              exit(1);
+          }
+          gzi_add(gzi, &m, entry[0], entry[1]);
+      }
+  }
+
+  // walk the remaining block headers, reading each size from its footer
+  coffset = gzi->coffset[gzi->n-1];
+  uoffset = gzi->uoffset[gzi->n-1];
+  gzi->n--;
+  while(coffset < (int64_t)gzi->size) {
+      bsize = gzi_block_size(gzi->data + coffset, gzi->size - coffset);
+      if(bsize < GZI_HEADER + __gzi_u16(gzi->data + coffset + 10) + GZI_FOOTER || (int64_t)gzi->size - coffset < bsize) {
+          fprintf(stderr, "Error: malformed BGZF block at offset %lld\n", (long long int)coffset);
+          exit(1);
+      }
+      gzi_add(gzi, &m, coffset, uoffset);
+      uoffset += __gzi_u32(gzi->data + coffset + bsize - 4);
+      coffset += bsize;
+  }
+  // the end, so block k spans [uoffset[k], uoffset[k+1])
+  gzi->coffset[gzi->n] = coffset;
+  gzi->uoffset[gzi->n] = uoffset;
+
+  return gzi;
+}
+
+void
+gzi_destroy(gzi_t *gzi)
+{
+  if(NULL == gzi) return;
+  munmap((void*)gzi->data, gzi->size);
+  free(gzi->coffset);
+  free(gzi->uoffset);
+  free(gzi);
+}
+
+// the index of the block containing the uncompressed "offset"
+static int32_t
+gzi_find(const gzi_t *gzi, int64_t offset)
+{
+  int32_t low = 0, high = gzi->n, mid;
+  // the first block starting after "offset", less one (skips empty blocks)
+  while (low < high) {
+      mid = low + ((high - low) >> 1);
+      if (gzi->uoffset[mid] <= offset) low = mid + 1;
+      else high = mid;
+  }
+  return low - 1;
+}
+
+void
+gzi_read(const gzi_t *gzi, int64_t offset, char *buf, int64_t len)
+{
+  z_stream zs;
+  uint8_t block[GZI_MAX_BLOCK_SIZE];
+  const uint8_t *p;
+  uint8_t *out;
+  int64_t start, n, from, to;
+  int32_t k, xlen;
+
+  if(offset < 0 || len < 0 || gzi_length(gzi) - offset < len) {
+      fprintf(stderr, "Error: out of range read from the BGZF file\n");
+      exit(1);
+  }
+  memset(&zs, 0, sizeof(z_stream));
+  if(Z_OK != inflateInit2(&zs, -15)) { // raw deflate
+      fprintf(stderr, "Error: could not initialize zlib\n");
+      exit(1);
+  }
+  for(k = gzi_find(gzi, offset); 0 < len; k++) {
+      start = gzi->uoffset[k];
+      n = gzi->uoffset[k+1] - start;
+      if(0 == n) continue;
+      if(GZI_MAX_BLOCK_SIZE < n) {
+          fprintf(stderr, "Error: malformed BGZF block at offset %lld\n", (long long int)gzi->coffset[k]);
+          exit(1);
+      }
+      // the part of this block to copy
+      from = offset - start;
+      to = (len < n - from) ? from + len : n;
+      // decompress in place when the whole block is wanted
+      out = (0 == from && n == to) ? (uint8_t*)buf : block;
+      p = gzi->data + gzi->coffset[k];
+      xlen = __gzi_u16(p + 10);
+      inflateReset(&zs);
+      zs.next_in = (Bytef*)(p + GZI_HEADER + xlen);
+      zs.avail_in = gzi->coffset[k+1] - gzi->coffset[k] - GZI_HEADER - xlen - GZI_FOOTER;
+      zs.next_out = out;
+      zs.avail_out = n;
+      if(Z_STREAM_END != inflate(&zs, Z_FINISH) || 0 != zs.avail_out
+         || crc32(crc32(0L, Z_NULL, 0), out, n) != __gzi_u32(p + gzi->coffset[k+1] - gzi->coffset[k] - GZI_FOOTER)) {
+          fprintf(stderr, "Error: corrupt BGZF block at offset %lld\n", (long long int)gzi->coffset[k]);
+          exit(1);
+      }
+      if(out == block) memcpy(buf, block + from, to - from);
+      buf += to - from;
+      offset += to - from;
+      len -= to - from;
+  }
+  inflateEnd(&zs);
+}
+
+// compresses "l" (at most GZI_BLOCK_INPUT) bytes into one block at "out",
+// returning the block size
+static int64_t
+gzi_deflate_block(const uint8_t *buf, int64_t l, int32_t level, uint8_t *out)
+{
+  static const uint8_t header[GZI_BLOCK_HEADER] = {
+      0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0
+  };
+  z_stream zs;
+  int64_t bsize;
+  uint32_t crc;
+  int ret;
+
+  memset(&zs, 0, sizeof(z_stream));
+  if(Z_OK != deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) { // raw deflate
+      fprintf(stderr, "Error: could not initialize zlib\n");
+      exit(1);
+  }
+  zs.next_in = (Bytef*)buf;
+  zs.avail_in = l;
+  zs.next_out = out + GZI_BLOCK_HEADER;
+  zs.avail_out = GZI_MAX_BLOCK_SIZE - GZI_BLOCK_HEADER - GZI_FOOTER;
+  ret = deflate(&zs, Z_FINISH);
+  deflateEnd(&zs);
+  if(Z_STREAM_END != ret) {
+      // did not fit, so store the bytes instead (always fits)
+      if(0 == level) {
+          fprintf(stderr, "Error: could not compress a BGZF block\n");
+          exit(1);
+      }
+      return gzi_deflate_block(buf, l, 0, out);
+  }
+  bsize = GZI_BLOCK_HEADER + zs.total_out + GZI_FOOTER;
+  memcpy(out, header, GZI_BLOCK_HEADER);
+  out[16] = (bsize - 1) & 0xff;
+  out[17] = (bsize - 1) >> 8;
+  crc = crc32(crc32(0L, Z_NULL, 0), buf, l);
+  out += bsize - GZI_FOOTER;
+  out[0] = crc & 0xff; out[1] = (crc >> 8) & 0xff; out[2] = (crc >> 16) & 0xff; out[3] = crc >> 24;
+  out[4] = l & 0xff; out[5] = (l >> 8) & 0xff; out[6] = (l >> 16) & 0xff; out[7] = l >> 24;
+  return bsize;
+}
+
+char *
+gzi_deflate(const char *buf, size_t l, int32_t level, size_t *out_l)
+{
+  uint8_t *out = NULL;
+  size_t i, n;
+
+  // a full block per GZI_BLOCK_INPUT bytes at most
+  out = malloc(((l + GZI_BLOCK_INPUT - 1) / GZI_BLOCK_INPUT + 1) * GZI_MAX_BLOCK_SIZE);
+  (*out_l) = 0;
+  for(i = 0; i < l; i += n) {
+      n = (l - i < GZI_BLOCK_INPUT) ? l - i : GZI_BLOCK_INPUT;
+      (*out_l) += gzi_deflate_block((const uint8_t*)buf + i, n, level, out + (*out_l));
+  }
+  return realloc(out, (0 < (*out_l)) ? (*out_l) : 1);
+}
+
+const uint8_t gzi_eof[GZI_EOF_L] = {
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+int32_t
+gzi_write_eof(FILE *fp)
+{
+  return (1 == fwrite(gzi_eof, GZI_EOF_L, 1, fp)) ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef GZI_H
+#define GZI_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Random access to a BGZF-compressed file (as written by bgzip): the file is
+ * memory-mapped and its blocks are indexed from the .gzi, or else by walking
+ * the block headers, so that any range of the uncompressed data can be
+ * decompressed independently.  Also writes BGZF: since each block is
+ * compressed on its own, buffers can be compressed by separate threads and
+ * the results concatenated in order. */
+
+enum {
+    GZI_PLAIN = 0, /* not compressed */
+    GZI_GZIP = 1, /* gzip, but not BGZF */
+    GZI_BGZF = 2
+};
+
+typedef struct {
+    int32_t n; /* number of blocks */
+    int64_t *coffset; /* compressed offset of each block, then the file size */
+    int64_t *uoffset; /* uncompressed offset of each block, then the total */
+    const uint8_t *data; /* the memory-mapped file */
+    size_t size;
+} gzi_t;
+
+// the uncompressed length
+#define gzi_length(_gzi) ((_gzi)->uoffset[(_gzi)->n])
+
+// is this file plain, gzip, or BGZF?
+int32_t
+gzi_is_gzip(FILE *fp);
+
+// indexes the BGZF file in "fp", using the .gzi in "fp_gzi" if not NULL
+gzi_t *
+gzi_init(FILE *fp, FILE *fp_gzi);
+
+void
+gzi_destroy(gzi_t *gzi);
+
+// decompresses "len" bytes starting at the uncompressed "offset" into "buf"
+void
+gzi_read(const gzi_t *gzi, int64_t offset, char *buf, int64_t len);
+
+// compresses "l" bytes from "buf" into BGZF blocks at the given zlib level,
+// returning a new buffer and its length in "out_l"
+char *
+gzi_deflate(const char *buf, size_t l, int32_t level, size_t *out_l);
+
+// the BGZF end-of-file marker (an empty block)
+#define GZI_EOF_L 28
+extern const uint8_t gzi_eof[GZI_EOF_L];
+
+// writes the BGZF end-of-file marker (an empty block); returns 1 on success
+int32_t
+gzi_write_eof(FILE *fp);
+
+#endif
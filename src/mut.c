@@ -36,56 +36,10 @@
 #include "mut_txt.h"
 #include "mut_bed.h"
 #include "regions_bed.h"
+#include "rng.h"
 #include "dwgsim_opt.h"
 #include "mut.h"
 
-static int SEQ_BLOCK_SIZE = 512;
-
-void seq_set_block_size(int size)
-{
-    SEQ_BLOCK_SIZE = size;
-}
-
-int seq_read_fasta(FILE *fp, seq_t *seq, char *locus, char *comment)
-{
-  int c, l, max;
-  char *p;
-
-  c = 0;
-  while (!feof(fp) && fgetc(fp) != '>');
-  if (feof(fp)) return -1;
-  p = locus;
-  while (!feof(fp) && (c = fgetc(fp)) != ' ' && c != '\t' && c != '\n')
-    if (c != '\r') *p++ = c;
-  *p = '\0';
-  if (comment) {
-      p = comment;
-      if (c != '\n') {
-          while (!feof(fp) && ((c = fgetc(fp)) == ' ' || c == '\t'));
-          if (c != '\n') {
-              *p++ = c;
-              while (!feof(fp) && (c = fgetc(fp)) != '\n')
-                if (c != '\r') *p++ = c;
-          }
-      }
-      *p = '\0';
-  } else if (c != '\n') while (!feof(fp) && fgetc(fp) != '\n');
-  l = 0; max = seq->m;
-  while (!feof(fp) && (c = fgetc(fp)) != '>') {
-      if (isalpha(c) || c == '-' || c == '.') {
-          if (l + 1 >= max) {
-              max += SEQ_BLOCK_SIZE;
-              seq->s = (unsigned char*)realloc(seq->s, sizeof(char) * max);
-          }
-          seq->s[l++] = (unsigned char)c;
-      }
-  }
-  if (c == '>') ungetc(c,fp);
-  seq->s[l] = 0;
-  seq->m = max; seq->l = l;
-  return l;
-} 
-
 mut_t mutmsk;
 mut_t mut_and_type_mask;
 mut_t muttype_shift;
@@ -133,16 +87,73 @@ mutseq_destroy(mutseq_t *seq)
       free(seq->ins[i]);
   }
   free(seq->ins);
+  free(seq->pos);
   free(seq->s);
   free(seq);
 }
 
+int32_t
+mutseq_lower_bound(const mutseq_t *seq, int32_t i)
+{
+  int32_t low = 0, high = seq->n, mid;
+  if (i <= 0) return 0;
+  while (low < high) {
+      mid = low + ((high - low) >> 1);
+      if (seq->pos[mid] < (uint32_t)i) low = mid + 1;
+      else high = mid;
+  }
+  return low;
+}
+
+mut_t
+mutseq_get(const mutseq_t *seq, int32_t i)
+{
+  int32_t k;
+  assert(0 <= i && i < seq->l);
+  k = mutseq_lower_bound(seq, i);
+  if (k < seq->n && seq->pos[k] == (uint32_t)i) return seq->s[k];
+  return mutseq_ref_base(seq, i);
+}
+
+void
+mutseq_set(mutseq_t *seq, int32_t i, mut_t m)
+{
+  int32_t k;
+  assert(0 <= i && i < seq->l);
+  // mutations are mostly added in order, so check the end first
+  if (0 == seq->n || seq->pos[seq->n-1] < (uint32_t)i) k = seq->n;
+  else k = mutseq_lower_bound(seq, i);
+  if (k < seq->n && seq->pos[k] == (uint32_t)i) { // replace
+      if (NOCHANGE == (m & mutmsk)) { // remove
+          memmove(seq->pos + k, seq->pos + k + 1, sizeof(uint32_t) * (seq->n - k - 1));
+          memmove(seq->s + k, seq->s + k + 1, sizeof(mut_t) * (seq->n - k - 1));
+          seq->n--;
+      }
+      else {
+          seq->s[k] = m;
+      }
+      return;
+  }
+  if (NOCHANGE == (m & mutmsk)) return; // nothing to store
+  while (seq->m <= seq->n) { // realloc
+      seq->m = (seq->m < 16) ? 16 : (seq->m << 1);
+      seq->pos = realloc(seq->pos, sizeof(uint32_t) * seq->m);
+      seq->s = realloc(seq->s, sizeof(mut_t) * seq->m);
+  }
+  if (k < seq->n) { // insert
+      memmove(seq->pos + k + 1, seq->pos + k, sizeof(uint32_t) * (seq->n - k));
+      memmove(seq->s + k + 1, seq->s + k, sizeof(mut_t) * (seq->n - k));
+  }
+  seq->pos[k] = i;
+  seq->s[k] = m;
+  seq->n++;
+}
+
 mut_t
 mut_get_ins_length(mutseq_t *seq, int32_t i)
 {
   mut_t m, n, index;
-  assert(0 <= i && i < seq->l);
-  m = seq->s[i];
+  m = mutseq_get(seq, i);
   assert(INSERT == (m & mutmsk));
   n = (m >> ins_length_shift) & ins_length_mask;
   if(0 == n) {
@@ -161,11 +172,8 @@ mut_get_ins_length(mutseq_t *seq, int32_t i)
 // if 0 is returned, the index into the long insertion list
 // is returned in "ins" and "n" is 0.
 int32_t
-mut_get_ins(mutseq_t *seq, int32_t i, mut_t *n, mut_t *ins)
+mut_get_ins(mutseq_t *seq, mut_t m, mut_t *n, mut_t *ins)
 {
-  mut_t m;
-  assert(0 <= i && i < seq->l);
-  m = seq->s[i];
   assert(INSERT == (m & mutmsk));
   (*n) = (m >> ins_length_shift) & ins_length_mask;
   (*ins) = (m >> muttype_shift) & ins_mask;
@@ -250,7 +258,7 @@ static inline void
 mut_print_ins(FILE *fp, mutseq_t *seq, int32_t i)
 {
   mut_t n, ins;
-  if(1 == mut_get_ins(seq, i, &n, &ins)) {
+  if(1 == mut_get_ins(seq, mutseq_get(seq, i), &n, &ins)) {
       while (n > 0) {
           fputc("ACGTN"[ins & 0x3], fp);
           ins >>= 2;
@@ -278,8 +286,19 @@ mut_print_ins(FILE *fp, mutseq_t *seq, int32_t i)
   }
 }
 
+// the length of a random indel: at least the minimum length, then extended
+// with probability indel_extend for each extra base (a geometric number)
+static mut_t
+mut_get_indel_length(dwgsim_opt_t *opt, rng_t *rng)
+{
+  uint64_t n = (opt->indel_min < 1) ? 1 : opt->indel_min;
+  uint64_t ext = rng_geometric(rng, 1.0 - opt->indel_extend);
+  if (ins_long_length_max - n < ext) return ins_long_length_max;
+  return (mut_t)(n + ext);
+}
+
 // bases is NULL if we are to randomly simulate the bases
-void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, int32_t c, int8_t hap, char *bases, mut_t num_ins)
+void mut_add_ins(dwgsim_opt_t *opt, rng_t *rng, mutseq_t *hap1, mutseq_t *hap2, int32_t i, int32_t c, int8_t hap, char *bases, mut_t num_ins)
 {
   mut_t ins = 0;
   int64_t j;
@@ -287,9 +306,7 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
   if (NULL == bases) {
       if(num_ins == 0) {
           // get the new insertion length
-          do {
-              num_ins++;
-          } while (num_ins < ins_long_length_max && (num_ins < opt->indel_min || drand48() < opt->indel_extend));
+          num_ins = mut_get_indel_length(opt, rng);
       }
   } else {
       num_ins = strlen(bases); // ignores num_ins
@@ -298,9 +315,9 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
 
   if (hap < 0) {
       // set ploidy
-      if (opt->is_hap || drand48() < 0.333333) { // hom-ins
+      if (opt->is_hap || rng_uniform(rng) < 0.333333) { // hom-ins
           hap = 3;
-      } else if (drand48() < 0.5) {
+      } else if (rng_uniform(rng) < 0.5) {
           hap = 1;
       } else {
           hap = 2;
@@ -310,8 +327,10 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
   if (num_ins <= ins_length_max) { // short
       // generate the insertion
       if (NULL == bases) {
+          double u[sizeof(mut_t) << 2]; // two bits per base
+          rng_uniforms(rng, u, num_ins);
           for (j=0;j<num_ins;j++) {
-              ins = (ins << 2) | (mut_t)(drand48() * 4.0);
+              ins = (ins << 2) | (mut_t)(u[j] * 4.0);
           }
       } else {
           for (j = num_ins; 0 <= j; --j) {
@@ -319,11 +338,12 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
           } 
       }
       // store
-      if (hap & 0x1) hap1->s[i] = (num_ins << ins_length_shift) | (ins << muttype_shift) | INSERT | c;
-      if (hap & 0x2) hap2->s[i] = (num_ins << ins_length_shift) | (ins << muttype_shift) | INSERT | c;
+      if (hap & 0x1) mutseq_set(hap1, i, (num_ins << ins_length_shift) | (ins << muttype_shift) | INSERT | c);
+      if (hap & 0x2) mutseq_set(hap2, i, (num_ins << ins_length_shift) | (ins << muttype_shift) | INSERT | c);
   } else { // long
-      int32_t byte_index, bit_index;
+      int32_t byte_index, bit_index, u_i;
       uint8_t *hap1_ins = NULL, *hap2_ins = NULL;
+      double u[64];
       if (hap & 0x1) {
           while (hap1->ins_m <= hap1->ins_l) { // realloc
               hap1->ins_m = (hap1->ins_m < 16) ? 16 : (hap1->ins_m << 1); 
@@ -342,10 +362,15 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
       }
       byte_index = 0;
       bit_index = 0;
+      u_i = 64;
       while(0 < num_ins) {
           uint8_t b;
           if (NULL == bases) {
-              b = ((uint8_t)(drand48() * 4.0)) << (bit_index << 1);
+              if (64 <= u_i) { // the next (up to) 64 bases
+                  rng_uniforms(rng, u, (num_ins < 64) ? num_ins : 64);
+                  u_i = 0;
+              }
+              b = ((uint8_t)(u[u_i++] * 4.0)) << (bit_index << 1);
           } else {
               b = nst_nt4_table[(int)bases[num_ins-1]] << (bit_index << 1);
           }
@@ -360,25 +385,42 @@ void mut_add_ins(dwgsim_opt_t *opt, mutseq_t *hap1, mutseq_t *hap2, int32_t i, i
       }
       if (hap & 0x1) {
           assert(hap1->ins_l <= ins_mask);
-          hap1->s[i] = (hap1->ins_l << muttype_shift) | INSERT | c;
+          mutseq_set(hap1, i, (hap1->ins_l << muttype_shift) | INSERT | c);
           hap1->ins_l++;
       }
       if (hap & 0x2) {
           assert(hap2->ins_l <= ins_mask);
-          hap2->s[i] = (hap2->ins_l << muttype_shift) | INSERT | c;
+          mutseq_set(hap2, i, (hap2->ins_l << muttype_shift) | INSERT | c);
           hap2->ins_l++;
       }
   }
 }
 
-void mut_debug(const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2)
+// the next position at or after i with a variant in either haplotype, or -1
+// if there is none; k[0] and k[1] are the indexes into each haplotype
+static int32_t
+mut_next_pos(const mutseq_t *hap1, const mutseq_t *hap2, int32_t *k, int32_t i)
 {
-  int32_t i;
+  while (k[0] < hap1->n && hap1->pos[k[0]] < (uint32_t)i) k[0]++;
+  while (k[1] < hap2->n && hap2->pos[k[1]] < (uint32_t)i) k[1]++;
+  if (k[0] < hap1->n) {
+      if (k[1] < hap2->n && hap2->pos[k[1]] < hap1->pos[k[0]]) return hap2->pos[k[1]];
+      return hap1->pos[k[0]];
+  }
+  else if (k[1] < hap2->n) {
+      return hap2->pos[k[1]];
+  }
+  return -1;
+}
+
+void mut_debug(const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2)
+{
+  int32_t i, k[2] = {0, 0};
   // DEBUG
-  for (i = 0; i < seq->l; ++i) {
+  for (i = mut_next_pos(hap1, hap2, k, 0); 0 <= i; i = mut_next_pos(hap1, hap2, k, i+1)) {
       mut_t c[3];
-      c[0] = nst_nt4_table[(mut_t)seq->s[i]];
-      c[1] = hap1->s[i]; c[2] = hap2->s[i];
+      c[0] = refseq_get(seq, i);
+      c[1] = mutseq_get_near(hap1, i, &k[0]); c[2] = mutseq_get_near(hap2, i, &k[1]);
       if (c[0] >= 4) continue;
       if ((c[1] & mutmsk) != NOCHANGE || (c[2] & mutmsk) != NOCHANGE) {
           if ((c[1] & mut_and_type_mask) == (c[2] & mut_and_type_mask)) { // hom
@@ -423,23 +465,27 @@ static void
 mut_left_justify_ins(mutseq_t *hap1, int32_t i)
 {
   // NB: should we also be checking both haps for homozygous cases
-  mut_t n, ins, j;
-  if(1 == mut_get_ins(hap1, i, &n, &ins)) { // short
+  mut_t n, ins, m, b;
+  int32_t j, k;
+  // the bases the insertion moves over have no variant, so only its position changes
+  k = mutseq_lower_bound(hap1, i);
+  assert(k < hap1->n && hap1->pos[k] == (uint32_t)i);
+  m = hap1->s[k];
+  if(1 == mut_get_ins(hap1, m, &n, &ins)) { // short
       assert(n > 0);
       j=i;
       while(0 < j
-            && INSERT != (hap1->s[j-1]&mutmsk) // no insertion
-            && SUBSTITUTE != (hap1->s[j-1]&mutmsk) // no substitution
-            && DELETE != (hap1->s[j-1]&mutmsk) // no deletion 
-            && ((ins >> ((n-1) << 1)) & 3) == (hap1->s[j-1]&3)) { // end of insertion matches previous base
+            && (0 == k || hap1->pos[k-1] < (uint32_t)(j-1)) // no variant
+            && ((ins >> ((n-1) << 1)) & 3) == (mutseq_ref_base(hap1, j-1)&3)) { // end of insertion matches previous base
           // update ins
           ins = (ins & ~((mut_t)3 << ((n-1) << 1))); // zero out the last base
           ins <<= 2; // shift over
-          ins |= (hap1->s[j-1]&3); // insert the first base
-          hap1->s[j] = (hap1->s[j]&3); // make it NOCHANGE
+          ins |= (mutseq_ref_base(hap1, j-1)&3); // insert the first base
           j--;
       }
-      hap1->s[j] = (n << ins_length_shift) | (ins << muttype_shift) | INSERT | (hap1->s[j]&3); // re-insert
+      b = (j == i) ? m : mutseq_ref_base(hap1, j);
+      hap1->pos[k] = j;
+      hap1->s[k] = (n << ins_length_shift) | (ins << muttype_shift) | INSERT | (b&3); // re-insert
   } else { // long
       int32_t byte_index;
       uint32_t num_ins;
@@ -448,10 +494,8 @@ mut_left_justify_ins(mutseq_t *hap1, int32_t i)
       assert(num_ins > 0);
       j=i;
       while(0 < j
-            && INSERT != (hap1->s[j-1]&mutmsk) // no insertion
-            && SUBSTITUTE != (hap1->s[j-1]&mutmsk) // no substitution
-            && DELETE != (hap1->s[j-1]&mutmsk) // no deletion 
-            && ((insertion[0] >> 6) & 3) == (hap1->s[j-1]&3)) { // end of insertion matches previous base
+            && (0 == k || hap1->pos[k-1] < (uint32_t)(j-1)) // no variant
+            && ((insertion[0] >> 6) & 3) == (mutseq_ref_base(hap1, j-1)&3)) { // end of insertion matches previous base
           // update ins
           for (byte_index = 0; byte_index < mut_packed_len(num_ins); byte_index++) {
               insertion[byte_index] <<= 2; // shift over
@@ -459,174 +503,196 @@ mut_left_justify_ins(mutseq_t *hap1, int32_t i)
                   insertion[byte_index] |= (insertion[byte_index+1] >> 6) & 3; 
               }
           }
-          insertion[mut_packed_len(num_ins)-1] |= (hap1->s[j]&3) << ((num_ins & 3) << 1); // insert first base
-          hap1->s[j] = (hap1->s[j]&3); // make it NOCHANGE
+          b = (j == i) ? m : mutseq_ref_base(hap1, j);
+          insertion[mut_packed_len(num_ins)-1] |= (b&3) << ((num_ins & 3) << 1); // insert first base
           j--;
       }
-      hap1->s[j] = (ins << muttype_shift) | INSERT | (hap1->s[j]&3); // re-insert
+      b = (j == i) ? m : mutseq_ref_base(hap1, j);
+      hap1->pos[k] = j;
+      hap1->s[k] = (ins << muttype_shift) | INSERT | (b&3); // re-insert
+  }
+}
+
+// the number of consecutive deleted bases starting with variant k
+static int32_t
+mut_get_del_length(const mutseq_t *hap, int32_t k)
+{
+  int32_t n = 1;
+  while (k+n < hap->n && hap->pos[k+n] == hap->pos[k]+n && DELETE == (hap->s[k+n]&mutmsk)) {
+      n++;
+  }
+  return n;
+}
+
+// can the deletion in variants [k, k+del_length) move left to position j?
+#define __mut_can_shift_del(hap, k, del_length, j) \
+  ((0 == (k) || (hap)->pos[(k)-1] < (uint32_t)(j)) /* no variant */ \
+   && (mutseq_ref_base(hap, j)&3) == ((hap)->s[(k)+(del_length)-1]&3)) /* bases match */
+
+// moves the deletion in variants [k, k+del_length) one base to the left
+static void
+mut_shift_del(mutseq_t *hap, int32_t k, int32_t del_length)
+{
+  int32_t j;
+  mut_t last = hap->s[k+del_length-1];
+  for (j = del_length-1; 0 < j; j--) {
+      hap->s[k+j] = hap->s[k+j-1];
+  }
+  hap->s[k] = last;
+  for (j = 0; j < del_length; j++) {
+      hap->pos[k+j]--;
   }
 }
 
 // left-justify all the insertions and deletions
 static void
-mut_left_justify(const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2)
+mut_left_justify(const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2)
 {
-  mut_t i, j;
-  int del_length;
+  int32_t i, j, k[2] = {0, 0}, prev_i = -2;
+  int32_t del_length, k1, k2;
   int prev_del[2] = {0, 0};
   assert(hap1->l == seq->l);
   assert(hap2->l == seq->l);
-  for (i = 0; i < seq->l; ++i) {
+  for (i = mut_next_pos(hap1, hap2, k, 0); 0 <= i; i = mut_next_pos(hap1, hap2, k, i+1)) {
       mut_t c[3];
-      c[0] = nst_nt4_table[(mut_t)seq->s[i]];
-      c[1] = hap1->s[i]; c[2] = hap2->s[i];
+      if (prev_i + 1 != i) prev_del[0] = prev_del[1] = 0; // unchanged bases in between
+      prev_i = i;
+      c[0] = refseq_get(seq, i);
+      c[1] = mutseq_get_near(hap1, i, &k[0]); c[2] = mutseq_get_near(hap2, i, &k[1]);
       if (c[0] >= 4) continue;
-      if ((c[1] & mutmsk) != NOCHANGE || (c[2] & mutmsk) != NOCHANGE) {
-          if ((c[1] & mut_and_type_mask) == (c[2] & mut_and_type_mask)) { // hom
-              // TODO: code re-use
-              if ((c[1]&mutmsk) == SUBSTITUTE) { // substitution
-                  prev_del[0] = prev_del[1] = 0;
-                  continue;
-              } else if ((c[1]&mutmsk) == DELETE) { // del
-                  if(prev_del[0] == 1 || prev_del[1] == 1) continue;
-                  prev_del[0] = prev_del[1] = 1;
-                  for(j=i+1,del_length=1;j<seq->l && (hap1->s[j]&mutmsk) == DELETE;j++) { // get del length
-                      del_length++;
+      if ((c[1] & mut_and_type_mask) == (c[2] & mut_and_type_mask)) { // hom
+          // TODO: code re-use
+          if ((c[1]&mutmsk) == SUBSTITUTE) { // substitution
+              prev_del[0] = prev_del[1] = 0;
+              continue;
+          } else if ((c[1]&mutmsk) == DELETE) { // del
+              if(prev_del[0] == 1 || prev_del[1] == 1) continue;
+              prev_del[0] = prev_del[1] = 1;
+              k1 = k[0]; k2 = k[1];
+              del_length = mut_get_del_length(hap1, k1);
+              if(seq->l <= i+del_length) continue;
+              if(del_length != mut_get_del_length(hap2, k2)) continue;
+              // left-justify
+              for(j=i-1;0 < i && 0<=j;j--) {
+                  if(__mut_can_shift_del(hap1, k1, del_length, j) && __mut_can_shift_del(hap2, k2, del_length, j)) {
+                      mut_shift_del(hap1, k1, del_length);
+                      mut_shift_del(hap2, k2, del_length);
                   }
-                  if(seq->l <= i+del_length) continue;
-                  // left-justify
-                  for(j=i-1;0 < i && 0<=j;j--) {
-                      if(INSERT != (hap1->s[j]&mutmsk) && INSERT != (hap2->s[j]&mutmsk) // no insertion
-                         && DELETE != (hap1->s[j]&mutmsk) && DELETE != (hap2->s[j]&mutmsk) // no deletion 
-                         && (hap1->s[j]&3) == (hap1->s[j+del_length]&3)  // hap1 bases match
-                         && (hap2->s[j]&3) == (hap2->s[j+del_length]&3)) { // hap2 bases match
-                          // shift and make it NOCHANGE
-                          mut_t t;
-                          t = hap1->s[j]; hap1->s[j] = hap1->s[j+del_length]; hap1->s[j+del_length] = (t | mutmsk) ^ mutmsk;
-                          t = hap2->s[j]; hap2->s[j] = hap2->s[j+del_length]; hap2->s[j+del_length] = (t | mutmsk) ^ mutmsk;
-                      }
-                      else {
-                          break;
-                      }
-                      if(0 == j) break;
+                  else {
+                      break;
                   }
-              } else if ((c[1] & mutmsk) == INSERT) { // ins
-                  prev_del[0] = prev_del[1] = 0;
-                  mut_left_justify_ins(hap1, i);
-                  mut_left_justify_ins(hap2, i);
-              }  else assert(0);
-          } else { // het
-              if ((c[1]&mutmsk) == SUBSTITUTE || (c[2]&mutmsk) == SUBSTITUTE) { // substitution
-                  prev_del[0] = prev_del[1] = 0;
-                  continue;
-              } else if ((c[1]&mutmsk) == DELETE) {
-                  if(prev_del[0] == 1) continue;
-                  prev_del[0] = 1;
-                  for(j=i+1,del_length=1;j<seq->l && (hap1->s[j]&mutmsk) == DELETE;j++) { // get del length
-                      del_length++;
+                  if(0 == j) break;
+              }
+          } else if ((c[1] & mutmsk) == INSERT) { // ins
+              prev_del[0] = prev_del[1] = 0;
+              mut_left_justify_ins(hap1, i);
+              mut_left_justify_ins(hap2, i);
+          }  else assert(0);
+      } else { // het
+          if ((c[1]&mutmsk) == SUBSTITUTE || (c[2]&mutmsk) == SUBSTITUTE) { // substitution
+              prev_del[0] = prev_del[1] = 0;
+              continue;
+          } else if ((c[1]&mutmsk) == DELETE) {
+              if(prev_del[0] == 1) continue;
+              prev_del[0] = 1;
+              k1 = k[0];
+              del_length = mut_get_del_length(hap1, k1);
+              if(seq->l <= i+del_length) continue;
+              // left-justify
+              for(j=i-1;0 < i && 0<=j;j--) {
+                  if(__mut_can_shift_del(hap1, k1, del_length, j)) {
+                      mut_shift_del(hap1, k1, del_length);
                   }
-                  if(seq->l <= i+del_length) continue;
-                  // left-justify
-                  for(j=i-1;0 < i && 0<=j;j--) {
-                      if(INSERT != (hap1->s[j]&mutmsk) // no insertion
-                         && SUBSTITUTE != (hap1->s[j]&mutmsk) // no substitution
-                         && DELETE != (hap1->s[j]&mutmsk) // no deletion 
-                         && (hap1->s[j]&3) == (hap1->s[j+del_length]&3))  { // hap1 bases match
-                          // shift and make it NOCHANGE
-                          mut_t t;
-                          t = hap1->s[j]; hap1->s[j] = hap1->s[j+del_length]; hap1->s[j+del_length] = (t | mutmsk) ^ mutmsk;
-                      }
-                      else {
-                          break;
-                      }
-                      if(0 == j) break;
+                  else {
+                      break;
                   }
-              } else if ((c[2]&mutmsk) == DELETE) {
-                  if(prev_del[1] == 1) continue;
-                  prev_del[1] = 1;
-                  for(j=i+1,del_length=1;j<seq->l && (hap2->s[j]&mutmsk) == DELETE;j++) { // get del length
-                      del_length++;
+                  if(0 == j) break;
+              }
+          } else if ((c[2]&mutmsk) == DELETE) {
+              if(prev_del[1] == 1) continue;
+              prev_del[1] = 1;
+              k2 = k[1];
+              del_length = mut_get_del_length(hap2, k2);
+              if(seq->l <= i+del_length) continue;
+              // left-justify
+              for(j=i-1;0 < i && 0<=j;j--) {
+                  if(__mut_can_shift_del(hap2, k2, del_length, j)) {
+                      mut_shift_del(hap2, k2, del_length);
                   }
-                  if(seq->l <= i+del_length) continue;
-                  // left-justify
-                  for(j=i-1;0 < i && 0<=j;j--) {
-                      if(INSERT != (hap2->s[j]&mutmsk) // no insertion
-                         && SUBSTITUTE != (hap2->s[j]&mutmsk) // no substitution
-                         && DELETE != (hap2->s[j]&mutmsk) // no deletion 
-                         && (hap2->s[j]&3) == (hap2->s[j+del_length]&3))  { // hap2 bases match
-                          // shift and make it NOCHANGE
-                          mut_t t;
-                          t = hap2->s[j]; hap2->s[j] = hap2->s[j+del_length]; hap2->s[j+del_length] = (t | mutmsk) ^ mutmsk;
-                      }
-                      else {
-                          break;
-                      }
-                      if(0 == j) break;
+                  else {
+                      break;
                   }
-              } else if ((c[1]&mutmsk) == INSERT) { // ins 1
-                  prev_del[0] = prev_del[1] = 0;
-                  mut_left_justify_ins(hap1, i);
-              } else if ((c[2]&mutmsk) == INSERT) { // ins 2
-                  prev_del[0] = prev_del[1] = 0;
-                  mut_left_justify_ins(hap2, i);
-              } else assert(0);
-          }
-      }
-      else {
-          prev_del[0] = prev_del[1] = 0;
+                  if(0 == j) break;
+              }
+          } else if ((c[1]&mutmsk) == INSERT) { // ins 1
+              prev_del[0] = prev_del[1] = 0;
+              mut_left_justify_ins(hap1, i);
+          } else if ((c[2]&mutmsk) == INSERT) { // ins 2
+              prev_del[0] = prev_del[1] = 0;
+              mut_left_justify_ins(hap2, i);
+          } else assert(0);
       }
   }
 }
 
-void mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2, 
+void mut_diref(dwgsim_opt_t *opt, const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2, 
                int32_t contig_i, muts_input_t *muts_input)
 {
   int32_t i, j, deleting = 0, deletion_length = 0;
   mutseq_t *ret[2];
+  rng_t rng;
+
+  // the mutations of each contig have their own random stream
+  rng_init(&rng, opt->seed, contig_i, RNG_MUTATIONS, 0);
 
   ret[0] = hap1; ret[1] = hap2;
   ret[0]->l = seq->l; ret[1]->l = seq->l;
-  ret[0]->m = seq->m; ret[1]->m = seq->m;
-  ret[0]->s = (mut_t *)calloc(seq->m, sizeof(mut_t));
-  ret[1]->s = (mut_t *)calloc(seq->m, sizeof(mut_t));
+  ret[0]->ref = seq; ret[1]->ref = seq;
+  ret[0]->n = 0; ret[1]->n = 0;
+  ret[0]->m = 0; ret[1]->m = 0;
+  ret[0]->pos = NULL; ret[1]->pos = NULL;
+  ret[0]->s = NULL; ret[1]->s = NULL;
   ret[0]->ins = NULL; ret[1]->ins = NULL;
   ret[0]->ins_l = 0; ret[1]->ins_l = 0;
   ret[0]->ins_m = 0; ret[1]->ins_m = 0;
 
   if(NULL == muts_input) {
-      for (i = 0; i < seq->l; ++i) {
-          mut_t c;
-          c = ret[0]->s[i] = ret[1]->s[i] = (mut_t)nst_nt4_table[(int)seq->s[i]];
-          if (deleting) {
-              if (deletion_length < opt->indel_min || drand48() < opt->indel_extend) {
-                  if (deleting & 1) ret[0]->s[i] |= DELETE|c;
-                  if (deleting & 2) ret[1]->s[i] |= DELETE|c;
-                  deletion_length++;
-                  continue;
-              } else deleting = deletion_length = 0;
-          }
-          if (c < 4 && drand48() < opt->mut_rate) { // mutation
-              if (drand48() >= opt->indel_frac) { // substitution
-                  double r = drand48();
-                  c = (c + (mut_t)(r * 3.0 + 1)) & 3;
-                  if (opt->is_hap || drand48() < 0.333333) { // hom
-                      ret[0]->s[i] = ret[1]->s[i] = SUBSTITUTE|c;
-                  } else { // het
-                      ret[drand48()<0.5?0:1]->s[i] = SUBSTITUTE|c;
+      // jump straight to the next mutation, as the number of bases between
+      // mutations is geometric
+      for (i = -1; ; ) {
+          mut_t c, del_length;
+          uint64_t skip = rng_geometric(&rng, opt->mut_rate);
+          if ((uint64_t)(seq->l - i - 1) <= skip) break;
+          i += skip + 1;
+          c = (mut_t)refseq_get(seq, i);
+          if (4 <= c) continue; // no mutations in Ns
+          if (rng_uniform(&rng) >= opt->indel_frac) { // substitution
+              double r = rng_uniform(&rng);
+              c = (c + (mut_t)(r * 3.0 + 1)) & 3;
+              if (opt->is_hap || rng_uniform(&rng) < 0.333333) { // hom
+                  mutseq_set(ret[0], i, SUBSTITUTE|c);
+                  mutseq_set(ret[1], i, SUBSTITUTE|c);
+              } else { // het
+                  mutseq_set(ret[rng_uniform(&rng)<0.5?0:1], i, SUBSTITUTE|c);
+              }
+          } else { // indel
+              if (rng_uniform(&rng) < 0.5) { // deletion
+                  if (opt->is_hap || rng_uniform(&rng) < 0.3333333) { // hom-del
+                      deleting = 3;
+                  } else { // het-del
+                      deleting = rng_uniform(&rng)<0.5?1:2;
                   }
-              } else { // indel
-                  if (drand48() < 0.5) { // deletion
-                      if (opt->is_hap || drand48() < 0.3333333) { // hom-del
-                          ret[0]->s[i] = ret[1]->s[i] = DELETE|c;
-                          deleting = 3;
-                      } else { // het-del
-                          deleting = drand48()<0.5?1:2;
-                          ret[deleting-1]->s[i] = DELETE|c;
-                      }
-                      deletion_length = 1;
-                  } else { // insertion
-                      mut_add_ins(opt, ret[0], ret[1], i, c, -1, NULL, 0);
+                  del_length = mut_get_indel_length(opt, &rng);
+                  deletion_length = ((mut_t)(seq->l - i) < del_length) ? seq->l - i : (int32_t)del_length;
+                  for (j = i; j < i + deletion_length; ++j) {
+                      c = (mut_t)refseq_get(seq, j);
+                      if (deleting & 1) mutseq_set(ret[0], j, DELETE|c);
+                      if (deleting & 2) mutseq_set(ret[1], j, DELETE|c);
                   }
+                  // the next mutation may start right after the deletion
+                  i += deletion_length - 1;
+              } else { // insertion
+                  mut_add_ins(opt, &rng, ret[0], ret[1], i, c, -1, NULL, 0);
               }
           }
       }
@@ -634,10 +700,6 @@ void mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *ha
   else {
       if(MUT_INPUT_BED == muts_input->type) { // BED
           muts_bed_t *muts_bed = muts_input->data.bed; 
-          // seed
-          for (i = 0; i < seq->l; ++i) {
-              ret[0]->s[i] = ret[1]->s[i] = (mut_t)nst_nt4_table[(int)seq->s[i]];
-          }
           // mutates exactly based on a BED file
           for (i = 0; i < muts_bed->n; ++i) {
               if (muts_bed->muts[i].contig == contig_i) {
@@ -649,49 +711,51 @@ void mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *ha
                   if (0 == strcmp("*", muts_bed->muts[i].bases)) has_bases = 0; // random bases
 
                   // het or hom?
-                  if (opt->is_hap || drand48() < 0.333333) {
+                  if (opt->is_hap || rng_uniform(&rng) < 0.333333) {
                       is_hom = 1; // hom
                       hap = 3;
                   }
                   else {
-                      which_hap = drand48()<0.5?0:1;
+                      which_hap = rng_uniform(&rng)<0.5?0:1;
                       hap = 1 << which_hap;
                   }
 
                   // mutate
                   if (SUBSTITUTE == muts_bed->muts[i].type) {
                       for (j = muts_bed->muts[i].start; j < muts_bed->muts[i].end; ++j) { // for each base
-                          c = (mut_t)nst_nt4_table[(int)seq->s[j]];
+                          c = (mut_t)refseq_get(seq, j);
                           if (0 == has_bases) { // random DNA base
-                              double r = drand48();
+                              double r = rng_uniform(&rng);
                               c = (c + (mut_t)(r * 3.0 + 1)) & 3;
                           }
                           else {
                               c = (mut_t)nst_nt4_table[(int)muts_bed->muts[i].bases[j - muts_bed->muts[i].start]]; 
                           }
                           if (1 == is_hom) {
-                              ret[0]->s[j] = ret[1]->s[j] = SUBSTITUTE|c;
+                              mutseq_set(ret[0], j, SUBSTITUTE|c);
+                              mutseq_set(ret[1], j, SUBSTITUTE|c);
                           } else { // het
-                              ret[which_hap]->s[j] = SUBSTITUTE|c;
+                              mutseq_set(ret[which_hap], j, SUBSTITUTE|c);
                           }
                       }
                   }
                   else if (DELETE == muts_bed->muts[i].type) {
                       for (j = muts_bed->muts[i].start; j < muts_bed->muts[i].end; ++j) { // for each base
-                          c = (mut_t)nst_nt4_table[(int)seq->s[j]];
+                          c = (mut_t)refseq_get(seq, j);
                           if (1 == is_hom) {
-                              ret[0]->s[j] = ret[1]->s[j] = DELETE|c;
+                              mutseq_set(ret[0], j, DELETE|c);
+                              mutseq_set(ret[1], j, DELETE|c);
                           } else { // het-del
-                              ret[which_hap]->s[j] = DELETE|c;
+                              mutseq_set(ret[which_hap], j, DELETE|c);
                           }
                       }
                   }
                   else if (INSERT == muts_bed->muts[i].type) {
-                      c = (mut_t)nst_nt4_table[(int)seq->s[muts_bed->muts[i].start]];
+                      c = (mut_t)refseq_get(seq, muts_bed->muts[i].start);
                       if (0 == has_bases) {
-                          mut_add_ins(opt, ret[0], ret[1], muts_bed->muts[i].start, c, hap, NULL, muts_bed->muts[i].end - muts_bed->muts[i].start);
+                          mut_add_ins(opt, &rng, ret[0], ret[1], muts_bed->muts[i].start, c, hap, NULL, muts_bed->muts[i].end - muts_bed->muts[i].start);
                       } else {
-                          mut_add_ins(opt, ret[0], ret[1], muts_bed->muts[i].start, c, hap, muts_bed->muts[i].bases, 0);
+                          mut_add_ins(opt, &rng, ret[0], ret[1], muts_bed->muts[i].start, c, hap, muts_bed->muts[i].bases, 0);
                       }
                   }
               }
@@ -708,27 +772,23 @@ void mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *ha
           else {
               muts_txt = muts_input->data.vcf; 
           }
-          // seed
-          for (i = 0; i < seq->l; ++i) {
-              ret[0]->s[i] = ret[1]->s[i] = (mut_t)nst_nt4_table[(int)seq->s[i]];
-          }
           for (i = 0; i < muts_txt->n; ++i) {
               if (muts_txt->muts[i].contig == contig_i) {
                   int8_t type = muts_txt->muts[i].type;
                   uint32_t pos = muts_txt->muts[i].pos;
                   int8_t is_hap = muts_txt->muts[i].is_hap;
-                  mut_t c = (mut_t)nst_nt4_table[(int)seq->s[pos-1]];
+                  mut_t c = (mut_t)refseq_get(seq, pos-1);
 
                   if (DELETE == type) {
-                      if (is_hap & 1) ret[0]->s[pos-1] |= DELETE|c;
-                      if (is_hap & 2) ret[1]->s[pos-1] |= DELETE|c;
+                      if (is_hap & 1) mutseq_set(ret[0], pos-1, mutseq_get(ret[0], pos-1)|DELETE|c);
+                      if (is_hap & 2) mutseq_set(ret[1], pos-1, mutseq_get(ret[1], pos-1)|DELETE|c);
                   }
                   else if (SUBSTITUTE == type) {
-                      if (is_hap & 1) ret[0]->s[pos-1] = SUBSTITUTE|nst_nt4_table[(int)muts_txt->muts[i].bases[0]];
-                      if (is_hap & 2) ret[1]->s[pos-1] = SUBSTITUTE|nst_nt4_table[(int)muts_txt->muts[i].bases[0]];
+                      if (is_hap & 1) mutseq_set(ret[0], pos-1, SUBSTITUTE|nst_nt4_table[(int)muts_txt->muts[i].bases[0]]);
+                      if (is_hap & 2) mutseq_set(ret[1], pos-1, SUBSTITUTE|nst_nt4_table[(int)muts_txt->muts[i].bases[0]]);
                   }
                   else if (INSERT == type) {
-                      mut_add_ins(opt, ret[0], ret[1], pos-1, c, is_hap, muts_txt->muts[i].bases, 0);
+                      mut_add_ins(opt, &rng, ret[0], ret[1], pos-1, c, is_hap, muts_txt->muts[i].bases, 0);
                   }
               }
           }
@@ -747,9 +807,9 @@ void mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *ha
   mut_debug(seq, hap1, hap2);
 }
 
-void mut_print(const char *name, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2, FILE *fpout_txt, FILE *fpout_vcf)
+void mut_print(const char *name, const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2, FILE *fpout_txt, FILE *fpout_vcf)
 {
-  int32_t i, j, hap;
+  int32_t i, j, hap, k[2] = {0, 0};
   
   // header
   fprintf(fpout_vcf, "##fileformat=VCFv4.1\n");
@@ -757,10 +817,10 @@ void mut_print(const char *name, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap
   
   // body
   mut_t mut_prev[2] = {NOCHANGE,NOCHANGE}; // for deletions
-  for (i = 0; i < seq->l; ++i) {
+  for (i = mut_next_pos(hap1, hap2, k, 0); 0 <= i; i = mut_next_pos(hap1, hap2, k, i+1)) {
       mut_t c[3];
-      c[0] = nst_nt4_table[(int)seq->s[i]];
-      c[1] = hap1->s[i]; c[2] = hap2->s[i];
+      c[0] = refseq_get(seq, i);
+      c[1] = mutseq_get_near(hap1, i, &k[0]); c[2] = mutseq_get_near(hap2, i, &k[1]);
       if (c[0] >= 4) {
           // do nothing
       } else if ((c[1] & mutmsk) != NOCHANGE || (c[2] & mutmsk) != NOCHANGE) {
@@ -772,21 +832,21 @@ void mut_print(const char *name, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap
               } else if ((c[1]&mutmsk) == DELETE) { // del
                   fprintf(fpout_txt, "%c\t-\t3\n", "ACGTN"[c[0]]);
                   fprintf(fpout_vcf, "%s\t%d\t.\t", name, i);
-                  if (0 < i) fputc("ACGTN"[nst_nt4_table[(int)seq->s[i-1]]], fpout_vcf);
+                  if (0 < i) fputc("ACGTN"[refseq_get(seq, i-1)], fpout_vcf);
                   for (j = i; j < seq->l && (c[1] & mut_and_type_mask) == (c[2] & mut_and_type_mask) && (c[1]&mutmsk) == DELETE; ++j) {
                       fputc("ACGTN"[c[0]], fpout_vcf);
                       // NB: this modifies 'c'
                       if (j+1 < seq->l) { 
-                          c[0] = nst_nt4_table[(int)seq->s[j+1]];
-                          c[1] = hap1->s[j+1]; c[2] = hap2->s[j+1];
+                          c[0] = refseq_get(seq, j+1);
+                          c[1] = mutseq_get(hap1, j+1); c[2] = mutseq_get(hap2, j+1);
                       }
                   }
-                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[nst_nt4_table[(int)seq->s[i-1]]]);
+                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[refseq_get(seq, i-1)]);
                   else fprintf(fpout_vcf, "\t.");
                   fprintf(fpout_vcf, "\t100\tPASS\tAF=1.0;pl=3;mt=DELETE\n"); 
                   // NB: convert back 'c'
-                  c[0] = nst_nt4_table[(int)seq->s[i]];
-                  c[1] = hap1->s[i]; c[2] = hap2->s[i];
+                  c[0] = refseq_get(seq, i);
+                  c[1] = mutseq_get(hap1, i); c[2] = mutseq_get(hap2, i);
               } else if ((c[1] & mutmsk) == INSERT) { // ins
                   fprintf(fpout_txt, "-\t");
                   mut_print_ins(fpout_txt, hap1, i);
@@ -804,39 +864,39 @@ void mut_print(const char *name, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap
               } else if ((c[1]&mutmsk) == DELETE) {
                   fprintf(fpout_txt, "%c\t-\t1\n", "ACGTN"[c[0]]);
                   fprintf(fpout_vcf, "%s\t%d\t.\t", name, i);
-                  if (0 < i) fputc("ACGTN"[nst_nt4_table[(int)seq->s[i-1]]], fpout_vcf);
+                  if (0 < i) fputc("ACGTN"[refseq_get(seq, i-1)], fpout_vcf);
                   for (j = i; j < seq->l && (c[1] & mut_and_type_mask) != (c[2] & mut_and_type_mask) && (c[1]&mutmsk) == DELETE; ++j) {
                       fputc("ACGTN"[c[0]], fpout_vcf);
                       // NB: this modifies 'c'
                       if (j+1 < seq->l) { 
-                          c[0] = nst_nt4_table[(int)seq->s[j+1]];
-                          c[1] = hap1->s[j+1]; c[2] = hap2->s[j+1];
+                          c[0] = refseq_get(seq, j+1);
+                          c[1] = mutseq_get(hap1, j+1); c[2] = mutseq_get(hap2, j+1);
                       }
                   }
-                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[nst_nt4_table[(int)seq->s[i-1]]]);
+                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[refseq_get(seq, i-1)]);
                   else fprintf(fpout_vcf, "\t.");
                   fprintf(fpout_vcf, "\t100\tPASS\tAF=1.0;pl=1;mt=DELETE\n"); 
                   // NB: convert back 'c'
-                  c[0] = nst_nt4_table[(int)seq->s[i]];
-                  c[1] = hap1->s[i]; c[2] = hap2->s[i];
+                  c[0] = refseq_get(seq, i);
+                  c[1] = mutseq_get(hap1, i); c[2] = mutseq_get(hap2, i);
               } else if ((c[2]&mutmsk) == DELETE) {
                   fprintf(fpout_txt, "%c\t-\t2\n", "ACGTN"[c[0]]);
                   fprintf(fpout_vcf, "%s\t%d\t.\t", name, i);
-                  if (0 < i) fputc("ACGTN"[nst_nt4_table[(int)seq->s[i-1]]], fpout_vcf);
+                  if (0 < i) fputc("ACGTN"[refseq_get(seq, i-1)], fpout_vcf);
                   for (j = i; j < seq->l && (c[1] & mut_and_type_mask) != (c[2] & mut_and_type_mask) && (c[2]&mutmsk) == DELETE; ++j) {
                       fputc("ACGTN"[c[0]], fpout_vcf);
                       // NB: this modifies 'c'
                       if (j+1 < seq->l) { 
-                          c[0] = nst_nt4_table[(int)seq->s[j+1]];
-                          c[1] = hap1->s[j+1]; c[2] = hap2->s[j+1];
+                          c[0] = refseq_get(seq, j+1);
+                          c[1] = mutseq_get(hap1, j+1); c[2] = mutseq_get(hap2, j+1);
                       }
                   }
-                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[nst_nt4_table[(int)seq->s[i-1]]]);
+                  if (0 < i) fprintf(fpout_vcf, "\t%c", "ACGTN"[refseq_get(seq, i-1)]);
                   else fprintf(fpout_vcf, "\t.");
                   fprintf(fpout_vcf, "\t100\tPASS\tAF=1.0;pl=2;mt=DELETE\n"); 
                   // NB: convert back 'c'
-                  c[0] = nst_nt4_table[(int)seq->s[i]];
-                  c[1] = hap1->s[i]; c[2] = hap2->s[i];
+                  c[0] = refseq_get(seq, i);
+                  c[1] = mutseq_get(hap1, i); c[2] = mutseq_get(hap2, i);
               } else if ((c[1]&mutmsk) == INSERT) { // ins 1
                   fprintf(fpout_txt, "-\t");
                   mut_print_ins(fpout_txt, hap1, i);
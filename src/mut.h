@@ -7,20 +7,7 @@
 #include "mut_input.h"
 #include "dwgsim_opt.h"
 #include "dwgsim.h"
-
-/* FASTA parser, copied from seq.c */
-typedef struct {
-    int l, m; /* length and maximum buffer size */
-    unsigned char *s; /* sequence */
-} seq_t;
-
-#define INIT_SEQ(seq) (seq).s = 0; (seq).l = (seq).m = 0
-
-void 
-seq_set_block_size(int size);
-
-int 
-seq_read_fasta(FILE *fp, seq_t *seq, char *locus, char *comment);
+#include "refseq.h"
 
 enum muttype_t {
     NOCHANGE = 0, 
@@ -39,13 +26,22 @@ extern mut_t ins_length_max;
 extern mut_t ins_long_length_max;
 extern mut_t ins_mask;
 
+/* A haplotype is stored as the variants over the shared reference: a list
+ * sorted by position, so the memory scales with the number of mutations.
+ * All other positions are the (unchanged) reference base. */
 typedef struct {
-    int l, m; /* length and maximum buffer size */
-    mut_t *s; /* sequence */
+    int l; /* length of the reference */
+    const refseq_t *ref; /* the shared reference */
+    int32_t n, m; /* number of variants and maximum buffer size */
+    uint32_t *pos; /* zero-based position of each variant, increasing */
+    mut_t *s; /* variants */
     uint8_t **ins; /* long insertions */
     int ins_l, ins_m; /* length and maximum buffer size for long insertions */
 } mutseq_t;
 
+// the reference base at position i
+#define mutseq_ref_base(_seq, _i) ((mut_t)refseq_get((_seq)->ref, (_i)))
+
 void
 mutseq_init_bounds();
 
@@ -55,6 +51,29 @@ mutseq_init();
 void
 mutseq_destroy(mutseq_t *seq);
 
+// the index of the first variant at or after position i
+int32_t
+mutseq_lower_bound(const mutseq_t *seq, int32_t i);
+
+// the variant at position i, or the reference base if there is none
+mut_t
+mutseq_get(const mutseq_t *seq, int32_t i);
+
+// stores (or, for NOCHANGE, removes) the variant at position i
+void
+mutseq_set(mutseq_t *seq, int32_t i, mut_t m);
+
+// mutseq_get for sequential access in either direction: "k" is the index of
+// the first variant at or after the previous position (see mutseq_lower_bound)
+static inline mut_t
+mutseq_get_near(const mutseq_t *seq, int32_t i, int32_t *k)
+{
+  while (0 < (*k) && (uint32_t)i <= seq->pos[(*k)-1]) (*k)--;
+  while ((*k) < seq->n && seq->pos[(*k)] < (uint32_t)i) (*k)++;
+  if ((*k) < seq->n && seq->pos[(*k)] == (uint32_t)i) return seq->s[(*k)];
+  return mutseq_ref_base(seq, i);
+}
+
 inline int32_t
 mut_get_ins_bytes(int32_t n);
 
@@ -65,10 +84,10 @@ mut_t
 mut_get_ins_length(mutseq_t *seq, int32_t i);
 
 int32_t
-mut_get_ins(mutseq_t *seq, int32_t i, mut_t *n, mut_t *ins);
+mut_get_ins(mutseq_t *seq, mut_t m, mut_t *n, mut_t *ins);
 
 void 
-mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2, int32_t contig_i, muts_input_t *muts_input);
+mut_diref(dwgsim_opt_t *opt, const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2, int32_t contig_i, muts_input_t *muts_input);
 
 // Columns:
 // 1 - chromosome name
@@ -77,7 +96,7 @@ mut_diref(dwgsim_opt_t *opt, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2, i
 // 4 - variant allele (IUPAC code or insertion base(s))
 // 5 - '-' for homozygous, '+' for heterozygous
 void 
-mut_print(const char *name, const seq_t *seq, mutseq_t *hap1, mutseq_t *hap2, FILE *fpout_txt, FILE *fpout_vcf);
+mut_print(const char *name, const refseq_t *seq, mutseq_t *hap1, mutseq_t *hap2, FILE *fpout_txt, FILE *fpout_vcf);
 
 // 0 - 0
 // 1 - 1
@@ -0,0 +1,239 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "dwgsim.h"
+#include "dwgsim_eval_counts.h"
+#include "writer.h"
+#include "pipeline.h"
+
+// the SAM fields used in the evaluation
+#define PIPELINE_FIELDS 11
+
+static void
+pipeline_add_target(pipeline_t *p, char *line)
+{
+  char *sn = strstr(line, "\tSN:"), *q;
+  if(NULL == sn) return;
+  sn += 4;
+  q = strchr(sn, '\t');
+  if(NULL != q) *q = '\0';
+  if(p->n_targets == p->m_targets) {
+      p->m_targets = (p->m_targets < 16) ? 16 : p->m_targets << 1;
+      p->target_name = realloc(p->target_name, p->m_targets * sizeof(char*));
+  }
+  p->target_name[p->n_targets++] = strdup(sn);
+}
+
+// the number of clipped bases at the start of the CIGAR
+static int32_t
+pipeline_clip(const char *cigar)
+{
+  int32_t clip = 0, n;
+  char *q;
+  while('\0' != *cigar && '*' != *cigar) {
+      n = strtol(cigar, &q, 10);
+      if('S' != *q && 'H' != *q) break;
+      clip += n;
+      cigar = q + 1;
+  }
+  return clip;
+}
+
+// evaluates a SAM line
+static void
+pipeline_add(pipeline_t *p, char *line)
+{
+  char *f[PIPELINE_FIELDS], *q = line, *tag;
+  dwgsim_eval_aln_t aln;
+  int32_t i;
+
+  for(i=0;i<PIPELINE_FIELDS;i++) {
+      f[i] = q;
+      q = strchr(q, '\t');
+      if(NULL == q) {
+          if(PIPELINE_FIELDS - 1 != i) {
+              fprintf(stderr, "[pipeline] could not parse the SAM line: %s\n", line);
+              exit(1);
+          }
+          break;
+      }
+      *q++ = '\0';
+  }
+  aln.flag = atoi(f[1]);
+  if(aln.flag & 0x900) return; // secondary or supplementary
+  aln.qname = f[0];
+  aln.qual = atoi(f[4]);
+  aln.chr = (aln.flag & DWGSIM_EVAL_FUNMAP) ? NULL : f[2];
+  aln.pos = atoi(f[3]) - 1;
+  aln.clip = pipeline_clip(f[5]);
+  aln.has_as = aln.has_xs = 0;
+  aln.as = aln.xs = 0;
+  while(NULL != q) { // the tags
+      tag = q;
+      q = strchr(q, '\t');
+      if(NULL != q) *q++ = '\0';
+      if(0 == strncmp(tag, "AS:i:", 5)) {
+          aln.has_as = 1;
+          aln.as = atoi(tag + 5);
+      }
+      else if(0 == strncmp(tag, "XS:i:", 5)) {
+          aln.has_xs = 1;
+          aln.xs = atoi(tag + 5);
+      }
+  }
+  dwgsim_eval_process(p->counts, &p->args, &aln, p->n_targets, p->target_name);
+  p->n_reads++;
+}
+
+static void *
+pipeline_run(void *arg)
+{
+  pipeline_t *p = (pipeline_t*)arg;
+  char *line = NULL;
+  size_t m = 0;
+  ssize_t l;
+
+  while(0 < (l = getline(&line, &m, p->fp_out))) {
+      if('\n' == line[l-1]) line[--l] = '\0';
+      if(0 == l) continue;
+      if('@' == line[0]) {
+          if(0 == strncmp(line, "@SQ\t", 4)) pipeline_add_target(p, line);
+          continue;
+      }
+      pipeline_add(p, line);
+  }
+  free(line);
+  return NULL;
+}
+
+pipeline_t *
+pipeline_init(const char *cmd, int32_t data_type, int32_t is_paired, const char *read_prefix, size_t buffer_size)
+{
+  pipeline_t *p = NULL;
+  int fd_in[2], fd_out[2];
+
+  p = calloc(1, sizeof(pipeline_t));
+  // as the dwgsim_eval defaults, with BWA read names
+  p->args.a = p->args.i = p->args.m = p->args.n = p->args.p = p->args.q = p->args.S = 0;
+  p->args.b = 1;
+  p->args.c = (SOLID == data_type) ? 1 : 0;
+  p->args.d = 1;
+  p->args.e = -1;
+  p->args.g = 5;
+  p->args.s = -1;
+  p->args.z = (1 == is_paired) ? 0 : 1;
+  p->args.P = (NULL == read_prefix) ? NULL : strdup(read_prefix);
+  p->counts = dwgsim_eval_counts_init();
+  p->t_start = writer_time();
+
+  if(0 != pipe(fd_in) || 0 != pipe(fd_out)) {
+      fprintf(stderr, "[pipeline] could not create a pipe\n");
+      exit(1);
+  }
+  fflush(stdout); fflush(stderr);
+  p->pid = fork();
+  if(p->pid < 0) {
+      fprintf(stderr, "[pipeline] could not start the aligner\n");
+      exit(1);
+  }
+  else if(0 == p->pid) { // the aligner
+      dup2(fd_in[0], STDIN_FILENO);
+      dup2(fd_out[1], STDOUT_FILENO);
+      close(fd_in[0]); close(fd_in[1]);
+      close(fd_out[0]); close(fd_out[1]);
+      execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+      fprintf(stderr, "[pipeline] could not run /bin/sh\n");
+      _exit(127);
+  }
+  close(fd_in[0]);
+  close(fd_out[1]);
+  // a failed write is reported by the sink, rather than killing dwgsim
+  signal(SIGPIPE, SIG_IGN);
+  p->fp_in = fdopen(fd_in[1], "w");
+  p->fp_out = fdopen(fd_out[0], "r");
+  if(NULL == p->fp_in || NULL == p->fp_out) {
+      fprintf(stderr, "[pipeline] could not open the pipes to the aligner\n");
+      exit(1);
+  }
+  setvbuf(p->fp_in, NULL, _IOFBF, buffer_size);
+  setvbuf(p->fp_out, NULL, _IOFBF, buffer_size);
+
+  if(0 != pthread_create(&p->thread, NULL, pipeline_run, p)) {
+      fprintf(stderr, "[pipeline] could not create the reader thread\n");
+      exit(1);
+  }
+  fprintf(stderr, "[pipeline] aligning with: %s\n", cmd);
+  return p;
+}
+
+void
+pipeline_destroy(pipeline_t *p)
+{
+  struct rusage ru;
+  int status;
+  double t;
+  int32_t i;
+
+  if(NULL == p) return;
+
+  if(0 != pthread_join(p->thread, NULL)) {
+      fprintf(stderr, "[pipeline] could not join the reader thread\n");
+      exit(1);
+  }
+  fclose(p->fp_out);
+  if(wait4(p->pid, &status, 0, &ru) < 0) {
+      fprintf(stderr, "[pipeline] could not wait for the aligner\n");
+      exit(1);
+  }
+  t = writer_time() - p->t_start;
+  if(!WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
+      fprintf(stderr, "[pipeline] the aligner failed (exit status %d)\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+      exit(1);
+  }
+
+  dwgsim_eval_counts_print(p->counts, p->args.a, p->args.d, (int32_t)p->n_reads);
+  fprintf(stderr, "[pipeline] %lld alignments in %.2fs: %.1f reads/s (aligner CPU: %.2fs user, %.2fs system)\n",
+          (long long int)p->n_reads, t, (0.0 < t) ? p->n_reads / t : 0.0,
+          ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6, ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6);
+
+  for(i=0;i<p->n_targets;i++) {
+      free(p->target_name[i]);
+  }
+  free(p->target_name);
+  dwgsim_eval_counts_destroy(p->counts);
+  free(p->args.P);
+  free(p);
+}
@@ -0,0 +1,64 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "dwgsim_eval_counts.h"
+
+/* Aligns the simulated reads as they are generated, without intermediate
+ * files: the aligner command is run with /bin/sh, the reads are written to
+ * its standard input as interleaved FASTQ (see sink_attach), and the SAM it
+ * writes to its standard output is evaluated by a reader thread as it
+ * arrives, as by dwgsim_eval.  Secondary and supplementary alignments are
+ * ignored. */
+
+typedef struct {
+    pid_t pid; /* the aligner */
+    FILE *fp_in; /* its standard input, closed by the sink */
+    FILE *fp_out; /* its standard output */
+    pthread_t thread; /* reads and evaluates the SAM */
+    dwgsim_eval_args_t args;
+    dwgsim_eval_counts_t *counts;
+    int32_t n_targets, m_targets;
+    char **target_name; /* the contigs in the SAM header */
+    int64_t n_reads; /* the number of primary alignments evaluated */
+    double t_start;
+} pipeline_t;
+
+// starts the aligner command and the reader thread
+pipeline_t *
+pipeline_init(const char *cmd, int32_t data_type, int32_t is_paired, const char *read_prefix, size_t buffer_size);
+
+// waits for the aligner to finish, once its standard input is closed, and
+// prints the evaluation and the throughput
+void
+pipeline_destroy(pipeline_t *p);
+
+#endif
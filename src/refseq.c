@@ -0,0 +1,278 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <zlib.h>
+#include "dwgsim.h"
+#include "refseq.h"
+
+#define REFSEQ_BLOCK_SIZE 0x1000000 // bases, a multiple of 2048
+
+void
+refseq_init(refseq_t *r)
+{
+  memset(r, 0, sizeof(refseq_t));
+}
+
+void
+refseq_destroy(refseq_t *r)
+{
+  free(r->s);
+  free(r->n_mask);
+  free(r->run_start);
+  free(r->run_end);
+  memset(r, 0, sizeof(refseq_t));
+}
+
+// appends a base
+static inline void
+refseq_push(refseq_t *r, int c)
+{
+  int32_t w = r->l >> 5;
+  uint8_t b = nst_nt4_table[c];
+  if (r->m <= r->l) {
+      r->m += REFSEQ_BLOCK_SIZE;
+      r->s = realloc(r->s, sizeof(uint64_t) * (r->m >> 5));
+      r->n_mask = realloc(r->n_mask, sizeof(uint64_t) * (r->m >> 11));
+      if (NULL == r->s || NULL == r->n_mask) {
+          fprintf(stderr, "Error: out of memory\n");
+          exit(1);
+      }
+  }
+  if (0 == (r->l & 31)) { // new word
+      r->s[w] = 0;
+      if (0 == (w & 63)) r->n_mask[w >> 6] = 0;
+  }
+  if (b < 4) {
+      r->s[w] |= (uint64_t)b << ((r->l & 31) << 1);
+  }
+  else {
+      if (0 < r->n_runs && r->run_end[r->n_runs-1] == (uint32_t)r->l) { // extend
+          r->run_end[r->n_runs-1]++;
+      }
+      else { // new run
+          if (r->m_runs <= r->n_runs) {
+              r->m_runs = (r->m_runs < 16) ? 16 : (r->m_runs << 1);
+              r->run_start = realloc(r->run_start, sizeof(uint32_t) * r->m_runs);
+              r->run_end = realloc(r->run_end, sizeof(uint32_t) * r->m_runs);
+          }
+          r->run_start[r->n_runs] = r->l;
+          r->run_end[r->n_runs] = r->l + 1;
+          r->n_runs++;
+      }
+      r->n_mask[w >> 6] |= (uint64_t)1 << (w & 63);
+  }
+  r->l++;
+}
+
+void
+refseq_alloc(refseq_t *r, int32_t l)
+{
+  int32_t m = ((l / REFSEQ_PACK_ALIGN) + 1) * REFSEQ_PACK_ALIGN;
+  if (r->m < m) {
+      r->m = m;
+      r->s = realloc(r->s, sizeof(uint64_t) * (r->m >> 5));
+      r->n_mask = realloc(r->n_mask, sizeof(uint64_t) * (r->m >> 11));
+      if (NULL == r->s || NULL == r->n_mask) {
+          fprintf(stderr, "Error: out of memory\n");
+          exit(1);
+      }
+  }
+  memset(r->s, 0, sizeof(uint64_t) * ((l + 31) >> 5));
+  memset(r->n_mask, 0, sizeof(uint64_t) * ((l + 2047) >> 11));
+  r->l = l; r->n_runs = 0;
+}
+
+void
+refseq_pack(refseq_t *r, int32_t start, const char *s, int32_t n, refseq_runs_t *runs)
+{
+  int32_t i, p;
+  uint8_t b;
+  for (i = 0, p = start; i < n; i++, p++) {
+      b = nst_nt4_table[(uint8_t)s[i]];
+      if (b < 4) {
+          r->s[p >> 5] |= (uint64_t)b << ((p & 31) << 1);
+          continue;
+      }
+      if (0 < runs->n && runs->end[runs->n-1] == (uint32_t)p) { // extend
+          runs->end[runs->n-1]++;
+      }
+      else { // new run
+          if (runs->m <= runs->n) {
+              runs->m = (runs->m < 16) ? 16 : (runs->m << 1);
+              runs->start = realloc(runs->start, sizeof(uint32_t) * runs->m);
+              runs->end = realloc(runs->end, sizeof(uint32_t) * runs->m);
+          }
+          runs->start[runs->n] = p;
+          runs->end[runs->n] = p + 1;
+          runs->n++;
+      }
+      r->n_mask[p >> 11] |= (uint64_t)1 << ((p >> 5) & 63);
+  }
+}
+
+void
+refseq_add_runs(refseq_t *r, const refseq_runs_t *runs)
+{
+  int32_t i;
+  uint32_t w;
+  for (i = 0; i < runs->n; i++) {
+      for (w = runs->start[i] >> 5; w <= (runs->end[i] - 1) >> 5; w++) {
+          r->n_mask[w >> 6] |= (uint64_t)1 << (w & 63);
+      }
+      if (0 < r->n_runs && r->run_end[r->n_runs-1] == runs->start[i]) { // merge
+          r->run_end[r->n_runs-1] = runs->end[i];
+          continue;
+      }
+      if (r->m_runs <= r->n_runs) {
+          r->m_runs = (r->m_runs < 16) ? 16 : (r->m_runs << 1);
+          r->run_start = realloc(r->run_start, sizeof(uint32_t) * r->m_runs);
+          r->run_end = realloc(r->run_end, sizeof(uint32_t) * r->m_runs);
+      }
+      r->run_start[r->n_runs] = runs->start[i];
+      r->run_end[r->n_runs] = runs->end[i];
+      r->n_runs++;
+  }
+}
+
+int32_t
+refseq_read_fasta(gzFile fp, refseq_t *r, char *locus, char *comment)
+{
+  int c;
+  char *p;
+
+  c = 0;
+  while (!gzeof(fp) && gzgetc(fp) != '>');
+  if (gzeof(fp)) return -1;
+  p = locus;
+  while (!gzeof(fp) && (c = gzgetc(fp)) != ' ' && c != '\t' && c != '\n')
+    if (c != '\r') *p++ = c;
+  *p = '\0';
+  if (comment) {
+      p = comment;
+      if (c != '\n') {
+          while (!gzeof(fp) && ((c = gzgetc(fp)) == ' ' || c == '\t'));
+          if (c != '\n') {
+              *p++ = c;
+              while (!gzeof(fp) && (c = gzgetc(fp)) != '\n')
+                if (c != '\r') *p++ = c;
+          }
+      }
+      *p = '\0';
+  } else if (c != '\n') while (!gzeof(fp) && gzgetc(fp) != '\n');
+  r->l = 0; r->n_runs = 0;
+  while (!gzeof(fp) && (c = gzgetc(fp)) != '>') {
+      if (isalpha(c) || c == '-' || c == '.') {
+          refseq_push(r, c);
+      }
+  }
+  if (c == '>') gzungetc(c, fp);
+  return r->l;
+}
+
+// the index of the first run ending after position i
+static int32_t
+refseq_run_lower_bound(const refseq_t *r, int32_t i)
+{
+  int32_t low = 0, high = r->n_runs, mid;
+  while (low < high) {
+      mid = low + ((high - low) >> 1);
+      if (r->run_end[mid] <= (uint32_t)i) low = mid + 1;
+      else high = mid;
+  }
+  return low;
+}
+
+int32_t
+refseq_in_run(const refseq_t *r, int32_t i)
+{
+  int32_t k = refseq_run_lower_bound(r, i);
+  return (k < r->n_runs && r->run_start[k] <= (uint32_t)i) ? 1 : 0;
+}
+
+int32_t
+refseq_count_n(const refseq_t *r, int32_t start, int32_t end)
+{
+  int32_t k, i, j, n = 0;
+  if (0 == r->n_runs) return 0;
+  if (start < 0) start = 0;
+  for (k = refseq_run_lower_bound(r, start); k < r->n_runs && r->run_start[k] < (uint32_t)end; k++) {
+      i = (r->run_start[k] < (uint32_t)start) ? start : (int32_t)r->run_start[k];
+      j = (r->run_end[k] < (uint32_t)end) ? (int32_t)r->run_end[k] : end;
+      n += j - i;
+  }
+  return n;
+}
+
+int64_t
+refseq_n_bases(const refseq_t *r)
+{
+  int32_t k;
+  int64_t n = 0;
+  for (k = 0; k < r->n_runs; k++) {
+      n += r->run_end[k] - r->run_start[k];
+  }
+  return n;
+}
+
+void
+refseq_extract(const refseq_t *r, int32_t start, int32_t len, uint8_t *out)
+{
+  int32_t i, j, n, k, end = start + len;
+  uint64_t w;
+  // copy a word at a time
+  for (i = start; i < end; i += n) {
+      w = r->s[i >> 5] >> ((i & 31) << 1);
+      n = 32 - (i & 31);
+      if (end - i < n) n = end - i;
+      for (j = 0; j < n; j++, w >>= 2) {
+          *out++ = (uint8_t)(w & 3);
+      }
+  }
+  out -= len;
+  // then the N runs
+  for (k = refseq_run_lower_bound(r, start); k < r->n_runs && r->run_start[k] < (uint32_t)end; k++) {
+      i = (r->run_start[k] < (uint32_t)start) ? start : (int32_t)r->run_start[k];
+      j = (r->run_end[k] < (uint32_t)end) ? (int32_t)r->run_end[k] : end;
+      memset(out + i - start, 4, j - i);
+  }
+}
+
+void
+refseq_extract_rc(const refseq_t *r, int32_t start, int32_t len, uint8_t *out)
+{
+  int32_t i, j;
+  uint8_t t;
+  refseq_extract(r, start, len, out);
+  for (i = 0, j = len - 1; i <= j; i++, j--) {
+      t = out[i];
+      out[i] = (out[j] < 4) ? 3 - out[j] : 4;
+      out[j] = (t < 4) ? 3 - t : 4;
+  }
+}
@@ -0,0 +1,107 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef REFSEQ_H
+#define REFSEQ_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+
+/* A reference sequence packed at 2 bits per base (A=0, C=1, G=2, T=3,
+ * 32 bases per word).  Bases other than ACGT are kept as runs in a side
+ * table and read back as N (4).  One bit per packed word marks the words
+ * that overlap a run, so the common case never searches the table. */
+typedef struct {
+    int32_t l, m; /* length and maximum buffer size (bases) */
+    uint64_t *s; /* packed bases */
+    uint64_t *n_mask; /* one bit per packed word: does it overlap an N run? */
+    int32_t n_runs, m_runs; /* number of N runs and maximum buffer size */
+    uint32_t *run_start, *run_end; /* N runs [start,end), in increasing order */
+} refseq_t;
+
+#define REFSEQ_PACK_ALIGN 2048 // bases per word of n_mask
+
+/* N runs found while packing part of a sequence */
+typedef struct {
+    int32_t n, m; /* number of runs and maximum buffer size */
+    uint32_t *start, *end; /* [start,end) */
+} refseq_runs_t;
+
+void
+refseq_init(refseq_t *r);
+
+void
+refseq_destroy(refseq_t *r);
+
+// reads the next FASTA record (plain or gzip-compressed) into "r", returning
+// its length, or -1 at the end of the file
+int32_t
+refseq_read_fasta(gzFile fp, refseq_t *r, char *locus, char *comment);
+
+// sets the length to l with all bases unset, ready for refseq_pack
+void
+refseq_alloc(refseq_t *r, int32_t l);
+
+// packs the n bases in "s" at position "start", adding N runs to "runs";
+// threads may pack in parallel as long as each packs whole blocks of
+// REFSEQ_PACK_ALIGN bases
+void
+refseq_pack(refseq_t *r, int32_t start, const char *s, int32_t n, refseq_runs_t *runs);
+
+// appends N runs (and marks them in n_mask) after those already stored,
+// which must come before them
+void
+refseq_add_runs(refseq_t *r, const refseq_runs_t *runs);
+
+// is position i in an N run?
+int32_t
+refseq_in_run(const refseq_t *r, int32_t i);
+
+// the number of Ns in [start,end)
+int32_t
+refseq_count_n(const refseq_t *r, int32_t start, int32_t end);
+
+// the number of Ns
+int64_t
+refseq_n_bases(const refseq_t *r);
+
+// the bases [start,start+len), as 0-4
+void
+refseq_extract(const refseq_t *r, int32_t start, int32_t len, uint8_t *out);
+
+// the reverse complement of the bases [start,start+len), as 0-4
+void
+refseq_extract_rc(const refseq_t *r, int32_t start, int32_t len, uint8_t *out);
+
+// the base at position i, as 0-4
+static inline uint8_t
+refseq_get(const refseq_t *r, int32_t i)
+{
+  if (((r->n_mask[i >> 11] >> ((i >> 5) & 63)) & 1) && refseq_in_run(r, i)) return 4;
+  return (uint8_t)((r->s[i >> 5] >> ((i & 31) << 1)) & 3);
+}
+
+#endif
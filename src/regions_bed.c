@@ -35,12 +35,36 @@
 #include "contigs.h"
 #include "regions_bed.h"
 
-regions_bed_txt *regions_bed_init(FILE *fp, contigs_t *c)
+// reads the rest of the line into "line" (truncated to "n" bytes), returning
+// the weight in its second field (the BED score column), or -1 if there is
+// none
+static double
+regions_bed_weight(FILE *fp, char *line, int32_t n)
+{
+  int32_t b, l = 0;
+  char *p, *q;
+  double w;
+
+  while(EOF != (b = fgetc(fp))) {
+      if('\n' == b || '\r' == b) break;
+      if(l < n - 1) line[l++] = b;
+  }
+  line[l] = '\0';
+  // skip the name field
+  if('\t' != line[0] || NULL == (p = strchr(line + 1, '\t'))) return -1;
+  w = strtod(p + 1, &q);
+  if(q == p + 1 || ('\0' != *q && '\t' != *q)) return -1;
+  return w;
+}
+
+regions_bed_txt *regions_bed_init(FILE *fp, contigs_t *c, int32_t use_weights)
 {
   regions_bed_txt *r = NULL;
-  char name[1024];
+  char name[1024], line[1024];
   uint32_t start, end, len;
   int32_t i, prev_contig, prev_start, prev_end, b;
+  uint32_t k;
+  double weight = 1.0;
 
   r = calloc(1, sizeof(regions_bed_txt));
   r->n = 0;
@@ -48,6 +72,7 @@ regions_bed_txt *regions_bed_init(FILE *fp, contigs_t *c)
   r->contig = malloc(r->mem * sizeof(uint32_t));
   r->start = malloc(r->mem * sizeof(uint32_t));
   r->end = malloc(r->mem * sizeof(uint32_t));
+  if(1 == use_weights) r->weight = malloc(r->mem * sizeof(double));
   
   i = 0;
   prev_contig = prev_start = prev_end = -1;
@@ -81,12 +106,23 @@ regions_bed_txt *regions_bed_init(FILE *fp, contigs_t *c)
       if(end - start + 1 != len) {
           fprintf(stderr, "Warning: len != end - start + 1 [%s,%u,%u,%u]\n", name, start, end, len);
       }
+
+      if(1 == use_weights) {
+          weight = regions_bed_weight(fp, line, sizeof(line));
+          if(weight < 0 || !(weight < HUGE_VAL)) {
+              fprintf(stderr, "Error: the score column is missing or negative [%s,%u,%u]\n", name, start, end);
+              exit(1);
+          }
+      }
       
       if(prev_contig == i && start <= prev_end && prev_start <= start) {
           if(prev_end < end) {
               r->end[r->n-1] = end;
               prev_end = end;
           }
+          if(1 == use_weights && r->weight[r->n-1] < weight) {
+              r->weight[r->n-1] = weight;
+          }
       }
       else {
           prev_contig = i;
@@ -97,17 +133,39 @@ regions_bed_txt *regions_bed_init(FILE *fp, contigs_t *c)
               r->contig = realloc(r->contig, r->mem * sizeof(uint32_t));
               r->start = realloc(r->start, r->mem * sizeof(uint32_t));
               r->end = realloc(r->end, r->mem * sizeof(uint32_t));
+              if(1 == use_weights) r->weight = realloc(r->weight, r->mem * sizeof(double));
           }
           r->contig[r->n] = i;
           r->start[r->n] = start;
           r->end[r->n] = end;
+          if(1 == use_weights) r->weight[r->n] = weight;
           r->n++;
       }
-      // move to the end of the line
-      while(EOF != (b = fgetc(fp))) {
-          if('\n' == b || '\r' == b) break;
+      if(0 == use_weights) {
+          // move to the end of the line
+          while(EOF != (b = fgetc(fp))) {
+              if('\n' == b || '\r' == b) break;
+          }
       }
   }
+
+  // the prefix sums, and the regions of each contig
+  r->cum_len = malloc((r->n + 1) * sizeof(uint64_t));
+  r->cum_len[0] = 0;
+  if(1 == use_weights) {
+      r->cum_mass = malloc((r->n + 1) * sizeof(double));
+      r->cum_mass[0] = 0;
+  }
+  for(k=0;k<r->n;k++) {
+      r->cum_len[k+1] = r->cum_len[k] + (r->end[k] - r->start[k] + 1);
+      if(1 == use_weights) r->cum_mass[k+1] = r->cum_mass[k] + r->weight[k] * (r->end[k] - r->start[k] + 1);
+  }
+  r->n_contigs = c->n;
+  r->first = malloc((r->n_contigs + 1) * sizeof(uint32_t));
+  for(i=0,k=0;i<=r->n_contigs;i++) {
+      while(k < r->n && r->contig[k] < (uint32_t)i) k++;
+      r->first[i] = k;
+  }
   return r;
 }
 
@@ -116,9 +174,27 @@ void regions_bed_destroy(regions_bed_txt *r)
   free(r->contig);
   free(r->start);
   free(r->end);
+  free(r->weight);
+  free(r->cum_len);
+  free(r->cum_mass);
+  free(r->first);
   free(r);
 }
 
+long double
+regions_bed_mass(const regions_bed_txt *r, uint32_t contig)
+{
+  if(NULL == r->cum_mass) return regions_bed_len(r, contig);
+  return (long double)r->cum_mass[r->first[contig+1]] - r->cum_mass[r->first[contig]];
+}
+
+long double
+regions_bed_tot_mass(const regions_bed_txt *r)
+{
+  if(NULL == r->cum_mass) return r->cum_len[r->n];
+  return r->cum_mass[r->n];
+}
+
 int32_t regions_bed_query(regions_bed_txt *r, uint32_t contig, uint32_t start, uint32_t end) 
 {
   int32_t low, high, mid;
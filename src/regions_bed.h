@@ -1,16 +1,27 @@
 #ifndef REGIONS_BED_H
 #define REGIONS_BED_H
 
+/* The regions to cover (-x), sorted and merged, with the prefix sums of
+ * their lengths (and of their weighted lengths).  With weights, each region
+ * is sampled in proportion to its length times its weight, the BED score
+ * (fifth) column; overlapping regions are merged with the larger weight.
+ * Fragments are placed within them by frag_sample. */
+
 typedef struct {
     uint32_t *contig;
     uint32_t *start;
     uint32_t *end;
+    double *weight; /* NULL if unweighted */
+    uint64_t *cum_len; /* the total length of the regions before each, n + 1 */
+    double *cum_mass; /* the total weighted length before each, n + 1; NULL if unweighted */
+    uint32_t *first; /* the first region of each contig, n_contigs + 1 */
+    int32_t n_contigs;
     uint32_t n;
     uint32_t mem;
 } regions_bed_txt;
 
 regions_bed_txt *
-regions_bed_init(FILE *fp, contigs_t *c);
+regions_bed_init(FILE *fp, contigs_t *c, int32_t use_weights);
 
 void 
 regions_bed_destroy(regions_bed_txt *r);
@@ -18,4 +29,16 @@ regions_bed_destroy(regions_bed_txt *r);
 int32_t 
 regions_bed_query(regions_bed_txt *r, uint32_t contig, uint32_t start, uint32_t end); 
 
+// the total length of the regions of the contig
+#define regions_bed_len(_r, _contig) ((_r)->cum_len[(_r)->first[(_contig)+1]] - (_r)->cum_len[(_r)->first[(_contig)]])
+
+// the total weighted length of the regions of the contig (the length if
+// unweighted)
+long double
+regions_bed_mass(const regions_bed_txt *r, uint32_t contig);
+
+// the total weighted length of all regions
+long double
+regions_bed_tot_mass(const regions_bed_txt *r);
+
 #endif
@@ -0,0 +1,177 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "dwgsim.h"
+#include "contigs.h"
+#include "sink.h"
+#include "store.h"
+#include "writer.h"
+#include "replay.h"
+
+typedef struct {
+    sink_t *sink;
+    sink_buf_t out;
+} replay_block_t;
+
+static int
+replay_usage(int32_t sinks, int32_t compress_level, int32_t writer_depth, int32_t buffer_size)
+{
+  char str[128];
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Usage:   dwgsim replay [options] <in.store> <out.prefix>\n\n");
+  fprintf(stderr, "Writes the reads of a read store (dwgsim -o store) without simulating them again.\n\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "         -o STRING     the comma-separated output formats, as dwgsim, except truth and truthsam [%s]\n", sink_mask_str(sinks, str));
+  fprintf(stderr, "         -T            name the reads by number, writing their truth to a binary sidecar (.truth.bin)\n");
+  fprintf(stderr, "         -k INT        split the output into chunks of at most this many read pairs (0 for no limit) [0]\n");
+  fprintf(stderr, "         -K INT        split the output into chunks of at most about this many MiB per file (0 for no limit) [0]\n");
+  fprintf(stderr, "         -Z INT        write BGZF-compressed FASTQ (.fastq.gz) at this level (0-9, -1 to disable) [%d]\n", compress_level);
+  fprintf(stderr, "         -w INT        blocks of reads queued for the writer thread (0 writes from the main thread) [%d]\n", writer_depth);
+  fprintf(stderr, "         -W INT        the buffer size of each output file in KiB [%d]\n", buffer_size);
+  fprintf(stderr, "         -h            print this message\n");
+  fprintf(stderr, "\n");
+  return 1;
+}
+
+static void
+replay_write(void *arg)
+{
+  replay_block_t *b = (replay_block_t*)arg;
+  sink_buf_close(b->sink, &b->out);
+  sink_buf_write(b->sink, &b->out);
+}
+
+int
+replay_main(int argc, char *argv[])
+{
+  int32_t sinks = SINK_DEFAULT, compress_level = -1, writer_depth = 2, buffer_size = 1024, chunk_reads = 0, chunk_size = 0, compact_names = 0;
+  int32_t i, j, n, n_blocks, has_pair, len[2] = {0, 0}, m[2] = {0, 0};
+  uint8_t *seq[2] = {NULL, NULL};
+  char *qstr[2] = {NULL, NULL};
+  uint64_t n_pairs = 0, block_i = 0;
+  replay_block_t *blocks = NULL, *b;
+  store_t *store = NULL;
+  contigs_t *contigs = NULL;
+  sink_t *sink = NULL;
+  writer_t *writer = NULL;
+  sink_pair_t pair;
+  double t;
+  int c;
+
+  while((c = getopt(argc, argv, "o:Tk:K:Z:w:W:h")) >= 0) {
+      switch(c) {
+        case 'o':
+                  sinks = sink_parse(optarg);
+                  if(sinks < 0) {
+                      fprintf(stderr, "Unrecognized output format: %s\n", optarg);
+                      return replay_usage(SINK_DEFAULT, compress_level, writer_depth, buffer_size);
+                  }
+                  break;
+        case 'T': compact_names = 1; break;
+        case 'k': chunk_reads = atoi(optarg); break;
+        case 'K': chunk_size = atoi(optarg); break;
+        case 'Z': compress_level = atoi(optarg); break;
+        case 'w': writer_depth = atoi(optarg); break;
+        case 'W': buffer_size = atoi(optarg); break;
+        case 'h':
+        default: return replay_usage(sinks, compress_level, writer_depth, buffer_size);
+      }
+  }
+  if(argc - optind < 2) {
+      return replay_usage(sinks, compress_level, writer_depth, buffer_size);
+  }
+  if(1 == compact_names) sinks |= (1 << SINK_SIDECAR);
+  if(0 != (sinks & ((1 << SINK_TRUTH) | (1 << SINK_TRUTH_SAM) | (1 << SINK_STORE)))) {
+      fprintf(stderr, "Error: the truth and store sinks cannot be replayed\n");
+      return 1;
+  }
+  if(compress_level < -1 || 9 < compress_level || writer_depth < 0 || 64 < writer_depth
+     || buffer_size < 1 || chunk_reads < 0 || chunk_size < 0) {
+      fprintf(stderr, "Error: an option is out of range\n");
+      return replay_usage(sinks, compress_level, writer_depth, buffer_size);
+  }
+
+  store = store_open(argv[optind]);
+  contigs = contigs_init();
+  for(i=0;i<store->header->n_contigs;i++) {
+      contigs_add(contigs, store->names[i], 0);
+  }
+  sink = sink_init(argv[optind+1], sinks, store->header->data_type, store->header->is_paired, compress_level, store->read_prefix,
+                   (size_t)buffer_size << 10, chunk_reads, (int64_t)chunk_size << 20);
+  sink_set_contigs(sink, contigs);
+  contigs_destroy(contigs);
+
+  // one block being decoded, and up to the writer depth being written
+  n_blocks = writer_depth + 1;
+  blocks = calloc(n_blocks, sizeof(replay_block_t));
+  for(i=0;i<n_blocks;i++) {
+      blocks[i].sink = sink;
+      sink_buf_init(&blocks[i].out);
+  }
+  writer = writer_init(writer_depth);
+
+  t = writer_time();
+  has_pair = store_next(store, &pair, seq, qstr, len, m);
+  while(1 == has_pair) {
+      // the writer is done with this block (see writer_push)
+      b = &blocks[block_i % n_blocks];
+      sink_buf_open(&b->out);
+      // the same blocks as the simulation, so compressed output is identical
+      n = 0;
+      do {
+          for(j=0;j<1+store->header->is_paired;j++) {
+              sink_put(sink, &b->out, &pair, j, seq[j], qstr[j], len[j]);
+          }
+          sink_buf_next(sink, &b->out);
+          n++;
+          has_pair = store_next(store, &pair, seq, qstr, len, m);
+      } while(1 == has_pair && 0 == store->block_start && n < DWGSIM_BLOCK_SIZE);
+      writer_push(writer, replay_write, b);
+      block_i++;
+      n_pairs += n;
+      if(0 == (block_i & 63)) fprintf(stderr, "\r[replay] %llu", (unsigned long long int)n_pairs);
+  }
+  writer_sync(writer);
+  writer_destroy(writer);
+  sink_destroy(sink);
+  t = writer_time() - t;
+  fprintf(stderr, "\r[replay] %llu read pairs in %.2fs (%.1f read pairs/s)\n", (unsigned long long int)n_pairs, t, (0.0 < t) ? n_pairs / t : 0.0);
+
+  for(i=0;i<n_blocks;i++) {
+      sink_buf_destroy(&blocks[i].out);
+  }
+  free(blocks);
+  for(j=0;j<2;j++) {
+      free(seq[j]);
+      free(qstr[j]);
+  }
+  store_close(store);
+  return 0;
+}
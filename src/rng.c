@@ -0,0 +1,279 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+static inline uint64_t 
+rng_splitmix64(uint64_t *x)
+{
+  uint64_t z = ((*x) += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Philox4x32 with ten rounds
+static inline void
+rng_philox(const uint32_t key[2], const uint32_t ctr[4], uint32_t out[4])
+{
+  int32_t i;
+  uint32_t k0 = key[0], k1 = key[1];
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  for(i=0;i<10;i++) {
+      uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+      uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+      c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+      c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t)p1;
+      c3 = (uint32_t)p0;
+      k0 += PHILOX_W0; k1 += PHILOX_W1;
+  }
+  out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+void
+rng_init(rng_t *r, int32_t seed, int32_t contig, int32_t purpose, uint64_t index)
+{
+  uint64_t x, k;
+  x = (uint64_t)(uint32_t)seed;
+  k = rng_splitmix64(&x);
+  x ^= (uint64_t)(uint32_t)contig;
+  k ^= rng_splitmix64(&x);
+  r->key[0] = (uint32_t)k; r->key[1] = (uint32_t)(k >> 32);
+  r->ctr[0] = r->ctr[1] = 0;
+  // 48 bits of index, 16 bits of purpose
+  r->ctr[2] = (uint32_t)index;
+  r->ctr[3] = ((uint32_t)(index >> 32) & 0xFFFF) | ((uint32_t)purpose << 16);
+  r->buf_i = 4; // empty
+}
+
+void
+rng_refill(rng_t *r)
+{
+  rng_philox(r->key, r->ctr, r->buf);
+  if(0 == ++r->ctr[0]) ++r->ctr[1];
+  r->buf_i = 0;
+}
+
+void
+rng_skip(rng_t *r, uint64_t n)
+{
+  uint64_t pos;
+  if(0 == n) return;
+  // the absolute position of the next word; the buffer holds block ctr-1
+  pos = ((((uint64_t)r->ctr[1] << 32) | r->ctr[0]) << 2) + r->buf_i - 4 + n;
+  r->ctr[0] = (uint32_t)(pos >> 2); r->ctr[1] = (uint32_t)(pos >> 34);
+  rng_refill(r);
+  r->buf_i = (int32_t)(pos & 3);
+}
+
+void
+rng_uniforms(rng_t *r, double *x, int32_t n)
+{
+  int32_t i = 0;
+  uint32_t a;
+  // the whole uniforms left in the current block
+  while(i < n && r->buf_i <= 2) x[i++] = rng_uniform(r);
+  // then two per block, straight from its four words
+  if(3 == r->buf_i) { // one word left: each block starts with its second half
+      while(i + 2 <= n) {
+          a = r->buf[3];
+          rng_refill(r);
+          x[i++] = rng_uniform_words(a, r->buf[0]);
+          x[i++] = rng_uniform_words(r->buf[1], r->buf[2]);
+          r->buf_i = 3;
+      }
+  }
+  else {
+      while(i + 2 <= n) {
+          rng_refill(r);
+          x[i++] = rng_uniform_words(r->buf[0], r->buf[1]);
+          x[i++] = rng_uniform_words(r->buf[2], r->buf[3]);
+          r->buf_i = 4;
+      }
+  }
+  if(i < n) x[i] = rng_uniform(r);
+}
+
+void
+rng_bases(rng_t *r, uint8_t *b, int32_t n)
+{
+  int32_t i, j;
+  uint32_t w;
+  for(i=0;i+16<=n;i+=16) {
+      w = rng_next32(r);
+      for(j=0;j<16;j++,w>>=2) {
+          b[i+j] = w & 3;
+      }
+  }
+  if(i < n) {
+      w = rng_next32(r);
+      for(;i<n;i++,w>>=2) {
+          b[i] = w & 3;
+      }
+  }
+}
+
+/* Ziggurat normal sampler with 128 layers, from Marsaglia and Tsang, "The
+ * Ziggurat Method for Generating Random Variables", J. Stat. Soft. 2000.
+ * The tables are read-only once initialized, and all state is in the
+ * stream, so it is reentrant. */
+
+#define RNG_ZIG_R 3.442619855899
+
+static uint32_t rng_zig_k[128];
+static double rng_zig_w[128], rng_zig_f[128];
+static int32_t rng_zig_init = 0;
+
+void
+rng_normal_init()
+{
+  const double m1 = 2147483648.0, vn = 9.91256303526217e-3;
+  double dn = RNG_ZIG_R, tn = dn, q;
+  int32_t i;
+
+  if(1 == rng_zig_init) return;
+  q = vn / exp(-0.5 * dn * dn);
+  rng_zig_k[0] = (uint32_t)((dn / q) * m1);
+  rng_zig_k[1] = 0;
+  rng_zig_w[0] = q / m1;
+  rng_zig_w[127] = dn / m1;
+  rng_zig_f[0] = 1.0;
+  rng_zig_f[127] = exp(-0.5 * dn * dn);
+  for(i=126;1<=i;i--) {
+      dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+      rng_zig_k[i+1] = (uint32_t)((dn / tn) * m1);
+      tn = dn;
+      rng_zig_f[i] = exp(-0.5 * dn * dn);
+      rng_zig_w[i] = dn / m1;
+  }
+  rng_zig_init = 1;
+}
+
+// a uniform in (0,1], safe for log()
+static inline double
+rng_uniform_pos(rng_t *r)
+{
+  return 1.0 - rng_uniform(r);
+}
+
+uint64_t
+rng_geometric(rng_t *r, double p)
+{
+  double g;
+  if(1.0 <= p) return 0;
+  if(p <= 0.0) return UINT64_MAX;
+  g = floor(log(rng_uniform_pos(r)) / log1p(-p));
+  return (g < 1.8e19) ? (uint64_t)g : UINT64_MAX;
+}
+
+double
+rng_normal(rng_t *r)
+{
+  int32_t hz;
+  uint32_t iz, uz;
+  double x, y;
+
+  assert(1 == rng_zig_init);
+  while(1) {
+      hz = (int32_t)rng_next32(r);
+      // the layer from its own word, so it is independent of the value
+      iz = rng_next32(r) & 127;
+      uz = (0 <= hz) ? (uint32_t)hz : 0U - (uint32_t)hz; // |hz|, defined for INT32_MIN
+      if(uz < rng_zig_k[iz]) { // inside the layer, ~99% of the time
+          return hz * rng_zig_w[iz];
+      }
+      x = hz * rng_zig_w[iz];
+      if(0 == iz) { // the base strip: sample from the tail
+          do {
+              x = -log(rng_uniform_pos(r)) / RNG_ZIG_R;
+              y = -log(rng_uniform_pos(r));
+          } while(y + y < x * x);
+          return (0 < hz) ? RNG_ZIG_R + x : -RNG_ZIG_R - x;
+      }
+      // the wedge
+      if(rng_zig_f[iz] + rng_uniform(r) * (rng_zig_f[iz-1] - rng_zig_f[iz]) < exp(-0.5 * x * x)) {
+          return x;
+      }
+  }
+}
+
+// a standard normal conditioned to lie in [a, b) with 0 <= a, using
+// Robert's exponential or uniform proposals (Stat. Comp. 1995)
+static double
+rng_truncated_normal_tail(rng_t *r, double a, double b)
+{
+  double z, alpha;
+  if(b - a < 2.0 / (a + sqrt(a * a + 4.0))) { // narrow: uniform proposal
+      do {
+          z = a + (b - a) * rng_uniform(r);
+      } while(log(rng_uniform_pos(r)) > 0.5 * (a * a - z * z));
+  }
+  else { // exponential proposal
+      alpha = 0.5 * (a + sqrt(a * a + 4.0));
+      do {
+          z = a - log(rng_uniform_pos(r)) / alpha;
+      } while(b <= z || log(rng_uniform_pos(r)) > -0.5 * (z - alpha) * (z - alpha));
+  }
+  return z;
+}
+
+double
+rng_truncated_normal(rng_t *r, double mu, double sigma, double lo, double hi)
+{
+  double a, b, z;
+
+  if(hi <= lo) return lo;
+  if(sigma <= 0) return (mu < lo) ? lo : ((hi <= mu) ? lo : mu);
+  a = (lo - mu) / sigma;
+  b = (hi - mu) / sigma;
+  if(0 <= a) {
+      z = rng_truncated_normal_tail(r, a, b);
+  }
+  else if(b <= 0) {
+      z = -rng_truncated_normal_tail(r, -b, -a);
+  }
+  else if(b - a < 0.5) { // narrow and about the mean: uniform proposal
+      do {
+          z = a + (b - a) * rng_uniform(r);
+      } while(log(rng_uniform_pos(r)) > -0.5 * z * z);
+  }
+  else { // most of the mass: plain rejection
+      do {
+          z = rng_normal(r);
+      } while(z < a || b <= z);
+  }
+  return mu + sigma * z;
+}
@@ -0,0 +1,107 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* Counter-based random number generator (Philox4x32-10).  Each stream is
+ * keyed by the random seed and the contig, and the counter holds the
+ * purpose, the index (ex. read id) and the position within the stream, so
+ * streams are independent and jumping ahead is O(1). */
+
+// the purpose of a stream
+enum {
+    RNG_MUTATIONS = 0,
+    RNG_READS = 1,
+    RNG_ERROR_CALIBRATION = 2
+};
+
+typedef struct {
+    uint32_t key[2];
+    uint32_t ctr[4]; // position (0-1), index and purpose (2-3)
+    uint32_t buf[4]; // the current output block
+    int32_t buf_i; // the next unused word in buf
+} rng_t;
+
+void
+rng_init(rng_t *r, int32_t seed, int32_t contig, int32_t purpose, uint64_t index);
+
+void
+rng_refill(rng_t *r);
+
+// skip the next n 32-bit words
+void
+rng_skip(rng_t *r, uint64_t n);
+
+// n uniforms in [0,1), the same as n calls to rng_uniform, two per block
+void
+rng_uniforms(rng_t *r, double *x, int32_t n);
+
+// n random bases (0-3), sixteen per 32-bit word
+void
+rng_bases(rng_t *r, uint8_t *b, int32_t n);
+
+// initialize the ziggurat tables; call once before simulating
+void
+rng_normal_init();
+
+// a standard normal deviate (ziggurat method)
+double
+rng_normal(rng_t *r);
+
+// a normal deviate with mean mu and standard deviation sigma conditioned
+// to lie in [lo, hi); no draws are rejected outright, even in the tails
+double
+rng_truncated_normal(rng_t *r, double mu, double sigma, double lo, double hi);
+
+// the number of failures before the first success in Bernoulli trials with
+// success probability p; UINT64_MAX if p is zero
+uint64_t
+rng_geometric(rng_t *r, double p);
+
+static inline uint32_t
+rng_next32(rng_t *r)
+{
+  if(4 <= r->buf_i) rng_refill(r);
+  return r->buf[r->buf_i++];
+}
+
+// a uniform in [0,1) with 53 bits of precision from two words
+static inline double
+rng_uniform_words(uint32_t a, uint32_t b)
+{
+  return ((a >> 5) * 67108864.0 + (b >> 6)) * (1.0 / 9007199254740992.0);
+}
+
+static inline double
+rng_uniform(rng_t *r)
+{
+  uint32_t a = rng_next32(r), b = rng_next32(r);
+  return rng_uniform_words(a, b);
+}
+
+#endif
@@ -0,0 +1,130 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sidecar.h"
+
+int32_t
+sidecar_begin(FILE *fp)
+{
+  sidecar_header_t h;
+  memset(&h, 0, sizeof(sidecar_header_t));
+  memcpy(h.magic, SIDECAR_MAGIC, 4);
+  h.rec_size = sizeof(sidecar_rec_t);
+  return (1 == fwrite(&h, sizeof(sidecar_header_t), 1, fp)) ? 1 : 0;
+}
+
+int32_t
+sidecar_end(FILE *fp, char **names, int32_t n_contigs)
+{
+  sidecar_header_t h;
+  long offset;
+  int32_t i;
+
+  offset = ftell(fp);
+  if(offset < 0) return 0;
+  memset(&h, 0, sizeof(sidecar_header_t));
+  memcpy(h.magic, SIDECAR_MAGIC, 4);
+  h.rec_size = sizeof(sidecar_rec_t);
+  h.n = (offset - sizeof(sidecar_header_t)) / sizeof(sidecar_rec_t);
+  h.names_offset = offset;
+  h.n_contigs = n_contigs;
+  for(i=0;i<n_contigs;i++) {
+      if(1 != fwrite(names[i], strlen(names[i]) + 1, 1, fp)) return 0;
+  }
+  if(0 != fseek(fp, 0, SEEK_SET) || 1 != fwrite(&h, sizeof(sidecar_header_t), 1, fp)) return 0;
+  return 1;
+}
+
+sidecar_t *
+sidecar_open(const char *fn)
+{
+  sidecar_t *s = NULL;
+  struct stat st;
+  const char *p, *end;
+  int32_t i;
+  int fd;
+
+  fd = open(fn, O_RDONLY);
+  if(fd < 0 || 0 != fstat(fd, &st)) {
+      fprintf(stderr, "[sidecar] could not open %s\n", fn);
+      exit(1);
+  }
+  s = calloc(1, sizeof(sidecar_t));
+  s->size = st.st_size;
+  if(s->size < sizeof(sidecar_header_t)) {
+      fprintf(stderr, "[sidecar] %s is not a truth sidecar\n", fn);
+      exit(1);
+  }
+  s->data = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(MAP_FAILED == s->data) {
+      fprintf(stderr, "[sidecar] could not map %s\n", fn);
+      exit(1);
+  }
+  s->header = (const sidecar_header_t*)s->data;
+  if(0 != memcmp(s->header->magic, SIDECAR_MAGIC, 4) || sizeof(sidecar_rec_t) != s->header->rec_size
+     || s->size < s->header->names_offset
+     || s->header->names_offset != sizeof(sidecar_header_t) + s->header->n * sizeof(sidecar_rec_t)) {
+      fprintf(stderr, "[sidecar] %s is not a truth sidecar, or is incomplete\n", fn);
+      exit(1);
+  }
+  s->recs = (const sidecar_rec_t*)(s->data + sizeof(sidecar_header_t));
+
+  // the contig names
+  s->names = calloc((0 < s->header->n_contigs) ? s->header->n_contigs : 1, sizeof(char*));
+  p = (const char*)s->data + s->header->names_offset;
+  end = (const char*)s->data + s->size;
+  for(i=0;i<s->header->n_contigs;i++) {
+      const char *q = memchr(p, '\0', end - p);
+      if(NULL == q) {
+          fprintf(stderr, "[sidecar] %s is truncated\n", fn);
+          exit(1);
+      }
+      s->names[i] = strdup(p);
+      p = q + 1;
+  }
+  return s;
+}
+
+void
+sidecar_close(sidecar_t *s)
+{
+  int32_t i;
+  if(NULL == s) return;
+  for(i=0;i<s->header->n_contigs;i++) {
+      free(s->names[i]);
+  }
+  free(s->names);
+  munmap((void*)s->data, s->size);
+  free(s);
+}
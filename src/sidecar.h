@@ -0,0 +1,92 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* The binary truth sidecar (dwgsim -T): with compact read names, each read
+ * pair is named by its number, and its truth is a fixed-width record at
+ * that index, so a lookup is one memory read.  The file is the header, the
+ * records in read pair order, then the contig names (each NUL-terminated)
+ * at "names_offset".  Integers are in the native byte order, checked with
+ * the magic and the record size.  The counts are those of the BWA read
+ * name. */
+
+#define SIDECAR_MAGIC "DWGT"
+
+typedef struct {
+    char magic[4];
+    uint32_t rec_size; /* sizeof(sidecar_rec_t) */
+    uint64_t n; /* the number of read pairs */
+    uint64_t names_offset; /* the contig names */
+    int32_t n_contigs;
+    int32_t reserved;
+} sidecar_header_t;
+
+typedef struct {
+    int32_t contig; /* the contig index, -1 for random reads */
+    uint32_t pos[2]; /* one-based, zero for random reads */
+    uint8_t strand[2];
+    uint8_t hap; /* the haplotype the read pair was drawn from */
+    uint8_t is_rand;
+    int32_t n_err[2], n_sub[2], n_indel[2];
+} sidecar_rec_t;
+
+typedef struct {
+    const uint8_t *data; /* the memory-mapped file */
+    size_t size;
+    const sidecar_header_t *header;
+    const sidecar_rec_t *recs;
+    char **names; /* the contig names */
+} sidecar_t;
+
+// writes a header to be completed by sidecar_end
+int32_t
+sidecar_begin(FILE *fp);
+
+// appends the contig names and completes the header; returns 1 on success
+int32_t
+sidecar_end(FILE *fp, char **names, int32_t n_contigs);
+
+sidecar_t *
+sidecar_open(const char *fn);
+
+void
+sidecar_close(sidecar_t *s);
+
+// the record of read pair "id", or NULL if there is none
+static inline const sidecar_rec_t *
+sidecar_get(const sidecar_t *s, uint64_t id)
+{
+  return (id < s->header->n) ? s->recs + id : NULL;
+}
+
+// the name of contig "i"
+#define sidecar_contig(_s, _i) ((_s)->names[(_i)])
+
+#endif
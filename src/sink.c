@@ -0,0 +1,959 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+#include "dwgsim.h"
+#include "gzi.h"
+#include "refseq.h"
+#include "truth.h"
+#include "sidecar.h"
+#include "store.h"
+#include "sink.h"
+
+static const char *sink_names[SINK_NUM] = {"bwa", "interleaved", "bfast", "ubam", "fasta", "truth", "truthsam", "sidecar", "store"};
+
+// the sink and the suffix of each file
+static const int32_t sink_file_sink[SINK_FILE_NUM] = {
+    SINK_BWA, SINK_BWA, SINK_INTERLEAVED, SINK_BFAST, SINK_UBAM, SINK_FASTA, SINK_FASTA, SINK_TRUTH, SINK_SIDECAR, SINK_STORE
+};
+static const char *sink_file_suffix[SINK_FILE_NUM] = {
+    ".bwa.read1.fastq", ".bwa.read2.fastq", ".interleaved.fastq", ".bfast.fastq",
+    ".unaligned.bam", ".read1.fasta", ".read2.fasta", ".truth.bam", ".truth.bin", ".store"
+};
+
+#define __sink_enabled(_sink, _f) ((_sink)->mask & (1 << sink_file_sink[(_f)]))
+
+#define SINK_TRUTH_MASK ((1 << SINK_TRUTH) | (1 << SINK_TRUTH_SAM))
+
+// the unmapped bin
+#define SINK_BAM_BIN 4680
+
+int32_t
+sink_parse(const char *str)
+{
+  int32_t mask = 0, i;
+  size_t n;
+  const char *p = str, *q;
+
+  while(1) {
+      q = strchr(p, ',');
+      n = (NULL == q) ? strlen(p) : (size_t)(q - p);
+      for(i=0;i<SINK_NUM;i++) {
+          if(n == strlen(sink_names[i]) && 0 == strncmp(p, sink_names[i], n)) break;
+      }
+      if(SINK_NUM == i) return -1;
+      mask |= 1 << i;
+      if(NULL == q) break;
+      p = q + 1;
+  }
+  return mask;
+}
+
+char *
+sink_mask_str(int32_t mask, char *str)
+{
+  int32_t i;
+  str[0] = '\0';
+  for(i=0;i<SINK_NUM;i++) {
+      if(0 == (mask & (1 << i))) continue;
+      if('\0' != str[0]) strcat(str, ",");
+      strcat(str, sink_names[i]);
+  }
+  return str;
+}
+
+static uint8_t *
+sink_u16(uint8_t *p, uint32_t v)
+{
+  p[0] = v & 0xff; p[1] = (v >> 8) & 0xff;
+  return p + 2;
+}
+
+static uint8_t *
+sink_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; p[2] = (v >> 16) & 0xff; p[3] = v >> 24;
+  return p + 4;
+}
+
+// is file f binary (neither compressed nor chunked)?
+#define __sink_binary(_f) (SINK_FILE_SIDECAR == (_f) || SINK_FILE_STORE == (_f))
+
+// is file f BGZF-compressed?
+#define __sink_compressed(_sink, _f) (SINK_FILE_UBAM == (_f) || (0 <= (_sink)->compress_level && !__sink_binary(_f)))
+
+// the BGZF level for file f
+static int32_t
+sink_level(const sink_t *sink, int32_t f)
+{
+  if(SINK_FILE_UBAM == f) return (sink->compress_level < 0) ? Z_DEFAULT_COMPRESSION : sink->compress_level;
+  return sink->compress_level;
+}
+
+static void
+sink_fwrite(FILE *fp, const void *buf, size_t l)
+{
+  if(0 < l && l != fwrite(buf, 1, l, fp)) {
+      fprintf(stderr, "[sink] could not write to the output file\n");
+      exit(1);
+  }
+}
+
+// the number of records per read pair in file f
+static int32_t
+sink_file_ends(const sink_t *sink, int32_t f)
+{
+  switch(f) {
+    case SINK_FILE_BWA2:
+    case SINK_FILE_FASTA2:
+      return (1 == sink->is_paired) ? 1 : 0;
+    case SINK_FILE_INTERLEAVED:
+    case SINK_FILE_BFAST:
+    case SINK_FILE_UBAM:
+      return (1 == sink->is_paired) ? 2 : 1;
+    default:
+      return 1;
+  }
+}
+
+// writes to file f, keeping the size and checksum of a chunked file
+static void
+sink_file_write(sink_t *sink, int32_t f, const void *buf, size_t l)
+{
+  sink_fwrite(sink->fp[f], buf, l);
+  if(sink->chunked & (1 << f)) {
+      sink->chunk_l[f] += l;
+      sink->chunk_crc[f] = crc32(sink->chunk_crc[f], buf, l);
+  }
+}
+
+static void
+sink_file_open(sink_t *sink, int32_t f)
+{
+  static const char *text = "@HD\tVN:1.6\tSO:unsorted\n@PG\tID:dwgsim\tPN:dwgsim\tVN:" PACKAGE_VERSION "\n";
+  char *fn = NULL, *out;
+  uint8_t *header = NULL, *p;
+  size_t l;
+
+  fn = malloc(strlen(sink->prefix) + 48);
+  if(sink->chunked & (1 << f)) {
+      sprintf(fn, "%s.%05d%s", sink->prefix, sink->chunk_i, sink_file_suffix[f]);
+  }
+  else {
+      strcpy(fn, sink->prefix); strcat(fn, sink_file_suffix[f]);
+  }
+  if(SINK_FILE_UBAM != f && __sink_compressed(sink, f)) strcat(fn, ".gz");
+  sink->fp[f] = fopen(fn, "w");
+  if(NULL == sink->fp[f]) {
+      fprintf(stderr, "[sink] could not open %s\n", fn);
+      exit(1);
+  }
+  setvbuf(sink->fp[f], NULL, _IOFBF, sink->buffer_size);
+  sink->chunk_l[f] = 0;
+  sink->chunk_crc[f] = crc32(0L, Z_NULL, 0);
+  free(sink->fn[f]);
+  sink->fn[f] = fn;
+
+  if(SINK_FILE_UBAM == f) { // the BAM header, without references
+      l = strlen(text);
+      header = malloc(l + 12);
+      memcpy(header, "BAM\1", 4);
+      p = sink_u32(header + 4, l);
+      memcpy(p, text, l);
+      sink_u32(p + l, 0);
+      out = gzi_deflate((char*)header, l + 12, sink_level(sink, SINK_FILE_UBAM), &l);
+      sink_file_write(sink, f, out, l);
+      free(out);
+      free(header);
+  }
+  else if((SINK_FILE_SIDECAR == f && 1 != sidecar_begin(sink->fp[f]))
+          || (SINK_FILE_STORE == f && 1 != store_begin(sink->fp[f], sink->data_type, sink->is_paired))) {
+      fprintf(stderr, "[sink] could not write to %s\n", fn);
+      exit(1);
+  }
+}
+
+static void
+sink_file_close(sink_t *sink, int32_t f)
+{
+  int32_t ret = 1, i;
+  if(__sink_compressed(sink, f)) sink_file_write(sink, f, gzi_eof, GZI_EOF_L);
+  if(__sink_binary(f)) { // the contig names
+      char **names = calloc(sink->contigs->n + 1, sizeof(char*));
+      for(i=0;i<sink->contigs->n;i++) {
+          names[i] = sink->contigs->contigs[i].name;
+      }
+      if(SINK_FILE_SIDECAR == f) ret = sidecar_end(sink->fp[f], names, sink->contigs->n);
+      else ret = store_end(sink->fp[f], sink->data_type, sink->is_paired, names, sink->contigs->n, sink->read_prefix);
+      free(names);
+  }
+  if(1 != ret || 0 != fclose(sink->fp[f])) {
+      fprintf(stderr, "[sink] could not write to the output file\n");
+      exit(1);
+  }
+  sink->fp[f] = NULL;
+}
+
+// closes the files of the current chunk, listing them in the manifest
+static void
+sink_chunk_close(sink_t *sink)
+{
+  int32_t f;
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(0 == (sink->chunked & (1 << f))) continue;
+      sink_file_close(sink, f);
+      fprintf(sink->fp_manifest, "%d\t%s\t%lld\t%llu\t%08x\n", sink->chunk_i, sink->fn[f],
+              (long long int)(sink->chunk_n * sink_file_ends(sink, f)), (unsigned long long int)sink->chunk_l[f], sink->chunk_crc[f]);
+  }
+}
+
+static void
+sink_chunk_open(sink_t *sink)
+{
+  int32_t f;
+  sink->chunk_n = 0;
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(sink->chunked & (1 << f)) sink_file_open(sink, f);
+  }
+}
+
+sink_t *
+sink_init(const char *prefix, int32_t mask, int32_t data_type, int32_t is_paired, int32_t compress_level, const char *read_prefix, size_t buffer_size,
+          int64_t chunk_reads, int64_t chunk_bytes)
+{
+  sink_t *sink = NULL;
+  char *fn = NULL;
+  int32_t f;
+
+  sink = calloc(1, sizeof(sink_t));
+  sink->mask = mask;
+  sink->data_type = data_type;
+  sink->is_paired = is_paired;
+  sink->compress_level = compress_level;
+  sink->read_prefix = read_prefix;
+  sink->prefix = strdup(prefix);
+  sink->buffer_size = buffer_size;
+  sink->chunk_reads = chunk_reads;
+  sink->chunk_bytes = chunk_bytes;
+  sink->contigs = contigs_init();
+
+  fn = malloc(strlen(prefix) + 32);
+  if(0 < chunk_reads || 0 < chunk_bytes) {
+      for(f=0;f<SINK_FILE_NUM;f++) {
+          if(__sink_enabled(sink, f) && SINK_FILE_TRUTH != f && !__sink_binary(f)) sink->chunked |= (1 << f);
+      }
+      strcpy(fn, prefix); strcat(fn, ".manifest.txt");
+      sink->fp_manifest = fopen(fn, "w");
+      if(NULL == sink->fp_manifest) {
+          fprintf(stderr, "[sink] could not open %s\n", fn);
+          exit(1);
+      }
+      fprintf(sink->fp_manifest, "#chunk\tfile\treads\tbytes\tcrc32\n");
+  }
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(!__sink_enabled(sink, f) || SINK_FILE_TRUTH == f) continue;
+      sink_file_open(sink, f);
+  }
+  if(0 != (mask & SINK_TRUTH_MASK)) { // written sorted at the end
+      char *fn_sam = malloc(strlen(prefix) + 32), *fn_tmp = malloc(strlen(prefix) + 32);
+      strcpy(fn, prefix); strcat(fn, ".truth.bam");
+      strcpy(fn_sam, prefix); strcat(fn_sam, ".truth.sam");
+      strcpy(fn_tmp, prefix); strcat(fn_tmp, ".truth.tmp");
+      sink->truth = truth_init((mask & (1 << SINK_TRUTH)) ? fn : NULL, (mask & (1 << SINK_TRUTH_SAM)) ? fn_sam : NULL,
+                               fn_tmp, compress_level, buffer_size);
+      free(fn_sam);
+      free(fn_tmp);
+  }
+  free(fn);
+
+  return sink;
+}
+
+int32_t
+sink_needs_contigs(const sink_t *sink)
+{
+  return (NULL != sink->truth || NULL != sink->fp[SINK_FILE_SIDECAR] || NULL != sink->fp[SINK_FILE_STORE]) ? 1 : 0;
+}
+
+void
+sink_set_contigs(sink_t *sink, const contigs_t *contigs)
+{
+  int32_t i;
+  if(NULL != sink->truth) truth_set_contigs(sink->truth, contigs);
+  contigs_destroy(sink->contigs);
+  sink->contigs = contigs_init();
+  for(i=0;i<contigs->n;i++) {
+      contigs_add(sink->contigs, contigs->contigs[i].name, contigs->contigs[i].len);
+  }
+}
+
+void
+sink_attach(sink_t *sink, int32_t s, FILE *fp)
+{
+  int32_t f;
+  sink->mask |= (1 << s);
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(s != sink_file_sink[f]) continue;
+      sink->fp[f] = fp;
+      sink->chunked &= ~(1 << f);
+  }
+}
+
+void
+sink_destroy(sink_t *sink)
+{
+  int32_t f;
+  if(NULL == sink) return;
+  if(0 != sink->chunked) {
+      sink_chunk_close(sink);
+      if(0 != fclose(sink->fp_manifest)) {
+          fprintf(stderr, "[sink] could not write the manifest\n");
+          exit(1);
+      }
+  }
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(NULL != sink->fp[f]) sink_file_close(sink, f);
+      free(sink->fn[f]);
+  }
+  truth_destroy(sink->truth);
+  contigs_destroy(sink->contigs);
+  free(sink->prefix);
+  free(sink);
+}
+
+void
+sink_buf_init(sink_buf_t *b)
+{
+  memset(b, 0, sizeof(sink_buf_t));
+  b->head_contig = -2;
+}
+
+void
+sink_buf_destroy(sink_buf_t *b)
+{
+  int32_t f;
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      free(b->out[f].s);
+      free(b->z[f]);
+  }
+  free(b->head.s);
+  free(b->name.s);
+  free(b->ends);
+}
+
+void
+sink_buf_open(sink_buf_t *b)
+{
+  int32_t f;
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      b->out[f].l = 0;
+  }
+  b->n_pairs = 0;
+}
+
+void
+sink_buf_next(const sink_t *sink, sink_buf_t *b)
+{
+  int32_t f;
+  if(0 == sink->chunked) return;
+  if(b->n_pairs == b->m_pairs) {
+      b->m_pairs = (b->m_pairs < 256) ? 256 : b->m_pairs << 1;
+      b->ends = realloc(b->ends, (size_t)b->m_pairs * SINK_FILE_NUM * sizeof(size_t));
+  }
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      b->ends[(size_t)b->n_pairs * SINK_FILE_NUM + f] = b->out[f].l;
+  }
+  b->n_pairs++;
+}
+
+void
+sink_buf_close(const sink_t *sink, sink_buf_t *b)
+{
+  int32_t f;
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(NULL == sink->fp[f] || !__sink_compressed(sink, f)) continue;
+      b->z[f] = gzi_deflate(b->out[f].s, b->out[f].l, sink_level(sink, f), &b->z_l[f]);
+  }
+}
+
+// writes read pairs [i, i + n) of the block to the chunked file f; a block
+// split between chunks is compressed again in parts
+static void
+sink_buf_write_pairs(sink_t *sink, sink_buf_t *b, int32_t f, int32_t i, int32_t n)
+{
+  size_t start, end, l;
+  char *z;
+  if(0 == i && n == b->n_pairs && NULL != b->z[f]) {
+      sink_file_write(sink, f, b->z[f], b->z_l[f]);
+      return;
+  }
+  start = (0 == i) ? 0 : b->ends[(size_t)(i - 1) * SINK_FILE_NUM + f];
+  end = b->ends[(size_t)(i + n - 1) * SINK_FILE_NUM + f];
+  if(__sink_compressed(sink, f)) {
+      z = gzi_deflate(b->out[f].s + start, end - start, sink_level(sink, f), &l);
+      sink_file_write(sink, f, z, l);
+      free(z);
+  }
+  else {
+      sink_file_write(sink, f, b->out[f].s + start, end - start);
+  }
+}
+
+// the number of read pairs from pair i of the block that fit in the current
+// chunk; the compressed size is estimated from the whole block
+static int32_t
+sink_chunk_room(const sink_t *sink, const sink_buf_t *b, int32_t i)
+{
+  int32_t f, n = b->n_pairs - i, k;
+  size_t start;
+  double r;
+
+  if(0 < sink->chunk_reads && sink->chunk_reads - sink->chunk_n < n) n = sink->chunk_reads - sink->chunk_n;
+  if(0 < sink->chunk_bytes) {
+      for(f=0;f<SINK_FILE_NUM;f++) {
+          if(0 == (sink->chunked & (1 << f)) || 0 == b->out[f].l) continue;
+          r = (NULL == b->z[f]) ? 1.0 : b->z_l[f] / (double)b->out[f].l;
+          start = (0 == i) ? 0 : b->ends[(size_t)(i - 1) * SINK_FILE_NUM + f];
+          for(k=0;k<n;k++) {
+              if(sink->chunk_bytes < sink->chunk_l[f] + r * (b->ends[(size_t)(i + k) * SINK_FILE_NUM + f] - start)) break;
+          }
+          n = k;
+      }
+  }
+  return n;
+}
+
+void
+sink_buf_write(sink_t *sink, sink_buf_t *b)
+{
+  int32_t f, i, n;
+  if(NULL != sink->truth) {
+      truth_add(sink->truth, (uint8_t*)b->out[SINK_FILE_TRUTH].s, b->out[SINK_FILE_TRUTH].l);
+  }
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      if(NULL == sink->fp[f] || (sink->chunked & (1 << f))) continue;
+      if(NULL != b->z[f]) {
+          sink_file_write(sink, f, b->z[f], b->z_l[f]);
+      }
+      else {
+          sink_file_write(sink, f, b->out[f].s, b->out[f].l);
+      }
+  }
+  if(0 != sink->chunked) {
+      for(i=0;i<b->n_pairs;i+=n) {
+          n = sink_chunk_room(sink, b, i);
+          if(0 == n && 0 < sink->chunk_n) {
+              sink_chunk_close(sink);
+              sink->chunk_i++;
+              sink_chunk_open(sink);
+              n = sink_chunk_room(sink, b, i);
+          }
+          if(0 == n) n = 1; // a read pair larger than a chunk
+          for(f=0;f<SINK_FILE_NUM;f++) {
+              if(sink->chunked & (1 << f)) sink_buf_write_pairs(sink, b, f, i, n);
+          }
+          sink->chunk_n += n;
+      }
+  }
+  for(f=0;f<SINK_FILE_NUM;f++) {
+      free(b->z[f]);
+      b->z[f] = NULL;
+  }
+}
+
+// room for "n" more bytes, returning the end of the string
+static inline char *
+sink_reserve(sink_str_t *str, size_t n)
+{
+  if(str->m < str->l + n) {
+      str->m = (str->l + n) << 1;
+      str->s = realloc(str->s, str->m);
+  }
+  return str->s + str->l;
+}
+
+static const char sink_digits[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// writes "v" in decimal, returning the end
+static inline char *
+sink_dec(char *p, uint32_t v)
+{
+  char tmp[10], *q = tmp + 10;
+  while(100 <= v) {
+      q -= 2;
+      memcpy(q, sink_digits + ((v % 100) << 1), 2);
+      v /= 100;
+  }
+  if(10 <= v) {
+      q -= 2;
+      memcpy(q, sink_digits + (v << 1), 2);
+  }
+  else {
+      *(--q) = '0' + v;
+  }
+  memcpy(p, q, tmp + 10 - q);
+  return p + (tmp + 10 - q);
+}
+
+static inline char *
+sink_signed_dec(char *p, int32_t v)
+{
+  if(v < 0) {
+      *p++ = '-';
+      return sink_dec(p, -(uint32_t)v);
+  }
+  return sink_dec(p, v);
+}
+
+static inline char *
+sink_dec64(char *p, uint64_t v)
+{
+  char tmp[10];
+  if(v <= UINT32_MAX) return sink_dec(p, v);
+  p = sink_dec64(p, v / 1000000000);
+  sink_dec(tmp, 1000000000 + v % 1000000000); // the last nine digits, zero-padded
+  memcpy(p, tmp + 1, 9);
+  return p + 9;
+}
+
+// writes "v" in lower case hexadecimal, returning the end
+static inline char *
+sink_hex(char *p, uint64_t v)
+{
+  char tmp[16], *q = tmp + 16;
+  do {
+      *(--q) = "0123456789abcdef"[v & 15];
+      v >>= 4;
+  } while(0 < v);
+  memcpy(p, q, tmp + 16 - q);
+  return p + (tmp + 16 - q);
+}
+
+// formats the read name (without the end) into b->name; the SOLiD counts
+// given to BWA leave out the first color
+static void
+sink_name(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, int32_t bwa)
+{
+  int32_t k = (1 == bwa && SOLID == sink->data_type) ? 1 : 0, j;
+  size_t n;
+  char *q;
+
+  if(NULL != sink->fp[SINK_FILE_SIDECAR]) { // the read pair number
+      n = (NULL == sink->read_prefix) ? 0 : strlen(sink->read_prefix);
+      b->name.l = 0;
+      q = sink_reserve(&b->name, n + 24);
+      if(NULL != sink->read_prefix) {
+          memcpy(q, sink->read_prefix, n); q += n;
+          *q++ = '_';
+      }
+      q = sink_dec64(q, p->read_id);
+      *q = '\0';
+      b->name.l = q - b->name.s;
+      return;
+  }
+
+  // the read prefix and the contig, kept for the whole contig
+  if(b->head_contig != p->contig_i) {
+      b->head.l = 0;
+      n = strlen(p->contig) + ((NULL == sink->read_prefix) ? 0 : strlen(sink->read_prefix) + 1) + 1;
+      q = sink_reserve(&b->head, n);
+      if(NULL != sink->read_prefix) {
+          n = strlen(sink->read_prefix);
+          memcpy(q, sink->read_prefix, n); q += n;
+          *q++ = '_';
+      }
+      n = strlen(p->contig);
+      memcpy(q, p->contig, n); q += n;
+      *q++ = '_';
+      b->head.l = q - b->head.s;
+      b->head_contig = p->contig_i;
+  }
+
+  // 4 x 10 for the positions and strands, 2 for the random flags, 6 x 11
+  // for the counts, 16 for the id, and the separators
+  b->name.l = 0;
+  q = sink_reserve(&b->name, b->head.l + 160);
+  memcpy(q, b->head.s, b->head.l); q += b->head.l;
+  q = sink_dec(q, p->pos[0]); *q++ = '_';
+  q = sink_dec(q, p->pos[1]); *q++ = '_';
+  q = sink_dec(q, p->strand[0]); *q++ = '_';
+  q = sink_dec(q, p->strand[1]); *q++ = '_';
+  q = sink_dec(q, p->is_rand); *q++ = '_';
+  q = sink_dec(q, p->is_rand); *q++ = '_';
+  for(j = 0; j < 2; j++) {
+      q = sink_signed_dec(q, p->n_err[j] - k * p->n_err_first[j]); *q++ = ':';
+      q = sink_signed_dec(q, p->n_sub[j] - k * p->n_sub_first[j]); *q++ = ':';
+      q = sink_signed_dec(q, p->n_indel[j] - k * p->n_indel_first[j]); *q++ = '_';
+  }
+  q = sink_hex(q, p->id);
+  *q = '\0';
+  b->name.l = q - b->name.s;
+}
+
+// the bases as ASCII
+static inline char *
+sink_bases(char *q, const uint8_t *seq, int32_t len, const char *table)
+{
+  int32_t i;
+  for(i = 0; i < len; i++) {
+      q[i] = table[seq[i]];
+  }
+  return q + len;
+}
+
+static void
+sink_put_fastq(sink_str_t *out, const sink_str_t *name, int32_t end, const uint8_t *seq, const char *qstr, int32_t len)
+{
+  char *q = sink_reserve(out, name->l + 2 * len + 16);
+  *q++ = '@';
+  memcpy(q, name->s, name->l); q += name->l;
+  *q++ = '/';
+  q = sink_dec(q, end);
+  *q++ = '\n';
+  q = sink_bases(q, seq, len, "ACGTN");
+  *q++ = '\n'; *q++ = '+'; *q++ = '\n';
+  memcpy(q, qstr, len); q += len;
+  *q++ = '\n';
+  out->l = q - out->s;
+}
+
+static void
+sink_put_fasta(sink_str_t *out, const sink_str_t *name, int32_t end, const uint8_t *seq, int32_t len)
+{
+  char *q = sink_reserve(out, name->l + len + 16);
+  *q++ = '>';
+  memcpy(q, name->s, name->l); q += name->l;
+  *q++ = '/';
+  q = sink_dec(q, end);
+  *q++ = '\n';
+  q = sink_bases(q, seq, len, "ACGTN");
+  *q++ = '\n';
+  out->l = q - out->s;
+}
+
+static void
+sink_put_bfast(const sink_t *sink, sink_str_t *out, const sink_str_t *name, const uint8_t *seq, const char *qstr, int32_t len)
+{
+  char *q = sink_reserve(out, name->l + 2 * len + 16);
+  *q++ = '@';
+  memcpy(q, name->s, name->l); q += name->l;
+  *q++ = '\n';
+  if(SOLID != sink->data_type) {
+      q = sink_bases(q, seq, len, "ACGTN");
+  }
+  else {
+      *q++ = 'A';
+      q = sink_bases(q, seq, len, "01234");
+  }
+  *q++ = '\n'; *q++ = '+'; *q++ = '\n';
+  memcpy(q, qstr, len); q += len;
+  *q++ = '\n';
+  out->l = q - out->s;
+}
+
+static void
+sink_put_ubam(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, int32_t j, int32_t end, const uint8_t *seq, const char *qstr, int32_t len)
+{
+  static const uint8_t nt16[5] = {1, 2, 4, 8, 15}; // ACGTN
+  sink_str_t *out = &b->out[SINK_FILE_UBAM];
+  size_t l_name = b->name.l + 1, l_contig = strlen(p->contig) + 1;
+  int32_t i, k = (SOLID == sink->data_type) ? 1 : 0;
+  uint32_t flag;
+  uint8_t *rec, *r;
+
+  if(255 < l_name) {
+      fprintf(stderr, "[sink] the read name is too long for BAM: %s\n", b->name.s);
+      exit(1);
+  }
+  rec = r = (uint8_t*)sink_reserve(out, 36 + l_name + ((len + 1) >> 1) + len + (3 + l_contig) + 7 * 5 + 4);
+  flag = 0x4;
+  if(1 == sink->is_paired) flag |= 0x1 | 0x8 | ((1 == end) ? 0x40 : 0x80);
+  r = sink_u32(rec + 4, (uint32_t)-1); // reference
+  r = sink_u32(r, (uint32_t)-1); // position
+  (*r++) = l_name;
+  (*r++) = 0; // mapping quality
+  r = sink_u16(r, SINK_BAM_BIN);
+  r = sink_u16(r, 0); // no CIGAR
+  r = sink_u16(r, flag);
+  r = sink_u32(r, len);
+  r = sink_u32(r, (uint32_t)-1); // mate reference
+  r = sink_u32(r, (uint32_t)-1); // mate position
+  r = sink_u32(r, 0); // insert size
+  memcpy(r, b->name.s, l_name); r += l_name;
+  for(i = 0; i < len; i += 2) {
+      (*r++) = (nt16[seq[i]] << 4) | ((i + 1 < len) ? nt16[seq[i+1]] : 0);
+  }
+  for(i = 0; i < len; i++) {
+      (*r++) = qstr[i] - 33;
+  }
+  // the truth
+  (*r++) = 'Y'; (*r++) = 'C'; (*r++) = 'Z';
+  memcpy(r, p->contig, l_contig); r += l_contig;
+  (*r++) = 'Y'; (*r++) = 'P'; (*r++) = 'i'; r = sink_u32(r, p->pos[j]);
+  (*r++) = 'Y'; (*r++) = 'S'; (*r++) = 'A'; (*r++) = (0 == p->strand[j]) ? '+' : '-';
+  (*r++) = 'Y'; (*r++) = 'E'; (*r++) = 'i'; r = sink_u32(r, p->n_err[j] - k * p->n_err_first[j]);
+  (*r++) = 'Y'; (*r++) = 'M'; (*r++) = 'i'; r = sink_u32(r, p->n_sub[j] - k * p->n_sub_first[j]);
+  (*r++) = 'Y'; (*r++) = 'I'; (*r++) = 'i'; r = sink_u32(r, p->n_indel[j] - k * p->n_indel_first[j]);
+  (*r++) = 'Y'; (*r++) = 'R'; (*r++) = 'i'; r = sink_u32(r, p->is_rand);
+  sink_u32(rec, (r - rec) - 4);
+  out->l += r - rec;
+}
+
+// the truth of the read pair, with the counts of the BWA read name
+static void
+sink_put_sidecar(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p)
+{
+  int32_t k = (SOLID == sink->data_type) ? 1 : 0, j;
+  sidecar_rec_t *rec;
+
+  rec = (sidecar_rec_t*)sink_reserve(&b->out[SINK_FILE_SIDECAR], sizeof(sidecar_rec_t));
+  memset(rec, 0, sizeof(sidecar_rec_t));
+  rec->contig = (1 == p->is_rand) ? -1 : p->contig_i;
+  rec->hap = p->hap;
+  rec->is_rand = p->is_rand;
+  for(j = 0; j < 2; j++) {
+      rec->pos[j] = p->pos[j];
+      rec->strand[j] = p->strand[j];
+      rec->n_err[j] = p->n_err[j] - k * p->n_err_first[j];
+      rec->n_sub[j] = p->n_sub[j] - k * p->n_sub_first[j];
+      rec->n_indel[j] = p->n_indel[j] - k * p->n_indel_first[j];
+  }
+  b->out[SINK_FILE_SIDECAR].l += sizeof(sidecar_rec_t);
+}
+
+void
+sink_put(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, int32_t j, const uint8_t *seq, const char *qstr, int32_t len)
+{
+  int32_t end;
+
+  if(sink->mask & ((1 << SINK_BWA) | (1 << SINK_INTERLEAVED) | (1 << SINK_UBAM) | (1 << SINK_FASTA))) {
+      sink_name(sink, b, p, 1);
+      end = j + 1;
+      if(SOLID == sink->data_type) {
+          // Note: BWA ignores the adapter and the first color, so this is a misrepresentation 
+          // in samtools.  We must first skip the first color.  Basically, a 50 color read is a 
+          // 49 color read for BWA.
+          //
+          // Note: BWA outputs F3 to read1, annotated as read "2", and outputs R3 to read2,
+          // annotated as read "1".
+          end = 2 - j;
+          seq++; qstr++; len--;
+      }
+      if(NULL != sink->fp[SINK_FILE_BWA1]) {
+          sink_put_fastq(&b->out[(0 == j) ? SINK_FILE_BWA1 : SINK_FILE_BWA2], &b->name, end, seq, qstr, len);
+      }
+      if(NULL != sink->fp[SINK_FILE_INTERLEAVED]) {
+          sink_put_fastq(&b->out[SINK_FILE_INTERLEAVED], &b->name, end, seq, qstr, len);
+      }
+      if(NULL != sink->fp[SINK_FILE_FASTA1]) {
+          sink_put_fasta(&b->out[(0 == j) ? SINK_FILE_FASTA1 : SINK_FILE_FASTA2], &b->name, end, seq, len);
+      }
+      if(NULL != sink->fp[SINK_FILE_UBAM]) {
+          sink_put_ubam(sink, b, p, j, end, seq, qstr, len);
+      }
+      if(SOLID == sink->data_type) {
+          seq--; qstr--; len++;
+      }
+  }
+
+  if(NULL != sink->fp[SINK_FILE_BFAST]) {
+      // the BFAST name has the same counts as BWA except for SOLiD
+      if(SOLID == sink->data_type || 0 == (sink->mask & ((1 << SINK_BWA) | (1 << SINK_INTERLEAVED) | (1 << SINK_UBAM) | (1 << SINK_FASTA)))) {
+          sink_name(sink, b, p, 0);
+      }
+      sink_put_bfast(sink, &b->out[SINK_FILE_BFAST], &b->name, seq, qstr, len);
+  }
+
+  if(NULL != sink->fp[SINK_FILE_SIDECAR] && 0 == j) { // once per read pair
+      sink_put_sidecar(sink, b, p);
+  }
+
+  if(NULL != sink->fp[SINK_FILE_STORE]) { // the truth with the first end
+      sink_str_t *out = &b->out[SINK_FILE_STORE];
+      uint8_t *q = (uint8_t*)sink_reserve(out, STORE_MAX_PAIR + store_max_end(len)), *r = q;
+      if(0 == j) r = store_put_pair(r, p, 0 == out->l);
+      r = store_put_end(r, seq, qstr, len);
+      out->l += r - q;
+  }
+}
+
+// the BAM bin of [beg, end)
+static int32_t
+sink_reg2bin(int32_t beg, int32_t end)
+{
+  --end;
+  if(beg >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (beg >> 14);
+  if(beg >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (beg >> 17);
+  if(beg >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (beg >> 20);
+  if(beg >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (beg >> 23);
+  if(beg >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (beg >> 26);
+  return 0;
+}
+
+// the number of reference bases in the alignment
+static int32_t
+sink_aln_ref_len(const sink_aln_t *a)
+{
+  int32_t i, n = 0;
+  for(i = 0; i < a->n_cigar; i++) {
+      if(0 == (a->cigar[i] & 0xf) || 2 == (a->cigar[i] & 0xf)) n += a->cigar[i] >> 4; // M or D
+  }
+  return n;
+}
+
+static void
+sink_put_truth_end(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, const sink_aln_t *aln, int32_t j, int32_t end, const refseq_t *ref)
+{
+  static const uint8_t nt16[5] = {1, 2, 4, 8, 15}; // ACGTN
+  static const uint8_t comp[5] = {3, 2, 1, 0, 4};
+  const sink_aln_t *a = &aln[j], *mate = &aln[1-j];
+  sink_str_t *out = &b->out[SINK_FILE_TRUTH];
+  size_t l_name = b->name.l + 1;
+  int32_t i, k, x, y, u, op, len, nm, tlen = 0, l_ref = 0, is_mapped = (0 <= a->pos), rev = p->strand[j];
+  uint32_t flag = 0;
+  uint8_t *rec, *r, c, rc;
+  char *q;
+
+  if(255 < l_name) {
+      fprintf(stderr, "[sink] the read name is too long for BAM: %s\n", b->name.s);
+      exit(1);
+  }
+  if(is_mapped) l_ref = sink_aln_ref_len(a);
+  rec = r = (uint8_t*)sink_reserve(out, 36 + l_name + 16 * a->n_cigar + ((a->len + 1) >> 1) + a->len + 3 * l_ref + 32);
+
+  // the bases as aligned
+#define __sink_fwd(_i) ((1 == rev) ? comp[a->seq[a->len - 1 - (_i)]] : a->seq[(_i)])
+
+  if(1 == sink->is_paired) {
+      flag |= 0x1 | ((1 == end) ? 0x40 : 0x80);
+      if(!is_mapped) flag |= 0x4 | 0x8;
+      else {
+          flag |= 0x2;
+          if(1 == p->strand[1-j]) flag |= 0x20;
+          k = sink_aln_ref_len(mate);
+          x = (a->pos < mate->pos) ? a->pos : mate->pos;
+          y = (a->pos + l_ref < mate->pos + k) ? mate->pos + k : a->pos + l_ref;
+          tlen = (a->pos < mate->pos || (a->pos == mate->pos && 1 == end)) ? y - x : x - y;
+      }
+  }
+  else if(!is_mapped) flag |= 0x4;
+  if(is_mapped && 1 == rev) flag |= 0x10;
+
+  r = sink_u32(rec + 4, is_mapped ? p->contig_i : -1);
+  r = sink_u32(r, a->pos);
+  (*r++) = l_name;
+  (*r++) = is_mapped ? 60 : 0; // mapping quality
+  r = sink_u16(r, is_mapped ? sink_reg2bin(a->pos, a->pos + l_ref) : SINK_BAM_BIN);
+  r = sink_u16(r, a->n_cigar);
+  r = sink_u16(r, flag);
+  r = sink_u32(r, a->len);
+  if(1 == sink->is_paired && is_mapped) {
+      r = sink_u32(r, p->contig_i);
+      r = sink_u32(r, mate->pos);
+  }
+  else {
+      r = sink_u32(r, (uint32_t)-1);
+      r = sink_u32(r, (uint32_t)-1);
+  }
+  r = sink_u32(r, tlen);
+  memcpy(r, b->name.s, l_name); r += l_name;
+  for(i = 0; i < a->n_cigar; i++) {
+      op = a->cigar[i] & 0xf;
+      if(1 == op && (0 == i || a->n_cigar - 1 == i)) op = 4; // cut insertions are soft-clipped
+      r = sink_u32(r, (a->cigar[i] & ~0xf) | op);
+  }
+  for(i = 0; i < a->len; i += 2) {
+      (*r++) = (nt16[__sink_fwd(i)] << 4) | ((i + 1 < a->len) ? nt16[__sink_fwd(i+1)] : 0);
+  }
+  if(NULL == a->qstr) {
+      memset(r, 0xff, a->len); r += a->len;
+  }
+  else {
+      for(i = 0; i < a->len; i++) {
+          (*r++) = a->qstr[(1 == rev) ? a->len - 1 - i : i] - 33;
+      }
+  }
+
+  if(is_mapped) { // MD and NM against the reference
+      (*r++) = 'M'; (*r++) = 'D'; (*r++) = 'Z';
+      q = (char*)r;
+      x = 0; y = a->pos; u = 0; nm = 0;
+      for(i = 0; i < a->n_cigar; i++) {
+          op = a->cigar[i] & 0xf;
+          len = a->cigar[i] >> 4;
+          if(0 == op) {
+              for(k = 0; k < len; k++, x++, y++) {
+                  c = __sink_fwd(x); rc = refseq_get(ref, y);
+                  if(c == rc && c < 4) u++;
+                  else {
+                      q = sink_dec(q, u); u = 0;
+                      *q++ = "ACGTN"[rc];
+                      nm++;
+                  }
+              }
+          }
+          else if(1 == op) {
+              x += len;
+              if(0 < i && i < a->n_cigar - 1) nm += len;
+          }
+          else if(4 == op) { // adapter
+              x += len;
+          }
+          else if(2 == op) {
+              q = sink_dec(q, u); u = 0;
+              *q++ = '^';
+              for(k = 0; k < len; k++, y++) {
+                  *q++ = "ACGTN"[refseq_get(ref, y)];
+              }
+              nm += len;
+          }
+      }
+      q = sink_dec(q, u);
+      *q++ = '\0';
+      r = (uint8_t*)q;
+      (*r++) = 'N'; (*r++) = 'M'; (*r++) = 'i'; r = sink_u32(r, nm);
+  }
+#undef __sink_fwd
+  sink_u32(rec, (r - rec) - 4);
+  out->l += r - rec;
+}
+
+void
+sink_put_truth(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, const sink_aln_t *aln, const refseq_t *ref)
+{
+  int32_t j;
+  sink_name(sink, b, p, 1);
+  for(j = 0; j < 2; j++) {
+      if(aln[j].len <= 0) continue;
+      sink_put_truth_end(sink, b, p, aln, j, (SOLID == sink->data_type) ? 2 - j : j + 1, ref);
+  }
+}
@@ -0,0 +1,235 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "refseq.h"
+#include "contigs.h"
+#include "truth.h"
+
+/* The read output: each enabled sink writes to one or more files, buffered
+ * per block of read pairs by the worker threads.  Each round of filled
+ * blocks is handed to the writer thread with writer_push (see writer.h) and
+ * written in block order while the next round is generated; with -w 0 the
+ * main thread writes them instead.  Records are formatted straight into the
+ * block buffers, which are kept between rounds: there are -w + 1 sets, and
+ * a set is only refilled once writer_push has returned with at most -w
+ * rounds outstanding, so its writes are done.  writer_sync waits for all
+ * rounds, before the files are closed.
+ *
+ * The uBAM sink writes every read unaligned, with the read name of the BWA
+ * sink and the simulated truth in tags:
+ *   YC:Z - the contig ("rand" for random reads)
+ *   YP:i - the one-based position of this end (zero for random reads)
+ *   YS:A - the strand of this end ('+' or '-')
+ *   YE:i, YM:i, YI:i - the number of sequencing errors, substitutions and
+ *                      indels in this end
+ *   YR:i - one for a random read, zero otherwise
+ *
+ * The truth sinks write every read aligned to where it was simulated,
+ * sorted by coordinate (see truth.h): the CIGAR against the reference
+ * includes the simulated indels, and NM/MD the simulated variants and (for
+ * Illumina) the sequencing errors.  For SOLiD and Ion Torrent the sequence
+ * is the true base sequence, before the color or flow errors, without base
+ * qualities.  Insertions cut by the end of the read are soft-clipped, and
+ * random reads are unmapped.
+ *
+ * With chunking, the files of each sink except the truth sinks are split
+ * into chunks of at most a given number of read pairs, or of at most about
+ * a given number of bytes (the compressed size is estimated), named
+ * <prefix>.<chunk>.<suffix>.  All files rotate together at the same read
+ * pair, so paired chunks stay in step.  Each chunk file is listed in
+ * <prefix>.manifest.txt with its number of reads, its size and its CRC-32
+ * (as computed by zlib).
+ *
+ * With the sidecar sink, every read is named by the number of its read pair
+ * in the output (after any read prefix), and the truth of each read pair is
+ * written to a binary sidecar instead (see sidecar.h).
+ *
+ * The store sink writes every read pair, with its truth, to a binary read
+ * store (see store.h) that "dwgsim replay" writes to the other sinks.  The
+ * sidecar and the store are never compressed or chunked. */
+
+enum {
+    SINK_BWA = 0, /* FASTQ, one file per end */
+    SINK_INTERLEAVED = 1, /* FASTQ, both ends in one file */
+    SINK_BFAST = 2, /* FASTQ for BFAST */
+    SINK_UBAM = 3, /* unaligned BAM with truth tags */
+    SINK_FASTA = 4, /* FASTA, one file per end */
+    SINK_TRUTH = 5, /* the truth alignments as BAM */
+    SINK_TRUTH_SAM = 6, /* the truth alignments as SAM */
+    SINK_SIDECAR = 7, /* the binary truth sidecar, with compact read names */
+    SINK_STORE = 8, /* the binary read store, for dwgsim replay */
+    SINK_NUM = 9
+};
+
+enum {
+    SINK_FILE_BWA1 = 0,
+    SINK_FILE_BWA2,
+    SINK_FILE_INTERLEAVED,
+    SINK_FILE_BFAST,
+    SINK_FILE_UBAM,
+    SINK_FILE_FASTA1,
+    SINK_FILE_FASTA2,
+    SINK_FILE_TRUTH, /* BAM records, sorted by the truth sorter */
+    SINK_FILE_SIDECAR,
+    SINK_FILE_STORE,
+    SINK_FILE_NUM
+};
+
+#define SINK_DEFAULT ((1 << SINK_BWA) | (1 << SINK_BFAST))
+
+typedef struct {
+    int32_t mask; /* the enabled sinks, bits (1 << SINK_*) */
+    int32_t data_type; /* ILLUMINA, SOLID or IONTORRENT */
+    int32_t is_paired; /* are there two ends? */
+    int32_t compress_level; /* BGZF level for the FASTQ/FASTA files, -1 for none */
+    const char *read_prefix; /* prepended to each read name, or NULL */
+    FILE *fp[SINK_FILE_NUM]; /* NULL unless enabled */
+    truth_t *truth; /* the truth sorter, NULL unless enabled */
+    contigs_t *contigs; /* the contig names, for the sidecar and the store */
+    char *prefix;
+    size_t buffer_size;
+    int32_t chunked; /* the chunked files, bits (1 << SINK_FILE_*) */
+    int64_t chunk_reads; /* the maximum read pairs per chunk, 0 for no limit */
+    int64_t chunk_bytes; /* the maximum bytes per chunk file, 0 for no limit */
+    int32_t chunk_i; /* the current chunk */
+    int64_t chunk_n; /* the read pairs in the current chunk */
+    uint64_t chunk_l[SINK_FILE_NUM]; /* the bytes written to each file of the current chunk */
+    uint32_t chunk_crc[SINK_FILE_NUM]; /* and their CRC-32 */
+    char *fn[SINK_FILE_NUM]; /* the name of each chunked file */
+    FILE *fp_manifest;
+} sink_t;
+
+typedef struct {
+    char *s;
+    size_t l, m; /* length and maximum buffer size */
+} sink_str_t;
+
+// one block of output, in memory
+typedef struct {
+    sink_str_t out[SINK_FILE_NUM]; /* the formatted records */
+    char *z[SINK_FILE_NUM]; /* the records compressed, or NULL */
+    size_t z_l[SINK_FILE_NUM];
+    sink_str_t head; /* the read name up to the positions */
+    int32_t head_contig; /* the contig of "head", -2 for none */
+    sink_str_t name; /* the read name */
+    size_t *ends; /* with chunking, the end of each read pair in each file */
+    int32_t n_pairs, m_pairs;
+} sink_buf_t;
+
+// a simulated read pair, as described in its read name
+typedef struct {
+    int32_t contig_i; /* the contig index, -1 for random reads */
+    const char *contig; /* "rand" for random reads */
+    uint32_t pos[2]; /* one-based, zero for random reads */
+    int32_t strand[2];
+    int32_t is_rand;
+    int32_t hap; /* the haplotype */
+    int32_t n_err[2], n_sub[2], n_indel[2];
+    int32_t n_err_first[2], n_sub_first[2], n_indel_first[2]; /* in the first color (SOLiD) */
+    uint64_t id; /* the read pair within the contig */
+    uint64_t read_id; /* the read pair within the output */
+} sink_pair_t;
+
+// the true alignment of one end of a read pair
+typedef struct {
+    int32_t pos; /* zero-based leftmost position, -1 for random reads */
+    int32_t n_cigar;
+    const uint32_t *cigar; /* BAM CIGAR operations, left to right */
+    const uint8_t *seq; /* the bases (0-4) as read, before any reverse complement */
+    const char *qstr; /* the base qualities as read, or NULL */
+    int32_t len;
+} sink_aln_t;
+
+// parses a comma-separated list of sink names, returning the mask or -1
+int32_t
+sink_parse(const char *str);
+
+// writes the comma-separated names of the sinks in "mask" to "str" (at
+// least 128 bytes), returning "str"
+char *
+sink_mask_str(int32_t mask, char *str);
+
+// opens the files for the sinks in "mask" named after "prefix", each with a
+// stdio buffer of "buffer_size" bytes; the files are chunked if either
+// "chunk_reads" or "chunk_bytes" is not zero
+sink_t *
+sink_init(const char *prefix, int32_t mask, int32_t data_type, int32_t is_paired, int32_t compress_level, const char *read_prefix, size_t buffer_size,
+          int64_t chunk_reads, int64_t chunk_bytes);
+
+// do the sinks need the contig names?
+int32_t
+sink_needs_contigs(const sink_t *sink);
+
+// the contigs, for the truth, sidecar and store sinks
+void
+sink_set_contigs(sink_t *sink, const contigs_t *contigs);
+
+// writes sink "s" to "fp" (for example a pipe) instead of a file named after
+// the prefix; "fp" is closed by sink_destroy
+void
+sink_attach(sink_t *sink, int32_t s, FILE *fp);
+
+// closes the files
+void
+sink_destroy(sink_t *sink);
+
+void
+sink_buf_init(sink_buf_t *b);
+
+void
+sink_buf_destroy(sink_buf_t *b);
+
+// empties the in-memory buffers of a block
+void
+sink_buf_open(sink_buf_t *b);
+
+// marks the end of a read pair in the block, where a chunk may end
+void
+sink_buf_next(const sink_t *sink, sink_buf_t *b);
+
+// finishes (and compresses) the in-memory buffers of a block
+void
+sink_buf_close(const sink_t *sink, sink_buf_t *b);
+
+// writes out the buffers of a block
+void
+sink_buf_write(sink_t *sink, sink_buf_t *b);
+
+// writes end j of the read pair, with "len" bases (0-4) and qualities
+// (Phred+33); SOLiD reads are in colors
+void
+sink_put(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, int32_t j, const uint8_t *seq, const char *qstr, int32_t len);
+
+// writes the true alignments of both ends of the read pair to the truth
+// sorter, against the contig "ref" (NULL for random reads)
+void
+sink_put_truth(const sink_t *sink, sink_buf_t *b, const sink_pair_t *p, const sink_aln_t *aln, const refseq_t *ref);
+
+#endif
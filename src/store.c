@@ -0,0 +1,310 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sink.h"
+#include "store.h"
+
+static inline uint8_t *
+store_put_u(uint8_t *q, uint64_t v)
+{
+  while(0x80 <= v) {
+      *q++ = (v & 0x7f) | 0x80;
+      v >>= 7;
+  }
+  *q++ = v;
+  return q;
+}
+
+// zig-zag, so that small negative values are short
+static inline uint8_t *
+store_put_i(uint8_t *q, int32_t v)
+{
+  return store_put_u(q, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static void
+store_truncated()
+{
+  fprintf(stderr, "[store] the read store is truncated or corrupt\n");
+  exit(1);
+}
+
+static inline uint64_t
+store_get_u(store_t *s)
+{
+  uint64_t v = 0;
+  int32_t shift = 0;
+  do {
+      if(s->end <= s->p || 63 < shift) store_truncated();
+      v |= (uint64_t)((*s->p) & 0x7f) << shift;
+      shift += 7;
+  } while(0x80 & *(s->p++));
+  return v;
+}
+
+static inline int32_t
+store_get_i(store_t *s)
+{
+  uint32_t v = store_get_u(s);
+  return (int32_t)((v >> 1) ^ -(v & 1));
+}
+
+static void
+store_header(store_header_t *h, int32_t data_type, int32_t is_paired)
+{
+  memset(h, 0, sizeof(store_header_t));
+  memcpy(h->magic, STORE_MAGIC, 4);
+  h->version = STORE_VERSION;
+  h->data_type = data_type;
+  h->is_paired = is_paired;
+}
+
+int32_t
+store_begin(FILE *fp, int32_t data_type, int32_t is_paired)
+{
+  store_header_t h;
+  store_header(&h, data_type, is_paired);
+  return (1 == fwrite(&h, sizeof(store_header_t), 1, fp)) ? 1 : 0;
+}
+
+int32_t
+store_end(FILE *fp, int32_t data_type, int32_t is_paired, char **names, int32_t n_contigs, const char *read_prefix)
+{
+  store_header_t h;
+  long offset;
+  int32_t i;
+
+  offset = ftell(fp);
+  if(offset < 0) return 0;
+  store_header(&h, data_type, is_paired);
+  h.names_offset = offset;
+  h.n_contigs = n_contigs;
+  for(i=0;i<n_contigs;i++) {
+      if(1 != fwrite(names[i], strlen(names[i]) + 1, 1, fp)) return 0;
+  }
+  if(NULL == read_prefix) read_prefix = "";
+  if(1 != fwrite(read_prefix, strlen(read_prefix) + 1, 1, fp)) return 0;
+  if(0 != fseek(fp, 0, SEEK_SET) || 1 != fwrite(&h, sizeof(store_header_t), 1, fp)) return 0;
+  return 1;
+}
+
+uint8_t *
+store_put_pair(uint8_t *q, const sink_pair_t *p, int32_t block_start)
+{
+  int32_t j;
+  q = store_put_u(q, p->contig_i + 1); // zero for random reads
+  q = store_put_u(q, p->id);
+  *q++ = (p->strand[0] & 1) | ((p->strand[1] & 1) << 1) | ((p->is_rand & 1) << 2) | ((p->hap & 1) << 3) | ((block_start & 1) << 4);
+  for(j = 0; j < 2; j++) {
+      q = store_put_u(q, p->pos[j]);
+      q = store_put_i(q, p->n_err[j]);
+      q = store_put_i(q, p->n_sub[j]);
+      q = store_put_i(q, p->n_indel[j]);
+      q = store_put_i(q, p->n_err_first[j]);
+      q = store_put_i(q, p->n_sub_first[j]);
+      q = store_put_i(q, p->n_indel_first[j]);
+  }
+  return q;
+}
+
+uint8_t *
+store_put_end(uint8_t *q, const uint8_t *seq, const char *qstr, int32_t len)
+{
+  int32_t i, n, prev;
+
+  q = store_put_u(q, len);
+  // the bases, then the Ns
+  memset(q, 0, (len + 3) >> 2);
+  for(i = n = 0; i < len; i++) {
+      if(3 < seq[i]) n++;
+      else q[i >> 2] |= seq[i] << ((i & 3) << 1);
+  }
+  q += (len + 3) >> 2;
+  q = store_put_u(q, n);
+  for(i = 0, prev = 0; 0 < n && i < len; i++) {
+      if(3 < seq[i]) {
+          q = store_put_u(q, i - prev);
+          prev = i;
+          n--;
+      }
+  }
+  // the base qualities, as runs
+  for(i = n = 0; i < len; i++) {
+      if(0 == i || qstr[i] != qstr[i-1]) n++;
+  }
+  q = store_put_u(q, n);
+  for(i = 0; i < len; i += n) {
+      for(n = 1; i + n < len && qstr[i + n] == qstr[i]; n++);
+      *q++ = qstr[i];
+      q = store_put_u(q, n);
+  }
+  return q;
+}
+
+store_t *
+store_open(const char *fn)
+{
+  store_t *s = NULL;
+  struct stat st;
+  const char *p, *q, *end;
+  int32_t i;
+  int fd;
+
+  fd = open(fn, O_RDONLY);
+  if(fd < 0 || 0 != fstat(fd, &st)) {
+      fprintf(stderr, "[store] could not open %s\n", fn);
+      exit(1);
+  }
+  s = calloc(1, sizeof(store_t));
+  s->size = st.st_size;
+  if(s->size < sizeof(store_header_t)) {
+      fprintf(stderr, "[store] %s is not a read store\n", fn);
+      exit(1);
+  }
+  s->data = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(MAP_FAILED == s->data) {
+      fprintf(stderr, "[store] could not map %s\n", fn);
+      exit(1);
+  }
+  madvise((void*)s->data, s->size, MADV_SEQUENTIAL);
+  s->header = (const store_header_t*)s->data;
+  if(0 != memcmp(s->header->magic, STORE_MAGIC, 4) || STORE_VERSION != s->header->version
+     || s->header->names_offset < sizeof(store_header_t) || s->size < s->header->names_offset) {
+      fprintf(stderr, "[store] %s is not a read store, or is incomplete\n", fn);
+      exit(1);
+  }
+  s->p = s->data + sizeof(store_header_t);
+  s->end = s->data + s->header->names_offset;
+
+  // the contig names, then the read prefix
+  s->names = calloc(s->header->n_contigs + 1, sizeof(char*));
+  p = (const char*)s->end;
+  end = (const char*)s->data + s->size;
+  for(i=0;i<=s->header->n_contigs;i++) {
+      q = memchr(p, '\0', end - p);
+      if(NULL == q) store_truncated();
+      if(i < s->header->n_contigs) s->names[i] = strdup(p);
+      else if(p < q) s->read_prefix = strdup(p);
+      p = q + 1;
+  }
+  return s;
+}
+
+void
+store_close(store_t *s)
+{
+  int32_t i;
+  if(NULL == s) return;
+  for(i=0;i<s->header->n_contigs;i++) {
+      free(s->names[i]);
+  }
+  free(s->names);
+  free(s->read_prefix);
+  munmap((void*)s->data, s->size);
+  free(s);
+}
+
+// decodes an end into "seq" and "qstr" (at least "len" bytes)
+static void
+store_get_end(store_t *s, uint8_t *seq, char *qstr, int32_t len)
+{
+  int32_t i, n, k, run;
+  const uint8_t *b = s->p;
+
+  if(s->end < s->p + ((len + 3) >> 2)) store_truncated();
+  for(i = 0; i < len; i++) {
+      seq[i] = (b[i >> 2] >> ((i & 3) << 1)) & 3;
+  }
+  s->p += (len + 3) >> 2;
+  n = store_get_u(s);
+  for(i = k = 0; i < n; i++) {
+      k += store_get_u(s);
+      if(len <= k) store_truncated();
+      seq[k] = 4;
+  }
+  n = store_get_u(s);
+  for(i = k = 0; i < n; i++) {
+      if(s->end <= s->p) store_truncated();
+      char c = *s->p++;
+      run = store_get_u(s);
+      if(len < k + run) store_truncated();
+      memset(qstr + k, c, run);
+      k += run;
+  }
+  if(k != len) store_truncated();
+}
+
+int32_t
+store_next(store_t *s, sink_pair_t *p, uint8_t **seq, char **qstr, int32_t *len, int32_t *m)
+{
+  int32_t j, flags, contig;
+
+  if(s->end <= s->p) return 0;
+
+  memset(p, 0, sizeof(sink_pair_t));
+  contig = store_get_u(s);
+  if(s->header->n_contigs < contig) store_truncated();
+  p->contig_i = contig - 1;
+  p->contig = (0 == contig) ? "rand" : s->names[contig - 1];
+  p->id = store_get_u(s);
+  if(s->end <= s->p) store_truncated();
+  flags = *s->p++;
+  p->strand[0] = flags & 1;
+  p->strand[1] = (flags >> 1) & 1;
+  p->is_rand = (flags >> 2) & 1;
+  p->hap = (flags >> 3) & 1;
+  s->block_start = (flags >> 4) & 1;
+  for(j = 0; j < 2; j++) {
+      p->pos[j] = store_get_u(s);
+      p->n_err[j] = store_get_i(s);
+      p->n_sub[j] = store_get_i(s);
+      p->n_indel[j] = store_get_i(s);
+      p->n_err_first[j] = store_get_i(s);
+      p->n_sub_first[j] = store_get_i(s);
+      p->n_indel_first[j] = store_get_i(s);
+  }
+  p->read_id = s->n++;
+
+  for(j = 0; j < 1 + s->header->is_paired; j++) {
+      len[j] = store_get_u(s);
+      if(m[j] < len[j] + 1) {
+          m[j] = len[j] + 1;
+          seq[j] = realloc(seq[j], m[j]);
+          qstr[j] = realloc(qstr[j], m[j]);
+      }
+      store_get_end(s, seq[j], qstr[j], len[j]);
+      qstr[j][len[j]] = '\0';
+  }
+  return 1;
+}
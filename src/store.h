@@ -0,0 +1,108 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sink.h"
+
+/* The binary read store (the "store" sink): every read pair as simulated,
+ * so that "dwgsim replay" can write it again to any other sink without
+ * simulating.  The file is the header, the read pairs in output order, then
+ * the contig names and the read prefix (each NUL-terminated) at
+ * "names_offset".  Each read pair is its truth (as the read name, including
+ * the SOLiD first-color counts) followed by each end:
+ *   the length
+ *   the bases (or colors) packed two bits each, with the positions of any
+ *   Ns (value 4) listed after them
+ *   the base qualities, run-length encoded
+ * A flag marks the first read pair of each block of the simulation, so that
+ * replay compresses the same blocks.  Integers in a read pair are unsigned
+ * LEB128 varints; the header is in the native byte order, checked with the
+ * magic. */
+
+#define STORE_MAGIC "DWGR"
+#define STORE_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t data_type; /* ILLUMINA, SOLID or IONTORRENT */
+    int32_t is_paired;
+    uint64_t names_offset; /* the contig names, then the read prefix */
+    int32_t n_contigs;
+    int32_t reserved;
+} store_header_t;
+
+typedef struct {
+    const uint8_t *data; /* the memory-mapped file */
+    size_t size;
+    const store_header_t *header;
+    char **names; /* the contig names */
+    char *read_prefix; /* NULL if none */
+    const uint8_t *p, *end; /* the next read pair and the end of the read pairs */
+    uint64_t n; /* the read pairs decoded so far */
+    int32_t block_start; /* 1 if the last read pair decoded began a block */
+} store_t;
+
+// the most bytes written by store_put_pair, and by store_put_end for an end
+// of "len" bases
+#define STORE_MAX_PAIR 128
+#define store_max_end(_len) (16 + 12 * (size_t)(_len))
+
+// writes a header to be completed by store_end
+int32_t
+store_begin(FILE *fp, int32_t data_type, int32_t is_paired);
+
+// appends the contig names and the read prefix (or NULL), and completes the
+// header; returns 1 on success
+int32_t
+store_end(FILE *fp, int32_t data_type, int32_t is_paired, char **names, int32_t n_contigs, const char *read_prefix);
+
+// encodes the truth of a read pair at "q", returning the end; "block_start"
+// is 1 for the first read pair of a block
+uint8_t *
+store_put_pair(uint8_t *q, const sink_pair_t *p, int32_t block_start);
+
+// encodes an end at "q", with "len" bases (0-4) and qualities, returning the
+// end
+uint8_t *
+store_put_end(uint8_t *q, const uint8_t *seq, const char *qstr, int32_t len);
+
+store_t *
+store_open(const char *fn);
+
+void
+store_close(store_t *s);
+
+// decodes the next read pair into "p", and its ends into "seq", "qstr" and
+// "len", growing the buffers (of "m" bytes) as needed; returns 0 if there
+// are no more read pairs
+int32_t
+store_next(store_t *s, sink_pair_t *p, uint8_t **seq, char **qstr, int32_t *len, int32_t *m);
+
+#endif
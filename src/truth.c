@@ -0,0 +1,420 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+#include "contigs.h"
+#include "gzi.h"
+#include "truth.h"
+
+// the uncompressed BAM compressed at once, a multiple of the BGZF block size
+#define TRUTH_BGZF_BATCH (0xff00 * 64)
+
+// a record in memory: its sort key (the reference id then the position,
+// unmapped last) and its offset
+typedef struct {
+    uint64_t key;
+    size_t offset;
+} truth_rec_t;
+
+// a sorted run being merged: spilled to a file, or the records in memory
+typedef struct {
+    FILE *fp;
+    const truth_rec_t *recs;
+    size_t i, n;
+    uint8_t *rec; // the current record, from the file
+    size_t m;
+    uint64_t key;
+    int32_t is_done;
+} truth_run_t;
+
+static inline uint32_t
+truth_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t
+truth_u16(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+// the sort key of a record, without its block size
+#define __truth_key(_b) (((uint64_t)truth_u32(_b) << 32) | truth_u32((_b) + 4))
+
+static void
+truth_fwrite(FILE *fp, const void *buf, size_t l)
+{
+  if(0 < l && l != fwrite(buf, 1, l, fp)) {
+      fprintf(stderr, "[truth] could not write to the output file\n");
+      exit(1);
+  }
+}
+
+static FILE *
+truth_fopen(const char *fn, const char *mode, size_t buffer_size)
+{
+  FILE *fp = fopen(fn, mode);
+  if(NULL == fp) {
+      fprintf(stderr, "[truth] could not open %s\n", fn);
+      exit(1);
+  }
+  setvbuf(fp, NULL, _IOFBF, buffer_size);
+  return fp;
+}
+
+truth_t *
+truth_init(const char *fn_bam, const char *fn_sam, const char *fn_tmp, int32_t compress_level, size_t buffer_size)
+{
+  truth_t *t = calloc(1, sizeof(truth_t));
+  if(NULL != fn_bam) t->fp_bam = truth_fopen(fn_bam, "w", buffer_size);
+  if(NULL != fn_sam) t->fp_sam = truth_fopen(fn_sam, "w", buffer_size);
+  t->compress_level = (compress_level < 0) ? Z_DEFAULT_COMPRESSION : compress_level;
+  t->fn_tmp = strdup(fn_tmp);
+  t->contigs = contigs_init();
+  return t;
+}
+
+void
+truth_set_contigs(truth_t *t, const contigs_t *contigs)
+{
+  int32_t i;
+  contigs_destroy(t->contigs);
+  t->contigs = contigs_init();
+  for(i=0;i<contigs->n;i++) {
+      contigs_add(t->contigs, contigs->contigs[i].name, contigs->contigs[i].len);
+  }
+}
+
+static int
+truth_rec_cmp(const void *a, const void *b)
+{
+  const truth_rec_t *x = (const truth_rec_t*)a, *y = (const truth_rec_t*)b;
+  if(x->key != y->key) return (x->key < y->key) ? -1 : 1;
+  return (x->offset < y->offset) ? -1 : ((x->offset > y->offset) ? 1 : 0);
+}
+
+// the records in memory, sorted
+static truth_rec_t *
+truth_sort(const truth_t *t, size_t *n)
+{
+  truth_rec_t *recs = NULL;
+  size_t i, m = 0;
+
+  *n = 0;
+  for(i = 0; i < t->l; i += 4 + truth_u32(t->buf + i)) {
+      if(*n == m) {
+          m = (m < 1024) ? 1024 : m << 1;
+          recs = realloc(recs, m * sizeof(truth_rec_t));
+      }
+      recs[*n].key = __truth_key(t->buf + i + 4);
+      recs[*n].offset = i;
+      (*n)++;
+  }
+  qsort(recs, *n, sizeof(truth_rec_t), truth_rec_cmp);
+  return recs;
+}
+
+static char *
+truth_tmp_name(const truth_t *t, int32_t i)
+{
+  char *fn = malloc(strlen(t->fn_tmp) + 32);
+  sprintf(fn, "%s.%d", t->fn_tmp, i);
+  return fn;
+}
+
+// writes the records in memory to a temporary file, sorted
+static void
+truth_spill(truth_t *t)
+{
+  truth_rec_t *recs;
+  size_t i, n;
+  char *fn;
+  FILE *fp;
+
+  recs = truth_sort(t, &n);
+  fn = truth_tmp_name(t, t->n_tmp);
+  fp = truth_fopen(fn, "w", (size_t)1 << 20);
+  for(i=0;i<n;i++) {
+      truth_fwrite(fp, t->buf + recs[i].offset, 4 + truth_u32(t->buf + recs[i].offset));
+  }
+  if(0 != fclose(fp)) {
+      fprintf(stderr, "[truth] could not write to %s\n", fn);
+      exit(1);
+  }
+  free(fn);
+  free(recs);
+  t->n_tmp++;
+  t->l = 0;
+}
+
+void
+truth_add(truth_t *t, const uint8_t *recs, size_t l)
+{
+  if(t->m < t->l + l) {
+      t->m = t->l + l;
+      if(t->m < TRUTH_MAX_MEM) t->m = TRUTH_MAX_MEM;
+      t->buf = realloc(t->buf, t->m);
+  }
+  memcpy(t->buf + t->l, recs, l);
+  t->l += l;
+  if(TRUTH_MAX_MEM <= t->l) truth_spill(t);
+}
+
+// moves to the next record of the run, with its block size in run->rec
+static void
+truth_run_next(const truth_t *t, truth_run_t *run)
+{
+  uint8_t l[4];
+  size_t n;
+
+  if(NULL == run->fp) { // in memory
+      if(run->n <= run->i) {
+          run->is_done = 1;
+          return;
+      }
+      run->rec = t->buf + run->recs[run->i].offset;
+      run->key = run->recs[run->i].key;
+      run->i++;
+      return;
+  }
+  if(1 != fread(l, 4, 1, run->fp)) {
+      run->is_done = 1;
+      return;
+  }
+  n = truth_u32(l);
+  if(run->m < n + 4) {
+      run->m = (n + 4) << 1;
+      run->rec = realloc(run->rec, run->m);
+  }
+  memcpy(run->rec, l, 4);
+  if(n != fread(run->rec + 4, 1, n, run->fp)) {
+      fprintf(stderr, "[truth] could not read a temporary file\n");
+      exit(1);
+  }
+  run->key = __truth_key(run->rec + 4);
+}
+
+// compresses and writes the BAM batched so far
+static void
+truth_flush_bam(truth_t *t, uint8_t *batch, size_t *l)
+{
+  char *out;
+  size_t out_l;
+  out = gzi_deflate((char*)batch, *l, t->compress_level, &out_l);
+  truth_fwrite(t->fp_bam, out, out_l);
+  free(out);
+  *l = 0;
+}
+
+static const char *
+truth_ref_name(const truth_t *t, int32_t ref)
+{
+  return (0 <= ref && ref < t->contigs->n) ? t->contigs->contigs[ref].name : "*";
+}
+
+// writes a record (without its block size) as a SAM line
+static void
+truth_write_sam(const truth_t *t, const uint8_t *b, size_t l)
+{
+  static const char *nt16 = "=ACMGRSVTWYHKDBN";
+  FILE *fp = t->fp_sam;
+  const uint8_t *p = b + 32, *end = b + l;
+  int32_t ref = (int32_t)truth_u32(b), mref = (int32_t)truth_u32(b + 20);
+  uint32_t n_cigar = truth_u16(b + 12), l_seq = truth_u32(b + 16), i, c;
+
+  fprintf(fp, "%s\t%u\t%s\t%d\t%u\t", (const char*)p, truth_u16(b + 14), truth_ref_name(t, ref), (int32_t)truth_u32(b + 4) + 1, b[9]);
+  p += b[8];
+  if(0 == n_cigar) fputc('*', fp);
+  for(i = 0; i < n_cigar; i++, p += 4) {
+      c = truth_u32(p);
+      fprintf(fp, "%u%c", c >> 4, "MIDNSHP=X"[c & 0xf]);
+  }
+  fprintf(fp, "\t%s\t%d\t%d\t", (mref < 0) ? "*" : ((mref == ref) ? "=" : truth_ref_name(t, mref)),
+          (int32_t)truth_u32(b + 24) + 1, (int32_t)truth_u32(b + 28));
+  if(0 == l_seq) fputc('*', fp);
+  for(i = 0; i < l_seq; i++) {
+      fputc(nt16[(p[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xf], fp);
+  }
+  p += (l_seq + 1) >> 1;
+  fputc('\t', fp);
+  if(0 == l_seq || 0xff == p[0]) fputc('*', fp);
+  else {
+      for(i = 0; i < l_seq; i++) fputc(p[i] + 33, fp);
+  }
+  p += l_seq;
+  // the tags
+  while(p < end) {
+      fprintf(fp, "\t%c%c:", p[0], p[1]);
+      switch(p[2]) {
+        case 'A': fprintf(fp, "A:%c", p[3]); p += 4; break;
+        case 'c': fprintf(fp, "i:%d", (int8_t)p[3]); p += 4; break;
+        case 'C': fprintf(fp, "i:%u", p[3]); p += 4; break;
+        case 's': fprintf(fp, "i:%d", (int16_t)truth_u16(p + 3)); p += 5; break;
+        case 'S': fprintf(fp, "i:%u", truth_u16(p + 3)); p += 5; break;
+        case 'i': fprintf(fp, "i:%d", (int32_t)truth_u32(p + 3)); p += 7; break;
+        case 'I': fprintf(fp, "i:%u", truth_u32(p + 3)); p += 7; break;
+        case 'Z': fprintf(fp, "Z:%s", (const char*)(p + 3)); p += 4 + strlen((const char*)(p + 3)); break;
+        default:
+                  fprintf(stderr, "[truth] unknown tag type: %c\n", p[2]);
+                  exit(1);
+      }
+  }
+  fputc('\n', fp);
+}
+
+// the BAM header, appended to "batch", and the SAM header
+static void
+truth_write_header(truth_t *t, uint8_t **batch, size_t *l, size_t *m)
+{
+  size_t n, i, k;
+  char *text, *q;
+  uint8_t *p;
+
+  n = 128;
+  for(i=0;i<t->contigs->n;i++) {
+      n += strlen(t->contigs->contigs[i].name) + 32;
+  }
+  text = q = malloc(n);
+  q += sprintf(q, "@HD\tVN:1.6\tSO:coordinate\n");
+  for(i=0;i<t->contigs->n;i++) {
+      q += sprintf(q, "@SQ\tSN:%s\tLN:%d\n", t->contigs->contigs[i].name, t->contigs->contigs[i].len);
+  }
+  q += sprintf(q, "@PG\tID:dwgsim\tPN:dwgsim\tVN:%s\n", PACKAGE_VERSION);
+  n = q - text;
+
+  if(NULL != t->fp_sam) truth_fwrite(t->fp_sam, text, n);
+  if(NULL != t->fp_bam) {
+      k = 12 + n;
+      for(i=0;i<t->contigs->n;i++) {
+          k += 9 + strlen(t->contigs->contigs[i].name);
+      }
+      if(*m < k) {
+          *m = k;
+          *batch = realloc(*batch, *m);
+      }
+      p = *batch;
+      memcpy(p, "BAM\1", 4); p += 4;
+      p[0] = n & 0xff; p[1] = (n >> 8) & 0xff; p[2] = (n >> 16) & 0xff; p[3] = n >> 24; p += 4;
+      memcpy(p, text, n); p += n;
+      n = t->contigs->n;
+      p[0] = n & 0xff; p[1] = (n >> 8) & 0xff; p[2] = (n >> 16) & 0xff; p[3] = n >> 24; p += 4;
+      for(i=0;i<t->contigs->n;i++) {
+          n = strlen(t->contigs->contigs[i].name) + 1;
+          p[0] = n & 0xff; p[1] = (n >> 8) & 0xff; p[2] = (n >> 16) & 0xff; p[3] = n >> 24; p += 4;
+          memcpy(p, t->contigs->contigs[i].name, n); p += n;
+          n = t->contigs->contigs[i].len;
+          p[0] = n & 0xff; p[1] = (n >> 8) & 0xff; p[2] = (n >> 16) & 0xff; p[3] = n >> 24; p += 4;
+      }
+      *l = p - *batch;
+  }
+  free(text);
+}
+
+void
+truth_destroy(truth_t *t)
+{
+  truth_rec_t *recs;
+  truth_run_t *runs, *run;
+  int32_t i, n_runs;
+  uint8_t *batch = NULL;
+  size_t n, l = 0, m = 0;
+  char *fn;
+
+  if(NULL == t) return;
+
+  // the spilled runs, then the records still in memory
+  n_runs = t->n_tmp + 1;
+  runs = calloc(n_runs, sizeof(truth_run_t));
+  for(i=0;i<t->n_tmp;i++) {
+      fn = truth_tmp_name(t, i);
+      runs[i].fp = truth_fopen(fn, "r", (size_t)1 << 20);
+      free(fn);
+      truth_run_next(t, &runs[i]);
+  }
+  recs = truth_sort(t, &n);
+  runs[t->n_tmp].recs = recs;
+  runs[t->n_tmp].n = n;
+  truth_run_next(t, &runs[t->n_tmp]);
+
+  truth_write_header(t, &batch, &l, &m);
+  if(m < TRUTH_BGZF_BATCH) {
+      m = TRUTH_BGZF_BATCH;
+      batch = realloc(batch, m);
+  }
+
+  // merge, taking the earliest run on ties
+  while(1) {
+      run = NULL;
+      for(i=0;i<n_runs;i++) {
+          if(0 == runs[i].is_done && (NULL == run || runs[i].key < run->key)) run = &runs[i];
+      }
+      if(NULL == run) break;
+      n = 4 + truth_u32(run->rec);
+      if(NULL != t->fp_bam) {
+          if(m < l + n) {
+              truth_flush_bam(t, batch, &l);
+              if(m < n) {
+                  m = n;
+                  batch = realloc(batch, m);
+              }
+          }
+          memcpy(batch + l, run->rec, n);
+          l += n;
+      }
+      if(NULL != t->fp_sam) truth_write_sam(t, run->rec + 4, n - 4);
+      truth_run_next(t, run);
+  }
+
+  if(NULL != t->fp_bam) {
+      truth_flush_bam(t, batch, &l);
+      if(1 != gzi_write_eof(t->fp_bam) || 0 != fclose(t->fp_bam)) {
+          fprintf(stderr, "[truth] could not write to the output file\n");
+          exit(1);
+      }
+  }
+  if(NULL != t->fp_sam && 0 != fclose(t->fp_sam)) {
+      fprintf(stderr, "[truth] could not write to the output file\n");
+      exit(1);
+  }
+  for(i=0;i<t->n_tmp;i++) {
+      fclose(runs[i].fp);
+      free(runs[i].rec);
+      fn = truth_tmp_name(t, i);
+      remove(fn);
+      free(fn);
+  }
+  free(runs);
+  free(recs);
+  free(batch);
+  contigs_destroy(t->contigs);
+  free(t->fn_tmp);
+  free(t->buf);
+  free(t);
+}
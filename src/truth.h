@@ -0,0 +1,71 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef TRUTH_H
+#define TRUTH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "contigs.h"
+
+/* The truth alignments, sorted by coordinate.  The BAM records arrive in
+ * generation order; they are kept in memory and, past TRUTH_MAX_MEM bytes,
+ * sorted and spilled to temporary files next to the output.  On
+ * truth_destroy the sorted runs are merged into a BAM (BGZF-compressed)
+ * and/or a SAM, whose header lists the contigs given by truth_set_contigs.
+ * Records with the same coordinate keep their generation order, and
+ * unmapped (random) reads come last. */
+
+#define TRUTH_MAX_MEM ((size_t)256 << 20)
+
+typedef struct {
+    FILE *fp_bam, *fp_sam; /* NULL unless enabled */
+    int32_t compress_level; /* the BGZF level of the BAM */
+    char *fn_tmp; /* the prefix of the temporary files */
+    int32_t n_tmp; /* the number of sorted runs spilled so far */
+    uint8_t *buf; /* the records in memory */
+    size_t l, m; /* length and maximum buffer size */
+    contigs_t *contigs; /* the header */
+} truth_t;
+
+// opens the output files (either may be NULL), spilling to files named after
+// "fn_tmp"
+truth_t *
+truth_init(const char *fn_bam, const char *fn_sam, const char *fn_tmp, int32_t compress_level, size_t buffer_size);
+
+// copies the contigs listed in the header; the BAM reference ids are their
+// indexes
+void
+truth_set_contigs(truth_t *t, const contigs_t *contigs);
+
+// adds "l" bytes of BAM records (each with its block size)
+void
+truth_add(truth_t *t, const uint8_t *recs, size_t l);
+
+// merges the sorted records into the output files, and closes them
+void
+truth_destroy(truth_t *t);
+
+#endif
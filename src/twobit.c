@@ -0,0 +1,436 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+#include "refseq.h"
+#include "fai.h"
+#include "twobit.h"
+
+#define TWOBIT_UCSC_MAGIC 0x1A412743
+#define TWOBIT_CACHE_MAGIC "DWGSIM2B"
+#define TWOBIT_CACHE_VERSION 1
+#define TWOBIT_CACHE_HEADER 40 // magic, version, #contigs, FASTA size and time, table offset
+#define TWOBIT_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+#define __twobit_swap32(_x) ((((_x) & 0xFF) << 24) | (((_x) & 0xFF00) << 8) | (((_x) >> 8) & 0xFF00) | (((_x) >> 24) & 0xFF))
+
+// UCSC packs four bases per byte (T=0, C=1, A=2, G=3) with the first base in
+// the high bits; this maps a byte to the same four bases in refseq order
+static uint8_t twobit_ucsc_table[256];
+
+static void
+twobit_ucsc_table_init()
+{
+  static const uint8_t base[4] = {3, 1, 0, 2};
+  int32_t i, k;
+  for(i=0;i<256;i++) {
+      twobit_ucsc_table[i] = 0;
+      for(k=0;k<4;k++) {
+          twobit_ucsc_table[i] |= base[(i >> (6 - (k << 1))) & 3] << (k << 1);
+      }
+  }
+}
+
+static uint64_t
+twobit_checksum(uint64_t h, const uint8_t *p, uint64_t n_words)
+{
+  uint64_t i, w;
+  for(i=0;i<n_words;i++) {
+      memcpy(&w, p + (i << 3), sizeof(uint64_t));
+      h = (h ^ w) * 0x100000001b3ULL;
+      h ^= h >> 31;
+  }
+  return h;
+}
+
+static const uint8_t *
+twobit_map(int fd, size_t *size)
+{
+  struct stat st;
+  void *data;
+  if(0 != fstat(fd, &st) || 0 == st.st_size) return NULL;
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(MAP_FAILED == data) return NULL;
+  (*size) = st.st_size;
+  return data;
+}
+
+// is [offset,offset+n) within the file?
+#define __twobit_in_file(_tb, _offset, _n) ((uint64_t)(_offset) <= (_tb)->size && (uint64_t)(_n) <= (_tb)->size - (uint64_t)(_offset))
+
+static uint32_t
+twobit_u32(const twobit_t *tb, uint64_t offset)
+{
+  uint32_t v;
+  if(!__twobit_in_file(tb, offset, sizeof(uint32_t))) {
+      fprintf(stderr, "Error: truncated .2bit file\n");
+      exit(1);
+  }
+  memcpy(&v, tb->data + offset, sizeof(uint32_t));
+  return (1 == tb->swap) ? __twobit_swap32(v) : v;
+}
+
+int32_t
+twobit_is_ucsc(FILE *fp)
+{
+  uint32_t magic = 0;
+  int32_t ret = 0;
+  if(1 == fread(&magic, sizeof(uint32_t), 1, fp)) {
+      ret = (TWOBIT_UCSC_MAGIC == magic || TWOBIT_UCSC_MAGIC == __twobit_swap32(magic)) ? 1 : 0;
+  }
+  rewind(fp);
+  return ret;
+}
+
+twobit_t *
+twobit_init(FILE *fp)
+{
+  twobit_t *tb = NULL;
+  twobit_contig_t *c = NULL;
+  uint32_t magic, version, i, n_blocks, n_masks;
+  uint64_t p, offset;
+
+  tb = calloc(1, sizeof(twobit_t));
+  tb->format = TWOBIT_UCSC;
+  tb->data = twobit_map(fileno(fp), &tb->size);
+  if(NULL == tb->data || tb->size < 16) {
+      fprintf(stderr, "Error: could not read the .2bit file\n");
+      exit(1);
+  }
+  memcpy(&magic, tb->data, sizeof(uint32_t));
+  tb->swap = (TWOBIT_UCSC_MAGIC == magic) ? 0 : 1;
+  version = twobit_u32(tb, 4);
+  if(1 < version) {
+      fprintf(stderr, "Error: unsupported .2bit version [%u]\n", version);
+      exit(1);
+  }
+  tb->n = twobit_u32(tb, 8);
+  tb->contigs = calloc(tb->n, sizeof(twobit_contig_t));
+
+  twobit_ucsc_table_init();
+  for(i = 0, p = 16; i < tb->n; i++) {
+      c = &tb->contigs[i];
+      if(!__twobit_in_file(tb, p, 1) || !__twobit_in_file(tb, p + 1, tb->data[p])) {
+          fprintf(stderr, "Error: truncated .2bit file\n");
+          exit(1);
+      }
+      c->name = strndup((const char*)tb->data + p + 1, tb->data[p]);
+      p += 1 + tb->data[p];
+      if(0 == version) { // 32-bit offsets
+          offset = twobit_u32(tb, p);
+          p += 4;
+      }
+      else { // 64-bit offsets
+          offset = (tb->swap) ? ((uint64_t)twobit_u32(tb, p) << 32) | twobit_u32(tb, p + 4) : ((uint64_t)twobit_u32(tb, p + 4) << 32) | twobit_u32(tb, p);
+          p += 8;
+      }
+      // the record: length, N blocks, mask blocks, reserved, packed bases
+      c->len = twobit_u32(tb, offset);
+      n_blocks = twobit_u32(tb, offset + 4);
+      c->n_runs = n_blocks;
+      c->runs_offset = offset + 8;
+      n_masks = twobit_u32(tb, c->runs_offset + 8 * (uint64_t)n_blocks);
+      c->seq_offset = c->runs_offset + 8 * (uint64_t)n_blocks + 4 + 8 * (uint64_t)n_masks + 4;
+      if(c->len < 0 || !__twobit_in_file(tb, c->seq_offset, ((uint64_t)c->len + 3) >> 2)) {
+          fprintf(stderr, "Error: truncated .2bit file [%s]\n", c->name);
+          exit(1);
+      }
+  }
+  return tb;
+}
+
+void
+twobit_destroy(twobit_t *tb)
+{
+  int32_t i;
+  if(NULL == tb) return;
+  if(NULL != tb->data) munmap((void*)tb->data, tb->size);
+  for(i=0;i<tb->n;i++) {
+      free(tb->contigs[i].name);
+  }
+  free(tb->contigs);
+  free(tb);
+}
+
+void
+twobit_read(const twobit_t *tb, int32_t i, refseq_t *r)
+{
+  const twobit_contig_t *c = &tb->contigs[i];
+  refseq_runs_t runs;
+  int32_t j, k;
+  uint32_t start, size;
+  uint64_t w, n_words = ((uint64_t)c->len + 31) >> 5;
+
+  refseq_alloc(r, c->len);
+  memset(&runs, 0, sizeof(refseq_runs_t));
+
+  if(TWOBIT_CACHE == tb->format) { // already in refseq order
+      memcpy(r->s, tb->data + c->seq_offset, sizeof(uint64_t) * n_words);
+      runs.n = runs.m = c->n_runs;
+      runs.start = (uint32_t*)(tb->data + c->runs_offset);
+      runs.end = runs.start + c->n_runs;
+      refseq_add_runs(r, &runs);
+      return;
+  }
+
+  // UCSC: convert eight bytes to a word
+  const uint8_t *dna = tb->data + c->seq_offset;
+  uint64_t n_bytes = ((uint64_t)c->len + 3) >> 2, b;
+  for(w = 0, b = 0; w < n_words; w++) {
+      uint64_t word = 0;
+      for(k = 0; k < 8 && b < n_bytes; k++, b++) {
+          word |= (uint64_t)twobit_ucsc_table[dna[b]] << (k << 3);
+      }
+      r->s[w] = word;
+  }
+  if(0 != (c->len & 31)) { // clear the padding
+      r->s[n_words-1] &= ((uint64_t)1 << ((c->len & 31) << 1)) - 1;
+  }
+  // N blocks
+  runs.start = malloc(sizeof(uint32_t) * (c->n_runs + 1));
+  runs.end = malloc(sizeof(uint32_t) * (c->n_runs + 1));
+  for(j = 0; j < c->n_runs; j++) {
+      start = twobit_u32(tb, c->runs_offset + 4 * (uint64_t)j);
+      size = twobit_u32(tb, c->runs_offset + 4 * ((uint64_t)c->n_runs + j));
+      if((uint32_t)c->len <= start || 0 == size) continue;
+      if((uint32_t)c->len - start < size) size = c->len - start;
+      if(0 < runs.n && start < runs.end[runs.n-1]) {
+          fprintf(stderr, "Error: unsorted N blocks in the .2bit file [%s]\n", c->name);
+          exit(1);
+      }
+      runs.start[runs.n] = start;
+      runs.end[runs.n] = start + size;
+      runs.n++;
+  }
+  refseq_add_runs(r, &runs);
+  free(runs.start);
+  free(runs.end);
+}
+
+int64_t
+twobit_n_bases(const twobit_t *tb, int32_t i)
+{
+  const twobit_contig_t *c = &tb->contigs[i];
+  int32_t j;
+  uint32_t start, end;
+  int64_t n = 0;
+
+  for(j = 0; j < c->n_runs; j++) {
+      start = twobit_u32(tb, c->runs_offset + 4 * (uint64_t)j);
+      end = twobit_u32(tb, c->runs_offset + 4 * ((uint64_t)c->n_runs + j));
+      if(TWOBIT_UCSC == tb->format) { // the size
+          if((uint32_t)c->len <= start) continue;
+          end = ((uint32_t)c->len - start < end) ? (uint32_t)c->len : start + end;
+      }
+      if(start < end) n += end - start;
+  }
+  return n;
+}
+
+twobit_t *
+twobit_cache_open(const char *fn_cache, FILE *fp_fa)
+{
+  twobit_t *tb = NULL;
+  twobit_contig_t *c = NULL;
+  struct stat st;
+  uint32_t version, name_len, n_runs;
+  uint64_t fa_size, table_offset, p, h, checksum;
+  int64_t fa_mtime;
+  int32_t i, len, fd;
+
+  if(0 != fstat(fileno(fp_fa), &st) || !S_ISREG(st.st_mode)) return NULL;
+  fd = open(fn_cache, O_RDONLY);
+  if(fd < 0) return NULL;
+  tb = calloc(1, sizeof(twobit_t));
+  tb->format = TWOBIT_CACHE;
+  tb->data = twobit_map(fd, &tb->size);
+  close(fd);
+  if(NULL == tb->data || tb->size < TWOBIT_CACHE_HEADER + 8 || 0 != (tb->size & 7)
+     || 0 != memcmp(tb->data, TWOBIT_CACHE_MAGIC, 8)) {
+      twobit_destroy(tb);
+      return NULL;
+  }
+  memcpy(&version, tb->data + 8, sizeof(uint32_t));
+  memcpy(&tb->n, tb->data + 12, sizeof(int32_t));
+  memcpy(&fa_size, tb->data + 16, sizeof(uint64_t));
+  memcpy(&fa_mtime, tb->data + 24, sizeof(int64_t));
+  memcpy(&table_offset, tb->data + 32, sizeof(uint64_t));
+  if(TWOBIT_CACHE_VERSION != version || tb->n < 0
+     || (uint64_t)st.st_size != fa_size || (int64_t)st.st_mtime != fa_mtime) { // out of date
+      tb->n = 0;
+      twobit_destroy(tb);
+      return NULL;
+  }
+  // the checksum covers the body and then the header
+  h = twobit_checksum(TWOBIT_CHECKSUM_SEED, tb->data + TWOBIT_CACHE_HEADER, (tb->size - TWOBIT_CACHE_HEADER - 8) >> 3);
+  h = twobit_checksum(h, tb->data, TWOBIT_CACHE_HEADER >> 3);
+  memcpy(&checksum, tb->data + tb->size - 8, sizeof(uint64_t));
+  if(h != checksum) {
+      tb->n = 0;
+      twobit_destroy(tb);
+      return NULL;
+  }
+  // the contig table
+  tb->contigs = calloc(tb->n, sizeof(twobit_contig_t));
+  for(i = 0, p = table_offset; i < tb->n; i++) {
+      c = &tb->contigs[i];
+      if(!__twobit_in_file(tb, p, 32)) break;
+      memcpy(&name_len, tb->data + p, sizeof(uint32_t));
+      memcpy(&len, tb->data + p + 4, sizeof(int32_t));
+      memcpy(&n_runs, tb->data + p + 8, sizeof(uint32_t));
+      memcpy(&c->seq_offset, tb->data + p + 16, sizeof(uint64_t));
+      memcpy(&c->runs_offset, tb->data + p + 24, sizeof(uint64_t));
+      p += 32;
+      if(!__twobit_in_file(tb, p, name_len) || len < 0
+         || !__twobit_in_file(tb, c->seq_offset, 8 * (((uint64_t)len + 31) >> 5))
+         || !__twobit_in_file(tb, c->runs_offset, 8 * (uint64_t)n_runs)) break;
+      c->name = strndup((const char*)tb->data + p, name_len);
+      c->len = len;
+      c->n_runs = n_runs;
+      p += (name_len + 7) & ~7;
+  }
+  if(i < tb->n) { // corrupt
+      tb->n = i;
+      twobit_destroy(tb);
+      return NULL;
+  }
+  return tb;
+}
+
+// writes n bytes (a multiple of eight) and updates the checksum
+static int32_t
+twobit_write(FILE *fp, const void *buf, uint64_t n, uint64_t *h)
+{
+  if(0 < n && 1 != fwrite(buf, n, 1, fp)) return 0;
+  (*h) = twobit_checksum((*h), buf, n >> 3);
+  return 1;
+}
+
+int32_t
+twobit_cache_build(const char *fn_cache, FILE *fp_fa, gzFile gz_fa, const fai_t *fai, int32_t num_threads)
+{
+  FILE *fp = NULL;
+  char fn_tmp[2048];
+  char name[1032];
+  uint8_t header[TWOBIT_CACHE_HEADER], entry[32];
+  struct stat st;
+  refseq_t r;
+  twobit_contig_t *contigs = NULL;
+  uint32_t *runs = NULL;
+  int32_t i, n = 0, m = 0, l, ok = 1;
+  uint32_t u;
+  uint64_t offset, table_offset, h = TWOBIT_CHECKSUM_SEED;
+  int64_t mtime;
+
+  if(0 != fstat(fileno(fp_fa), &st) || !S_ISREG(st.st_mode)) return 0;
+  sprintf(fn_tmp, "%s.tmp.%d", fn_cache, (int)getpid());
+  fp = fopen(fn_tmp, "wb");
+  if(NULL == fp) return 0;
+
+  refseq_init(&r);
+  memset(header, 0, TWOBIT_CACHE_HEADER);
+  ok = (1 == fwrite(header, TWOBIT_CACHE_HEADER, 1, fp)) ? 1 : 0; // filled in at the end
+  offset = TWOBIT_CACHE_HEADER;
+
+  // the packed bases and N runs of each contig
+  if(NULL == fai) gzrewind(gz_fa);
+  for(i = 0; 1 == ok; i++) {
+      if(NULL != fai) {
+          if(fai->n <= i) break;
+          strcpy(name, fai->contigs[i].name);
+          fai_read(fai, i, &r, num_threads);
+          l = r.l;
+      }
+      else if((l = refseq_read_fasta(gz_fa, &r, name, 0)) < 0) {
+          break;
+      }
+      if(m <= n) {
+          m = (m < 16) ? 16 : (m << 1);
+          contigs = realloc(contigs, sizeof(twobit_contig_t) * m);
+      }
+      contigs[n].name = strdup(name);
+      contigs[n].len = l;
+      contigs[n].n_runs = r.n_runs;
+      contigs[n].seq_offset = offset;
+      ok = twobit_write(fp, r.s, 8 * (((uint64_t)l + 31) >> 5), &h);
+      offset += 8 * (((uint64_t)l + 31) >> 5);
+      contigs[n].runs_offset = offset;
+      // the run starts and then the run ends, together a multiple of eight bytes
+      runs = realloc(runs, 8 * (uint64_t)r.n_runs + 8);
+      memcpy(runs, r.run_start, 4 * (uint64_t)r.n_runs);
+      memcpy(runs + r.n_runs, r.run_end, 4 * (uint64_t)r.n_runs);
+      ok = ok && twobit_write(fp, runs, 8 * (uint64_t)r.n_runs, &h);
+      offset += 8 * (uint64_t)r.n_runs;
+      n++;
+  }
+
+  // the contig table
+  table_offset = offset;
+  for(i = 0; i < n; i++) {
+      u = strlen(contigs[i].name);
+      memset(entry, 0, 32);
+      memcpy(entry, &u, sizeof(uint32_t));
+      memcpy(entry + 4, &contigs[i].len, sizeof(int32_t));
+      memcpy(entry + 8, &contigs[i].n_runs, sizeof(int32_t));
+      memcpy(entry + 16, &contigs[i].seq_offset, sizeof(uint64_t));
+      memcpy(entry + 24, &contigs[i].runs_offset, sizeof(uint64_t));
+      memset(name, 0, (u + 7) & ~7); // padded
+      memcpy(name, contigs[i].name, u);
+      ok = ok && twobit_write(fp, entry, 32, &h);
+      ok = ok && twobit_write(fp, name, (u + 7) & ~7, &h);
+      free(contigs[i].name);
+  }
+  free(contigs);
+  free(runs);
+  refseq_destroy(&r);
+
+  // the header, then the checksum over the body and the header
+  memcpy(header, TWOBIT_CACHE_MAGIC, 8);
+  u = TWOBIT_CACHE_VERSION;
+  memcpy(header + 8, &u, sizeof(uint32_t));
+  memcpy(header + 12, &n, sizeof(int32_t));
+  offset = st.st_size;
+  memcpy(header + 16, &offset, sizeof(uint64_t));
+  mtime = st.st_mtime;
+  memcpy(header + 24, &mtime, sizeof(int64_t));
+  memcpy(header + 32, &table_offset, sizeof(uint64_t));
+  h = twobit_checksum(h, header, TWOBIT_CACHE_HEADER >> 3);
+  ok = ok && (1 == fwrite(&h, sizeof(uint64_t), 1, fp));
+  ok = ok && (0 == fseek(fp, 0, SEEK_SET));
+  ok = ok && (1 == fwrite(header, TWOBIT_CACHE_HEADER, 1, fp));
+  if(0 != fclose(fp)) ok = 0;
+  if(1 == ok && 0 != rename(fn_tmp, fn_cache)) ok = 0;
+  if(0 == ok) remove(fn_tmp);
+  return ok;
+}
@@ -0,0 +1,91 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef TWOBIT_H
+#define TWOBIT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "refseq.h"
+#include "fai.h"
+
+/* Random access to 2-bit packed references: UCSC .2bit files, and the
+ * reference cache that dwgsim builds next to a FASTA on first use (packed
+ * bases, contig table, N runs and a checksum), so that later runs skip
+ * parsing the FASTA. */
+
+enum {
+    TWOBIT_UCSC = 0,
+    TWOBIT_CACHE = 1
+};
+
+typedef struct {
+    char *name;
+    int32_t len, n_runs;
+    uint64_t seq_offset; /* file offset of the packed bases */
+    uint64_t runs_offset; /* file offset of the N runs */
+} twobit_contig_t;
+
+typedef struct {
+    int32_t format; /* TWOBIT_UCSC or TWOBIT_CACHE */
+    int32_t swap; /* UCSC file with the other byte order? */
+    int32_t n; /* number of contigs */
+    twobit_contig_t *contigs;
+    const uint8_t *data; /* the memory-mapped file */
+    size_t size;
+} twobit_t;
+
+// is this a UCSC .2bit file?
+int32_t
+twobit_is_ucsc(FILE *fp);
+
+// reads the index of a UCSC .2bit file
+twobit_t *
+twobit_init(FILE *fp);
+
+void
+twobit_destroy(twobit_t *tb);
+
+// decodes contig i into "r"
+void
+twobit_read(const twobit_t *tb, int32_t i, refseq_t *r);
+
+// the number of Ns in contig i, without decoding it
+int64_t
+twobit_n_bases(const twobit_t *tb, int32_t i);
+
+// opens the cache for the FASTA in "fp_fa", returning NULL if it is
+// missing, out of date, or corrupt
+twobit_t *
+twobit_cache_open(const char *fn_cache, FILE *fp_fa);
+
+// writes the cache for the FASTA in "fp_fa" in a single pass, reading it
+// through "fai" if not NULL, or else sequentially from "gz_fa"; returns 1 on
+// success, 0 otherwise
+int32_t
+twobit_cache_build(const char *fn_cache, FILE *fp_fa, gzFile gz_fa, const fai_t *fai, int32_t num_threads);
+
+#endif
@@ -0,0 +1,141 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "writer.h"
+
+double
+writer_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *
+writer_run(void *arg)
+{
+  writer_t *w = (writer_t*)arg;
+  writer_job_t job;
+  double t;
+
+  pthread_mutex_lock(&w->lock);
+  while(1) {
+      while(0 == w->n && 0 == w->is_done) {
+          pthread_cond_wait(&w->cond, &w->lock);
+      }
+      if(0 == w->n) break; // done
+      job = w->jobs[w->head];
+      pthread_mutex_unlock(&w->lock);
+
+      t = writer_time();
+      job.fn(job.arg);
+      t = writer_time() - t;
+
+      // the job stays outstanding until it has run
+      pthread_mutex_lock(&w->lock);
+      w->t_write += t;
+      w->head = (w->head + 1) % w->depth;
+      w->n--;
+      pthread_cond_broadcast(&w->cond);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+writer_t *
+writer_init(int32_t depth)
+{
+  writer_t *w = calloc(1, sizeof(writer_t));
+  w->depth = depth;
+  if(0 < depth) {
+      w->jobs = calloc(depth, sizeof(writer_job_t));
+      pthread_mutex_init(&w->lock, NULL);
+      pthread_cond_init(&w->cond, NULL);
+      if(0 != pthread_create(&w->thread, NULL, writer_run, w)) {
+          fprintf(stderr, "[writer] could not create the writer thread\n");
+          exit(1);
+      }
+  }
+  return w;
+}
+
+void
+writer_push(writer_t *w, writer_fn_t fn, void *arg)
+{
+  double t = writer_time();
+
+  if(0 == w->depth) { // in this thread
+      fn(arg);
+      t = writer_time() - t;
+      w->t_write += t;
+      w->t_blocked += t;
+      return;
+  }
+  pthread_mutex_lock(&w->lock);
+  while(w->depth <= w->n) {
+      pthread_cond_wait(&w->cond, &w->lock);
+  }
+  w->t_blocked += writer_time() - t;
+  w->jobs[(w->head + w->n) % w->depth].fn = fn;
+  w->jobs[(w->head + w->n) % w->depth].arg = arg;
+  w->n++;
+  pthread_cond_broadcast(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+}
+
+void
+writer_sync(writer_t *w)
+{
+  double t = writer_time();
+  if(0 == w->depth) return;
+  pthread_mutex_lock(&w->lock);
+  while(0 < w->n) {
+      pthread_cond_wait(&w->cond, &w->lock);
+  }
+  w->t_blocked += writer_time() - t;
+  pthread_mutex_unlock(&w->lock);
+}
+
+void
+writer_destroy(writer_t *w)
+{
+  if(NULL == w) return;
+  if(0 < w->depth) {
+      pthread_mutex_lock(&w->lock);
+      w->is_done = 1;
+      pthread_cond_broadcast(&w->cond);
+      pthread_mutex_unlock(&w->lock);
+      pthread_join(w->thread, NULL);
+      pthread_mutex_destroy(&w->lock);
+      pthread_cond_destroy(&w->cond);
+  }
+  free(w->jobs);
+  free(w);
+}
@@ -0,0 +1,75 @@
+/* The MIT License
+
+   Copyright (c) 2008 Genome Research Ltd (GRL).
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+   */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Runs output jobs, in order, on a dedicated thread, so that the caller can
+ * go on generating while earlier output is written.  At most "depth" jobs
+ * are outstanding; pushing another waits for the oldest to finish.  With a
+ * depth of zero, jobs run in the calling thread. */
+
+typedef void (*writer_fn_t)(void *arg);
+
+typedef struct {
+    writer_fn_t fn;
+    void *arg;
+} writer_job_t;
+
+typedef struct {
+    int32_t depth; /* the maximum number of outstanding jobs */
+    int32_t head, n; /* the oldest outstanding job and the number outstanding */
+    writer_job_t *jobs; /* circular */
+    int32_t is_done;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    double t_write; /* seconds spent running jobs */
+    double t_blocked; /* seconds the caller waited for the writer */
+} writer_t;
+
+// the wall clock, in seconds
+double
+writer_time();
+
+writer_t *
+writer_init(int32_t depth);
+
+// queues a job, waiting while "depth" jobs are outstanding
+void
+writer_push(writer_t *w, writer_fn_t fn, void *arg);
+
+// waits for all jobs to finish
+void
+writer_sync(writer_t *w);
+
+// finishes all jobs and stops the thread
+void
+writer_destroy(writer_t *w);
+
+#endif